@@ -0,0 +1,457 @@
+/*
+ * Bit sliced AES using NEON, eight blocks at a time
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The 128-bit state of a block is spread over eight 32-bit words so
+ * that word i holds bit i of every byte of two blocks.  Each NEON lane
+ * carries one such pair, so a q register holds one bit plane of eight
+ * blocks and every AES step becomes a short sequence of logic
+ * operations and fixed shifts, with no table lookups.  The S-box is
+ * the 113 gate circuit of Boyar and Peralta.
+ *
+ * This file is built with -mfpu=neon and must only be entered between
+ * kernel_neon_begin() and kernel_neon_end().
+ */
+#include <linux/types.h>
+
+typedef u32 bs_t __attribute__((vector_size(16)));
+
+/*
+ * The logic operations use the compiler's generic vector operators.
+ * Shifts, permutes and memory accesses are not available that way with
+ * the compilers this tree supports, so each is a single NEON instruction.
+ */
+#define XOR(a, b)	((a) ^ (b))
+#define AND(a, b)	((a) & (b))
+#define OR(a, b)	((a) | (b))
+#define NOT(a)		(~(a))
+#define SPLAT(c)	((bs_t){ (c), (c), (c), (c) })
+
+#define SHL(x, n)							\
+({									\
+	bs_t __r;							\
+	asm("vshl.i32	%q0, %q1, %2" : "=w" (__r) : "w" (x), "i" (n));	\
+	__r;								\
+})
+
+#define SHR(x, n)							\
+({									\
+	bs_t __r;							\
+	asm("vshr.u32	%q0, %q1, %2" : "=w" (__r) : "w" (x), "i" (n));	\
+	__r;								\
+})
+
+#define ROR8(x)								\
+({									\
+	bs_t __r;							\
+	asm("vshl.i32	%q0, %q1, #24\n\t"				\
+	    "vsri.32	%q0, %q1, #8"					\
+	    : "=&w" (__r) : "w" (x));					\
+	__r;								\
+})
+
+#define ROR16(x)							\
+({									\
+	bs_t __r;							\
+	asm("vrev32.16	%q0, %q1" : "=w" (__r) : "w" (x));		\
+	__r;								\
+})
+
+/* byte loads and stores, so that the data needs no particular alignment */
+#define LOAD(p)								\
+({									\
+	bs_t __r;							\
+	asm("vld1.8	{%q0}, [%1]"					\
+	    : "=w" (__r) : "r" (p), "m" (*(const u8 (*)[16])(p)));	\
+	__r;								\
+})
+
+#define STORE(p, x)							\
+	asm("vst1.8	{%q1}, [%2]"					\
+	    : "=m" (*(u8 (*)[16])(p)) : "w" (x), "r" (p))
+
+/* transpose the 4x4 matrix of words held in a, b, c and d */
+#define TRANSPOSE(a, b, c, d)						\
+	asm("vtrn.32	%q0, %q1\n\t"					\
+	    "vtrn.32	%q2, %q3\n\t"					\
+	    "vswp	%f0, %e2\n\t"					\
+	    "vswp	%f1, %e3"					\
+	    : "+w" (a), "+w" (b), "+w" (c), "+w" (d))
+
+/* swap the bits of a selected by ~m (shifted) with the bits of b in m */
+#define SWAPN(a, b, m, s)						\
+do {									\
+	bs_t t = AND(XOR(SHR(a, s), b), m);				\
+	b = XOR(b, t);							\
+	a = XOR(a, SHL(t, s));						\
+} while (0)
+
+/* Convert between eight words of two blocks and eight bit planes. */
+static inline void ortho(bs_t *q)
+{
+	bs_t m1 = SPLAT(0x55555555);
+	bs_t m2 = SPLAT(0x33333333);
+	bs_t m4 = SPLAT(0x0f0f0f0f);
+
+	SWAPN(q[0], q[1], m1, 1);
+	SWAPN(q[2], q[3], m1, 1);
+	SWAPN(q[4], q[5], m1, 1);
+	SWAPN(q[6], q[7], m1, 1);
+
+	SWAPN(q[0], q[2], m2, 2);
+	SWAPN(q[1], q[3], m2, 2);
+	SWAPN(q[4], q[6], m2, 2);
+	SWAPN(q[5], q[7], m2, 2);
+
+	SWAPN(q[0], q[4], m4, 4);
+	SWAPN(q[1], q[5], m4, 4);
+	SWAPN(q[2], q[6], m4, 4);
+	SWAPN(q[3], q[7], m4, 4);
+}
+
+static inline void add_round_key(bs_t *q, const u32 *rk)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		q[i] = XOR(q[i], LOAD(rk + 4 * i));
+}
+
+/*
+ * Boyar-Peralta S-box circuit.  x0 is the most significant bit, which
+ * lives in q[7].
+ */
+static void sbox(bs_t *q)
+{
+	bs_t x0, x1, x2, x3, x4, x5, x6, x7;
+	bs_t y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11;
+	bs_t y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+	bs_t z0, z1, z2, z3, z4, z5, z6, z7, z8, z9;
+	bs_t z10, z11, z12, z13, z14, z15, z16, z17;
+	bs_t t0, t1, t2, t3, t4, t5, t6, t7, t8, t9;
+	bs_t t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+	bs_t t20, t21, t22, t23, t24, t25, t26, t27, t28, t29;
+	bs_t t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+	bs_t t40, t41, t42, t43, t44, t45, t46, t47, t48, t49;
+	bs_t t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+	bs_t t60, t61, t62, t63, t64, t65, t66, t67;
+
+	x0 = q[7];
+	x1 = q[6];
+	x2 = q[5];
+	x3 = q[4];
+	x4 = q[3];
+	x5 = q[2];
+	x6 = q[1];
+	x7 = q[0];
+
+	/* top linear transform */
+	y14 = XOR(x3, x5);
+	y13 = XOR(x0, x6);
+	y9 = XOR(x0, x3);
+	y8 = XOR(x0, x5);
+	t0 = XOR(x1, x2);
+	y1 = XOR(t0, x7);
+	y4 = XOR(y1, x3);
+	y12 = XOR(y13, y14);
+	y2 = XOR(y1, x0);
+	y5 = XOR(y1, x6);
+	y3 = XOR(y5, y8);
+	t1 = XOR(x4, y12);
+	y15 = XOR(t1, x5);
+	y20 = XOR(t1, x1);
+	y6 = XOR(y15, x7);
+	y10 = XOR(y15, t0);
+	y11 = XOR(y20, y9);
+	y7 = XOR(x7, y11);
+	y17 = XOR(y10, y11);
+	y19 = XOR(y10, y8);
+	y16 = XOR(t0, y11);
+	y21 = XOR(y13, y16);
+	y18 = XOR(x0, y16);
+
+	/* non-linear section */
+	t2 = AND(y12, y15);
+	t3 = AND(y3, y6);
+	t4 = XOR(t3, t2);
+	t5 = AND(y4, x7);
+	t6 = XOR(t5, t2);
+	t7 = AND(y13, y16);
+	t8 = AND(y5, y1);
+	t9 = XOR(t8, t7);
+	t10 = AND(y2, y7);
+	t11 = XOR(t10, t7);
+	t12 = AND(y9, y11);
+	t13 = AND(y14, y17);
+	t14 = XOR(t13, t12);
+	t15 = AND(y8, y10);
+	t16 = XOR(t15, t12);
+	t17 = XOR(t4, t14);
+	t18 = XOR(t6, t16);
+	t19 = XOR(t9, t14);
+	t20 = XOR(t11, t16);
+	t21 = XOR(t17, y20);
+	t22 = XOR(t18, y19);
+	t23 = XOR(t19, y21);
+	t24 = XOR(t20, y18);
+
+	t25 = XOR(t21, t22);
+	t26 = AND(t21, t23);
+	t27 = XOR(t24, t26);
+	t28 = AND(t25, t27);
+	t29 = XOR(t28, t22);
+	t30 = XOR(t23, t24);
+	t31 = XOR(t22, t26);
+	t32 = AND(t31, t30);
+	t33 = XOR(t32, t24);
+	t34 = XOR(t23, t33);
+	t35 = XOR(t27, t33);
+	t36 = AND(t24, t35);
+	t37 = XOR(t36, t34);
+	t38 = XOR(t27, t36);
+	t39 = AND(t29, t38);
+	t40 = XOR(t25, t39);
+
+	t41 = XOR(t40, t37);
+	t42 = XOR(t29, t33);
+	t43 = XOR(t29, t40);
+	t44 = XOR(t33, t37);
+	t45 = XOR(t42, t41);
+	z0 = AND(t44, y15);
+	z1 = AND(t37, y6);
+	z2 = AND(t33, x7);
+	z3 = AND(t43, y16);
+	z4 = AND(t40, y1);
+	z5 = AND(t29, y7);
+	z6 = AND(t42, y11);
+	z7 = AND(t45, y17);
+	z8 = AND(t41, y10);
+	z9 = AND(t44, y12);
+	z10 = AND(t37, y3);
+	z11 = AND(t33, y4);
+	z12 = AND(t43, y13);
+	z13 = AND(t40, y5);
+	z14 = AND(t29, y2);
+	z15 = AND(t42, y9);
+	z16 = AND(t45, y14);
+	z17 = AND(t41, y8);
+
+	/* bottom linear transform */
+	t46 = XOR(z15, z16);
+	t47 = XOR(z10, z11);
+	t48 = XOR(z5, z13);
+	t49 = XOR(z9, z10);
+	t50 = XOR(z2, z12);
+	t51 = XOR(z2, z5);
+	t52 = XOR(z7, z8);
+	t53 = XOR(z0, z3);
+	t54 = XOR(z6, z7);
+	t55 = XOR(z16, z17);
+	t56 = XOR(z12, t48);
+	t57 = XOR(t50, t53);
+	t58 = XOR(z4, t46);
+	t59 = XOR(z3, t54);
+	t60 = XOR(t46, t57);
+	t61 = XOR(z14, t57);
+	t62 = XOR(t52, t58);
+	t63 = XOR(t49, t58);
+	t64 = XOR(z4, t59);
+	t65 = XOR(t61, t62);
+	t66 = XOR(z1, t63);
+	t67 = XOR(t64, t65);
+
+	q[7] = XOR(t59, t63);
+	q[1] = XOR(t56, NOT(t62));
+	q[0] = XOR(t48, NOT(t60));
+	q[4] = XOR(t53, t66);
+	q[3] = XOR(t51, t66);
+	q[2] = XOR(t47, t65);
+	q[6] = XOR(t64, NOT(q[4]));
+	q[5] = XOR(t55, NOT(t67));
+}
+
+/*
+ * The inverse S-box reuses the forward circuit:
+ *   iS(x) = B(S(B(x ^ 0x63)) ^ 0x63)
+ * with B() the inverse of the affine map inside S().
+ */
+static void inv_affine(bs_t *q)
+{
+	bs_t q0, q1, q2, q3, q4, q5, q6, q7;
+
+	q0 = NOT(q[0]);
+	q1 = NOT(q[1]);
+	q2 = q[2];
+	q3 = q[3];
+	q4 = q[4];
+	q5 = NOT(q[5]);
+	q6 = NOT(q[6]);
+	q7 = q[7];
+	q[7] = XOR(XOR(q1, q4), q6);
+	q[6] = XOR(XOR(q0, q3), q5);
+	q[5] = XOR(XOR(q7, q2), q4);
+	q[4] = XOR(XOR(q6, q1), q3);
+	q[3] = XOR(XOR(q5, q0), q2);
+	q[2] = XOR(XOR(q4, q7), q1);
+	q[1] = XOR(XOR(q3, q6), q0);
+	q[0] = XOR(XOR(q2, q5), q7);
+}
+
+static void inv_sbox(bs_t *q)
+{
+	inv_affine(q);
+	sbox(q);
+	inv_affine(q);
+}
+
+#define BITS(x, mask)	AND(x, SPLAT(mask))
+
+static void shift_rows(bs_t *q)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		bs_t x = q[i];
+
+		q[i] = OR(OR(OR(BITS(x, 0x000000ff),
+			SHR(BITS(x, 0x0000fc00), 2)),
+			OR(SHL(BITS(x, 0x00000300), 6),
+			SHR(BITS(x, 0x00f00000), 4))),
+			OR(OR(SHL(BITS(x, 0x000f0000), 4),
+			SHR(BITS(x, 0xc0000000), 6)),
+			SHL(BITS(x, 0x3f000000), 2)));
+	}
+}
+
+static void inv_shift_rows(bs_t *q)
+{
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		bs_t x = q[i];
+
+		q[i] = OR(OR(OR(BITS(x, 0x000000ff),
+			SHL(BITS(x, 0x00003f00), 2)),
+			OR(SHR(BITS(x, 0x0000c000), 6),
+			SHL(BITS(x, 0x000f0000), 4))),
+			OR(OR(SHR(BITS(x, 0x00f00000), 4),
+			SHL(BITS(x, 0x03000000), 6)),
+			SHR(BITS(x, 0xfc000000), 2)));
+	}
+}
+
+static void mix_columns(bs_t *q)
+{
+	bs_t r[8], s[8];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		r[i] = ROR8(q[i]);
+		s[i] = XOR(q[i], r[i]);
+	}
+
+	/* 2 * (q ^ r) ^ r ^ ROR16(q ^ r); doubling carries out of bit 7 */
+	q[0] = XOR(XOR(s[7], r[0]), ROR16(s[0]));
+	q[1] = XOR(XOR(XOR(s[0], s[7]), r[1]), ROR16(s[1]));
+	q[2] = XOR(XOR(s[1], r[2]), ROR16(s[2]));
+	q[3] = XOR(XOR(XOR(s[2], s[7]), r[3]), ROR16(s[3]));
+	q[4] = XOR(XOR(XOR(s[3], s[7]), r[4]), ROR16(s[4]));
+	q[5] = XOR(XOR(s[4], r[5]), ROR16(s[5]));
+	q[6] = XOR(XOR(s[5], r[6]), ROR16(s[6]));
+	q[7] = XOR(XOR(s[6], r[7]), ROR16(s[7]));
+}
+
+/*
+ * InvMixColumns is MixColumns applied after multiplying each column
+ * by {04}x^2 + {05}, i.e. q ^ {04} * (q ^ ROR16(q)).
+ */
+static void inv_mix_columns(bs_t *q)
+{
+	bs_t u[8];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		u[i] = XOR(q[i], ROR16(q[i]));
+
+	q[0] = XOR(q[0], u[6]);
+	q[1] = XOR(q[1], XOR(u[6], u[7]));
+	q[2] = XOR(q[2], XOR(u[0], u[7]));
+	q[3] = XOR(q[3], XOR(u[1], u[6]));
+	q[4] = XOR(q[4], XOR(XOR(u[2], u[6]), u[7]));
+	q[5] = XOR(q[5], XOR(u[3], u[7]));
+	q[6] = XOR(q[6], u[4]);
+	q[7] = XOR(q[7], u[5]);
+
+	mix_columns(q);
+}
+
+/*
+ * Blocks 0-3 go to the even words, blocks 4-7 to the odd ones: q[2 * i]
+ * holds word i of each of the first four blocks.
+ */
+static inline void load_blocks(bs_t *q, const u8 *in)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		q[(i & 3) * 2 + (i >> 2)] = LOAD(in + 16 * i);
+	TRANSPOSE(q[0], q[2], q[4], q[6]);
+	TRANSPOSE(q[1], q[3], q[5], q[7]);
+	ortho(q);
+}
+
+static inline void store_blocks(u8 *out, bs_t *q)
+{
+	int i;
+
+	ortho(q);
+	TRANSPOSE(q[0], q[2], q[4], q[6]);
+	TRANSPOSE(q[1], q[3], q[5], q[7]);
+	for (i = 0; i < 8; i++)
+		STORE(out + 16 * i, q[(i & 3) * 2 + (i >> 2)]);
+}
+
+/*
+ * rk holds rounds + 1 round keys in bit sliced form, 8 words of 4
+ * lanes each; see aesbs_expand_key().
+ */
+void aesbs_encrypt8(const u32 *rk, int rounds, u8 *out, const u8 *in)
+{
+	bs_t q[8];
+	int r;
+
+	load_blocks(q, in);
+	add_round_key(q, rk);
+	for (r = 1; r < rounds; r++) {
+		sbox(q);
+		shift_rows(q);
+		mix_columns(q);
+		add_round_key(q, rk + 32 * r);
+	}
+	sbox(q);
+	shift_rows(q);
+	add_round_key(q, rk + 32 * rounds);
+	store_blocks(out, q);
+}
+
+void aesbs_decrypt8(const u32 *rk, int rounds, u8 *out, const u8 *in)
+{
+	bs_t q[8];
+	int r;
+
+	load_blocks(q, in);
+	add_round_key(q, rk + 32 * rounds);
+	for (r = rounds - 1; r > 0; r--) {
+		inv_shift_rows(q);
+		inv_sbox(q);
+		add_round_key(q, rk + 32 * r);
+		inv_mix_columns(q);
+	}
+	inv_shift_rows(q);
+	inv_sbox(q);
+	add_round_key(q, rk);
+	store_blocks(out, q);
+}
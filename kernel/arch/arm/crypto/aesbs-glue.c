@@ -0,0 +1,506 @@
+/*
+ * Glue code for the bit sliced NEON AES implementation
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * The NEON core always works on eight blocks, so it is only offered
+ * for the modes where blocks are independent: CBC decryption, CTR and
+ * XTS.  CBC encryption goes one block at a time through the generic
+ * cipher, as does everything issued from interrupt context, where the
+ * NEON unit may not be used.
+ */
+#include <linux/module.h>
+#include <linux/crypto.h>
+#include <linux/hardirq.h>
+#include <crypto/aes.h>
+#include <crypto/algapi.h>
+#include <asm/neon.h>
+#include <asm/unaligned.h>
+
+#define AESBS_BLOCKS	8
+#define AESBS_CHUNK	(AESBS_BLOCKS * AES_BLOCK_SIZE)
+
+extern void aesbs_encrypt8(const u32 *rk, int rounds, u8 *out, const u8 *in);
+extern void aesbs_decrypt8(const u32 *rk, int rounds, u8 *out, const u8 *in);
+
+struct aesbs_ctx {
+	/* one round key per round plus one, eight 4-lane vectors each */
+	u32 rk[AES_MAX_KEYLENGTH_U32 / 4 * 32];
+	int rounds;
+	struct crypto_cipher *cipher;
+	struct crypto_cipher *tweak;	/* XTS only */
+};
+
+#define SWAPN(x, y, m, s)						\
+do {									\
+	u32 t = (((x) >> (s)) ^ (y)) & (m);				\
+	(y) ^= t;							\
+	(x) ^= t << (s);						\
+} while (0)
+
+/* Scalar version of the bit plane transform done by the NEON core. */
+static void aesbs_ortho(u32 *q)
+{
+	SWAPN(q[0], q[1], 0x55555555, 1);
+	SWAPN(q[2], q[3], 0x55555555, 1);
+	SWAPN(q[4], q[5], 0x55555555, 1);
+	SWAPN(q[6], q[7], 0x55555555, 1);
+
+	SWAPN(q[0], q[2], 0x33333333, 2);
+	SWAPN(q[1], q[3], 0x33333333, 2);
+	SWAPN(q[4], q[6], 0x33333333, 2);
+	SWAPN(q[5], q[7], 0x33333333, 2);
+
+	SWAPN(q[0], q[4], 0x0f0f0f0f, 4);
+	SWAPN(q[1], q[5], 0x0f0f0f0f, 4);
+	SWAPN(q[2], q[6], 0x0f0f0f0f, 4);
+	SWAPN(q[3], q[7], 0x0f0f0f0f, 4);
+}
+
+/*
+ * Expand the key with the generic code and slice each round key the
+ * same way the core slices a pair of blocks, replicated to all lanes.
+ */
+static int aesbs_expand_key(struct aesbs_ctx *ctx, const u8 *in_key,
+			    unsigned int key_len, u32 *flags)
+{
+	struct crypto_aes_ctx aes;
+	u32 q[8];
+	int r, i, l;
+
+	if (crypto_aes_expand_key(&aes, in_key, key_len)) {
+		*flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+
+	ctx->rounds = 6 + key_len / 4;
+	for (r = 0; r <= ctx->rounds; r++) {
+		for (i = 0; i < 4; i++)
+			q[2 * i] = q[2 * i + 1] = aes.key_enc[4 * r + i];
+		aesbs_ortho(q);
+		for (i = 0; i < 8; i++)
+			for (l = 0; l < 4; l++)
+				ctx->rk[32 * r + 4 * i + l] = q[i];
+	}
+	memset(&aes, 0, sizeof(aes));
+	return 0;
+}
+
+static int aesbs_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			 unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = aesbs_expand_key(ctx, in_key, key_len, &tfm->crt_flags);
+	if (err)
+		return err;
+	return crypto_cipher_setkey(ctx->cipher, in_key, key_len);
+}
+
+static int aesbs_xts_set_key(struct crypto_tfm *tfm, const u8 *in_key,
+			     unsigned int key_len)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	if (key_len % 2) {
+		tfm->crt_flags |= CRYPTO_TFM_RES_BAD_KEY_LEN;
+		return -EINVAL;
+	}
+	key_len /= 2;
+	err = aesbs_set_key(tfm, in_key, key_len);
+	if (err)
+		return err;
+	return crypto_cipher_setkey(ctx->tweak, in_key + key_len, key_len);
+}
+
+static inline int aesbs_neon_ok(void)
+{
+	return !in_interrupt();
+}
+
+/*
+ * Run n <= AESBS_BLOCKS blocks from in to out.  The NEON core always
+ * computes all eight lanes, so short runs go through a bounce buffer.
+ */
+static void aesbs_crypt(struct aesbs_ctx *ctx, u8 *out, const u8 *in,
+			int n, int enc, int neon)
+{
+	u32 buf[AESBS_CHUNK / 4];
+	int i;
+
+	if (!neon) {
+		for (i = 0; i < n * AES_BLOCK_SIZE; i += AES_BLOCK_SIZE) {
+			if (enc)
+				crypto_cipher_encrypt_one(ctx->cipher,
+						out + i, in + i);
+			else
+				crypto_cipher_decrypt_one(ctx->cipher,
+						out + i, in + i);
+		}
+		return;
+	}
+
+	if (n < AESBS_BLOCKS) {
+		memcpy(buf, in, n * AES_BLOCK_SIZE);
+		memset((u8 *)buf + n * AES_BLOCK_SIZE, 0,
+				(AESBS_BLOCKS - n) * AES_BLOCK_SIZE);
+		in = (u8 *)buf;
+	}
+	if (enc)
+		aesbs_encrypt8(ctx->rk, ctx->rounds, (u8 *)buf, in);
+	else
+		aesbs_decrypt8(ctx->rk, ctx->rounds, (u8 *)buf, in);
+	memcpy(out, buf, n * AES_BLOCK_SIZE);
+}
+
+static int aesbs_cbc_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	int err;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		do {
+			crypto_xor(walk.iv, s, AES_BLOCK_SIZE);
+			crypto_cipher_encrypt_one(ctx->cipher, d, walk.iv);
+			memcpy(walk.iv, d, AES_BLOCK_SIZE);
+			s += AES_BLOCK_SIZE;
+			d += AES_BLOCK_SIZE;
+		} while ((nbytes -= AES_BLOCK_SIZE) >= AES_BLOCK_SIZE);
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_cbc_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u32 buf[AESBS_CHUNK / 4];
+	u8 *p = (u8 *)buf;
+	u8 last[AES_BLOCK_SIZE];
+	int neon = aesbs_neon_ok();
+	int err, n, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (neon)
+			kernel_neon_begin();
+		while (nbytes >= AES_BLOCK_SIZE) {
+			n = min_t(int, nbytes / AES_BLOCK_SIZE, AESBS_BLOCKS);
+			aesbs_crypt(ctx, p, s, n, 0, neon);
+
+			/* src may be dst, so go backwards */
+			memcpy(last, s + (n - 1) * AES_BLOCK_SIZE,
+					AES_BLOCK_SIZE);
+			for (i = n - 1; i > 0; i--)
+				crypto_xor(p + i * AES_BLOCK_SIZE,
+					s + (i - 1) * AES_BLOCK_SIZE,
+					AES_BLOCK_SIZE);
+			crypto_xor(p, walk.iv, AES_BLOCK_SIZE);
+			memcpy(d, p, n * AES_BLOCK_SIZE);
+			memcpy(walk.iv, last, AES_BLOCK_SIZE);
+
+			s += n * AES_BLOCK_SIZE;
+			d += n * AES_BLOCK_SIZE;
+			nbytes -= n * AES_BLOCK_SIZE;
+		}
+		if (neon)
+			kernel_neon_end();
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_ctr_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u32 buf[AESBS_CHUNK / 4];
+	u8 *p = (u8 *)buf;
+	int neon = aesbs_neon_ok();
+	int err, n, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt_block(desc, &walk, AES_BLOCK_SIZE);
+
+	while ((nbytes = walk.nbytes) >= AES_BLOCK_SIZE) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (neon)
+			kernel_neon_begin();
+		while (nbytes >= AES_BLOCK_SIZE) {
+			n = min_t(int, nbytes / AES_BLOCK_SIZE, AESBS_BLOCKS);
+			for (i = 0; i < n; i++) {
+				memcpy(p + i * AES_BLOCK_SIZE, walk.iv,
+						AES_BLOCK_SIZE);
+				crypto_inc(walk.iv, AES_BLOCK_SIZE);
+			}
+			aesbs_crypt(ctx, p, p, n, 1, neon);
+
+			if (d != s)
+				memcpy(d, s, n * AES_BLOCK_SIZE);
+			crypto_xor(d, p, n * AES_BLOCK_SIZE);
+
+			s += n * AES_BLOCK_SIZE;
+			d += n * AES_BLOCK_SIZE;
+			nbytes -= n * AES_BLOCK_SIZE;
+		}
+		if (neon)
+			kernel_neon_end();
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+
+	/* trailing partial block */
+	if (walk.nbytes) {
+		crypto_cipher_encrypt_one(ctx->cipher, p, walk.iv);
+		if (walk.dst.virt.addr != walk.src.virt.addr)
+			memcpy(walk.dst.virt.addr, walk.src.virt.addr,
+					walk.nbytes);
+		crypto_xor(walk.dst.virt.addr, p, walk.nbytes);
+		crypto_inc(walk.iv, AES_BLOCK_SIZE);
+		err = blkcipher_walk_done(desc, &walk, 0);
+	}
+	return err;
+}
+
+/* Multiply the tweak by x in GF(2^128), little endian as XTS wants. */
+static void aesbs_xts_next(u8 *t)
+{
+	u64 lo = get_unaligned_le64(t);
+	u64 hi = get_unaligned_le64(t + 8);
+
+	put_unaligned_le64((lo << 1) ^ ((hi >> 63) * 0x87), t);
+	put_unaligned_le64((hi << 1) | (lo >> 63), t + 8);
+}
+
+static int aesbs_xts_crypt(struct blkcipher_desc *desc,
+			   struct scatterlist *dst, struct scatterlist *src,
+			   unsigned int nbytes, int enc)
+{
+	struct aesbs_ctx *ctx = crypto_blkcipher_ctx(desc->tfm);
+	struct blkcipher_walk walk;
+	u32 buf[AESBS_CHUNK / 4];
+	u8 *p = (u8 *)buf;
+	u8 t[AESBS_CHUNK];
+	int neon = aesbs_neon_ok();
+	int err, n, i;
+
+	blkcipher_walk_init(&walk, dst, src, nbytes);
+	err = blkcipher_walk_virt(desc, &walk);
+
+	/* walk.iv carries the tweak of the next block from here on */
+	if (walk.nbytes)
+		crypto_cipher_encrypt_one(ctx->tweak, walk.iv, walk.iv);
+
+	while ((nbytes = walk.nbytes)) {
+		u8 *s = walk.src.virt.addr;
+		u8 *d = walk.dst.virt.addr;
+
+		if (neon)
+			kernel_neon_begin();
+		while (nbytes >= AES_BLOCK_SIZE) {
+			n = min_t(int, nbytes / AES_BLOCK_SIZE, AESBS_BLOCKS);
+			memcpy(p, s, n * AES_BLOCK_SIZE);
+			for (i = 0; i < n; i++) {
+				memcpy(t + i * AES_BLOCK_SIZE, walk.iv,
+						AES_BLOCK_SIZE);
+				aesbs_xts_next(walk.iv);
+			}
+			crypto_xor(p, t, n * AES_BLOCK_SIZE);
+			aesbs_crypt(ctx, p, p, n, enc, neon);
+			crypto_xor(p, t, n * AES_BLOCK_SIZE);
+			memcpy(d, p, n * AES_BLOCK_SIZE);
+
+			s += n * AES_BLOCK_SIZE;
+			d += n * AES_BLOCK_SIZE;
+			nbytes -= n * AES_BLOCK_SIZE;
+		}
+		if (neon)
+			kernel_neon_end();
+
+		err = blkcipher_walk_done(desc, &walk, nbytes);
+	}
+	return err;
+}
+
+static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 1);
+}
+
+static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
+			     struct scatterlist *dst, struct scatterlist *src,
+			     unsigned int nbytes)
+{
+	return aesbs_xts_crypt(desc, dst, src, nbytes, 0);
+}
+
+static int aesbs_init(struct crypto_tfm *tfm)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	ctx->cipher = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->cipher))
+		return PTR_ERR(ctx->cipher);
+	ctx->tweak = NULL;
+	return 0;
+}
+
+static int aesbs_xts_init(struct crypto_tfm *tfm)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+	int err;
+
+	err = aesbs_init(tfm);
+	if (err)
+		return err;
+	ctx->tweak = crypto_alloc_cipher("aes", 0, 0);
+	if (IS_ERR(ctx->tweak)) {
+		crypto_free_cipher(ctx->cipher);
+		return PTR_ERR(ctx->tweak);
+	}
+	return 0;
+}
+
+static void aesbs_exit(struct crypto_tfm *tfm)
+{
+	struct aesbs_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	crypto_free_cipher(ctx->cipher);
+	if (ctx->tweak)
+		crypto_free_cipher(ctx->tweak);
+}
+
+static struct crypto_alg aesbs_algs[] = { {
+	.cra_name		= "cbc(aes)",
+	.cra_driver_name	= "cbc-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_init,
+	.cra_exit		= aesbs_exit,
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_cbc_encrypt,
+			.decrypt	= aesbs_cbc_decrypt,
+		}
+	}
+}, {
+	.cra_name		= "ctr(aes)",
+	.cra_driver_name	= "ctr-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= 1,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_init,
+	.cra_exit		= aesbs_exit,
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize	= AES_MIN_KEY_SIZE,
+			.max_keysize	= AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_set_key,
+			.encrypt	= aesbs_ctr_crypt,
+			.decrypt	= aesbs_ctr_crypt,
+		}
+	}
+}, {
+	.cra_name		= "xts(aes)",
+	.cra_driver_name	= "xts-aes-neonbs",
+	.cra_priority		= 300,
+	.cra_flags		= CRYPTO_ALG_TYPE_BLKCIPHER,
+	.cra_blocksize		= AES_BLOCK_SIZE,
+	.cra_ctxsize		= sizeof(struct aesbs_ctx),
+	.cra_alignmask		= 3,
+	.cra_type		= &crypto_blkcipher_type,
+	.cra_module		= THIS_MODULE,
+	.cra_init		= aesbs_xts_init,
+	.cra_exit		= aesbs_exit,
+	.cra_u			= {
+		.blkcipher = {
+			.min_keysize	= 2 * AES_MIN_KEY_SIZE,
+			.max_keysize	= 2 * AES_MAX_KEY_SIZE,
+			.ivsize		= AES_BLOCK_SIZE,
+			.setkey		= aesbs_xts_set_key,
+			.encrypt	= aesbs_xts_encrypt,
+			.decrypt	= aesbs_xts_decrypt,
+		}
+	}
+} };
+
+static int __init aesbs_mod_init(void)
+{
+	int i, err;
+
+	if (!cpu_has_neon())
+		return -ENODEV;
+
+	for (i = 0; i < ARRAY_SIZE(aesbs_algs); i++) {
+		err = crypto_register_alg(&aesbs_algs[i]);
+		if (err)
+			goto unregister;
+	}
+	return 0;
+
+unregister:
+	while (--i >= 0)
+		crypto_unregister_alg(&aesbs_algs[i]);
+	return err;
+}
+
+static void __exit aesbs_mod_exit(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(aesbs_algs) - 1; i >= 0; i--)
+		crypto_unregister_alg(&aesbs_algs[i]);
+}
+
+/* HWCAP_NEON is only known once vfp_init() has run */
+late_initcall(aesbs_mod_init);
+module_exit(aesbs_mod_exit);
+
+MODULE_DESCRIPTION("Bit sliced AES in CBC/CTR/XTS modes using NEON");
+MODULE_LICENSE("GPL");
+MODULE_ALIAS("cbc(aes)");
+MODULE_ALIAS("ctr(aes)");
+MODULE_ALIAS("xts(aes)");
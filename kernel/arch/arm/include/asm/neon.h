@@ -0,0 +1,25 @@
+/*
+ * arch/arm/include/asm/neon.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#ifndef __ASM_ARM_NEON_H
+#define __ASM_ARM_NEON_H
+
+#include <asm/hwcap.h>
+
+#define cpu_has_neon()		(!!(elf_hwcap & HWCAP_NEON))
+
+/*
+ * Kernel code may only touch the NEON/VFP registers between a
+ * kernel_neon_begin() and kernel_neon_end() pair.  begin saves the
+ * user state held in the registers and disables preemption; the
+ * section must not sleep and must not be entered from interrupt
+ * context.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* __ASM_ARM_NEON_H */
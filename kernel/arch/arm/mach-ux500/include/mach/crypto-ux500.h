@@ -5,6 +5,8 @@
  * License terms: GNU General Public License (GPL) version 2
  */
 #ifndef _CRYPTO_UX500_H
+#define _CRYPTO_UX500_H
+
 #include <plat/ste_dma40.h>
 #include <mach/ste-dma40-db8500.h>
 
@@ -13,4 +15,8 @@ struct cryp_platform_data {
 	struct stedma40_chan_cfg engine_to_mem;
 };
 
+struct hash_platform_data {
+	struct stedma40_chan_cfg mem_to_engine;
+};
+
 #endif
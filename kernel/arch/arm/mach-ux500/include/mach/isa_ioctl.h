@@ -35,6 +35,41 @@ enum t_dlp_mmap_params {
 	MMAP_ULQUEUE
 };
 
+/**
+Downlink mmap ring.
+
+Mapping MMAP_DLQUEUE gives a DLP_MMAP_CTRL_SIZE control page holding a
+struct t_dlp_ring, followed by the DLP_MMAP_DATA_SIZE downlink queue mapped
+twice back to back, so a message that wraps around the end of the queue is
+still contiguous at data_offset + desc.offset.  The driver fills desc[head %
+ndesc] and then advances head; the reader advances tail once it is done
+with a message and only has to poll() when tail catches up with head.
+The isi, ipcctrl and ipcdata devices, whose queues are also read by the
+network interfaces, can not be mapped.
+*/
+#define DLP_MMAP_CTRL_SIZE	(4096)
+#define DLP_MMAP_DATA_SIZE	(512*1024)
+#define DLP_MMAP_SIZE		(DLP_MMAP_CTRL_SIZE + 2 * DLP_MMAP_DATA_SIZE)
+#define DLP_MMAP_RING_MAGIC	(0x53484d52)
+#define DLP_MMAP_RING_DESCS	(256)
+
+struct t_dlp_ring_desc {
+	unsigned int offset;
+	unsigned int size;
+};
+
+struct t_dlp_ring {
+	unsigned int magic;
+	unsigned int data_offset;
+	unsigned int data_size;
+	unsigned int ndesc;
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	unsigned int dropped;
+	unsigned int reserved;
+	struct t_dlp_ring_desc desc[DLP_MMAP_RING_DESCS];
+};
+
 /**
 DLP IOCTLs for Userland
 */
@@ -160,6 +160,9 @@ struct queue_element {
  * @wq_readable:	wait queue head
  * @msg_list:		message list
  * @shrm:		pointer to shrm device information structure
+ * @ring:		control page shared with an mmap reader
+ * @ring_tail:		ring tail up to which messages have been released
+ * @ring_mapped:	the queue is being consumed through the mmap ring
  */
 struct message_queue {
       u8 *fifo_base;
@@ -172,6 +175,9 @@ struct message_queue {
       wait_queue_head_t wq_readable;
       struct list_head msg_list;
       struct shrm_dev *shrm;
+      struct t_dlp_ring *ring;
+      u32 ring_tail;
+      u8 ring_mapped;
 };
 
 /**
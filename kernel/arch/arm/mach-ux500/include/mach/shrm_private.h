@@ -170,6 +170,7 @@ int get_ca_wake_req_state(void);
 /* shrm character interface */
 int isa_init(struct shrm_dev *shrm);
 void isa_exit(struct shrm_dev *shrm);
+int check_space_in_queue(struct message_queue *q, u32 size);
 int add_msg_to_queue(struct message_queue *q, u32 size);
 ssize_t isa_read(struct file *filp, char __user *buf, size_t len,
 							loff_t *ppos);
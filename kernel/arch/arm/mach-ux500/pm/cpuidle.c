@@ -22,6 +22,7 @@
 
 #include "cpuidle.h"
 #include "cpuidle_dbg.h"
+#include "cpuidle_predict.h"
 #include "context.h"
 #include "pm.h"
 #include "timer.h"
@@ -189,6 +190,7 @@ struct cpu_state {
 	ktime_t sched_wake_up;
 	struct cpuidle_device dev;
 	bool restore_arm_core;
+	bool wfi_ready; /* about to execute wfi */
 };
 
 static DEFINE_PER_CPU(struct cpu_state, *cpu_state);
@@ -327,8 +329,36 @@ static bool is_last_cpu_running(void)
 	return atomic_read(&idle_cpus_counter) == num_online_cpus();
 }
 
+/*
+ * A cpu going idle signals an event once it is about to execute wfi and
+ * when it leaves enter_sleep(), so the last cpu can wait for the other
+ * one with wfe instead of polling it.
+ */
+static inline void signal_idle_event(void)
+{
+	__asm__ __volatile__("dsb\n\t" "sev" : : : "memory");
+}
+
+static inline void wait_idle_event(void)
+{
+	__asm__ __volatile__("wfe" : : : "memory");
+}
+
+static bool other_cpus_wfi_ready(void)
+{
+	int cpu;
+	int this_cpu = smp_processor_id();
+
+	smp_rmb();
+	for_each_online_cpu(cpu) {
+		if (cpu != this_cpu && !per_cpu(cpu_state, cpu)->wfi_ready)
+			return false;
+	}
+	return true;
+}
+
 static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
-				 bool gic_frozen)
+				 bool gic_frozen, bool *shortened)
 {
 	int i;
 
@@ -337,27 +367,38 @@ static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
 	bool power_state_req;
 	ktime_t entry_time;
 	s64 delta_us;
+	u32 idle_time;
+	bool waited = false;
+
+	*shortened = false;
 
 	/* If first cpu to sleep, go to most shallow sleep state */
 	if (loc_idle_counter != num_online_cpus())
 		return CI_WFI;
 
 	entry_time = ktime_get();
-	/* If other CPU is going to WFI, but not yet there wait. */
-	while (1) {
-		if (ux500_pm_other_cpu_wfi())
-			break;
+	/*
+	 * If other CPU is going to WFI, but not yet there wait.  Until it
+	 * is ready it is still running enter_sleep() and will signal an
+	 * event, so sleep in wfe; once ready it is only a few instructions
+	 * away from wfi.
+	 */
+	while (!ux500_pm_other_cpu_wfi()) {
+		waited = true;
 
 		/* Check for pending IRQ's */
 		if (ux500_pm_gic_pending_interrupt())
-			return -1;
+			goto abort;
 
 		/* If GIC frozen check for pending IRQ's also via PRCMU */
 		if (gic_frozen && ux500_pm_prcmu_pending_interrupt())
-			return -1;
+			goto abort;
 
-		if (!is_last_cpu_running())
+		if (!is_last_cpu_running()) {
+			ux500_ci_dbg_rendezvous(ktime_sub(ktime_get(),
+							  entry_time), true);
 			return CI_WFI;
+		}
 
 #define MAX_STATE_DETERMINE_LOOP_TIME 100000 /* usec */
 
@@ -365,10 +406,19 @@ static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
 		if (delta_us > MAX_STATE_DETERMINE_LOOP_TIME) {
 			pr_warning("%s: CPU=%d stuck in loop for %lld usec\n",
 				__func__, smp_processor_id(), delta_us);
-			return -1;
+			goto abort;
 		}
+
+		if (other_cpus_wfi_ready())
+			cpu_relax();
+		else
+			wait_idle_event();
 	}
 
+	if (waited)
+		ux500_ci_dbg_rendezvous(ktime_sub(ktime_get(), entry_time),
+					false);
+
 	power_state_req = power_state_active_is_enabled() ||
 		prcmu_is_ac_wake_requested();
 
@@ -382,6 +432,11 @@ static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
 
 	if ((*sleep_time) == UINT_MAX)
 		return CI_WFI;
+
+	/* An interrupt may well come before the next timer */
+	idle_time = ux500_ci_predict_sleep(ktime_get(), *sleep_time);
+	*shortened = idle_time < *sleep_time;
+
 	/*
 	 * Never go deeper than the governor recommends even though it might be
 	 * possible from a scheduled wake up point of view
@@ -395,7 +450,7 @@ static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
 
 	for (i = max_depth; i > 0; i--) {
 
-		if ((*sleep_time) <= cstates[i].threshold)
+		if (idle_time <= cstates[i].threshold)
 			continue;
 
 		if (cstates[i].APE == APE_OFF) {
@@ -410,10 +465,14 @@ static int determine_sleep_state(u32 *sleep_time, int loc_idle_counter,
 	}
 
 	ux500_ci_dbg_register_reason(i, power_state_req,
-				     (*sleep_time),
+				     idle_time,
 				     max_depth);
 
 	return max(CI_WFI, i);
+
+abort:
+	ux500_ci_dbg_rendezvous(ktime_sub(ktime_get(), entry_time), true);
+	return -1;
 }
 
 static int enter_sleep(struct cpuidle_device *dev,
@@ -428,8 +487,10 @@ static int enter_sleep(struct cpuidle_device *dev,
 	struct cpu_state *state;
 	bool slept_well = false;
 	int this_cpu = smp_processor_id();
+	int wake_irq;
 	bool migrate_timer;
 	bool master = false;
+	bool shortened;
 	int loc_idle_counter;
 
 	local_irq_disable();
@@ -464,7 +525,8 @@ static int enter_sleep(struct cpuidle_device *dev,
 	 * Determine sleep state considering both CPUs and
 	 * shared resources like e.g. VAPE
 	 */
-	target = determine_sleep_state(&sleep_time, loc_idle_counter, false);
+	target = determine_sleep_state(&sleep_time, loc_idle_counter, false,
+				       &shortened);
 
 	if (target < 0)
 		/* "target" will be last_state in the cpuidle framework */
@@ -499,7 +561,7 @@ static int enter_sleep(struct cpuidle_device *dev,
 		 */
 		if (target != determine_sleep_state(&sleep_time,
 						    loc_idle_counter,
-						    true)) {
+						    true, &shortened)) {
 			atomic_dec(&master_counter);
 			goto exit;
 		}
@@ -601,6 +663,8 @@ static int enter_sleep(struct cpuidle_device *dev,
 	}
 
 	ux500_ci_dbg_log(target, time_enter);
+	if (shortened)
+		ux500_ci_predict_shortened();
 
 	if (master && cstates[target].ARM != ARM_ON)
 		prcmu_set_power_state(cstates[target].pwrst,
@@ -616,17 +680,32 @@ static int enter_sleep(struct cpuidle_device *dev,
 	 * this CPU in WFI. This is last core to enter sleep, so we need to
 	 * clean both L2 and L1 caches
 	 */
+	state->wfi_ready = true;
+	signal_idle_event();
+
 	if (cstates[state->gov_cstate].ARM == ARM_OFF)
 		context_save_to_sram_and_wfi(cstates[target].ARM == ARM_OFF);
 	else
 		__asm__ __volatile__
 			("dsb\n\t" "wfi\n\t" : : : "memory");
 
+	state->wfi_ready = false;
+
 	if (is_last_cpu_running())
 		ux500_ci_dbg_wake_latency(target, sleep_time);
 
 	time_wake = ktime_get();
 
+	/* Still pending, interrupts are off: tell the predictor who woke us */
+	wake_irq = ux500_pm_gic_pending_irq();
+	if (wake_irq < 0)
+		wake_irq = ux500_pm_prcmu_pending_irq();
+	ux500_ci_predict_wake(wake_irq,
+			      ktime_to_us(time_wake) +
+			      cstates[target].exit_latency >=
+			      ktime_to_us(state->sched_wake_up),
+			      target, time_enter, time_wake);
+
 	slept_well = true;
 
 	restore_sequence(state, time_wake);
@@ -643,6 +722,8 @@ exit:
 exit_fast:
 
 	atomic_dec(&idle_cpus_counter);
+	/* The last cpu may be waiting for us in determine_sleep_state() */
+	signal_idle_event();
 
 	if (target < 0)
 		target = CI_RUNNING;
@@ -744,6 +825,7 @@ static int __init cpuidle_driver_init(void)
 			     PRCMU_WAKEUP(ABB));
 
 	ux500_ci_dbg_init();
+	ux500_ci_predict_init();
 
 	for_each_possible_cpu(cpu)
 		per_cpu(cpu_state, cpu) = kzalloc(sizeof(struct cpu_state),
@@ -771,6 +853,7 @@ static void __exit cpuidle_driver_exit(void)
 	struct cpuidle_device *dev;
 
 	ux500_ci_dbg_remove();
+	ux500_ci_predict_remove();
 
 	for_each_possible_cpu(cpu) {
 		dev = &per_cpu(cpu_state, cpu)->dev;
@@ -69,6 +69,11 @@ struct state_history {
 	int time_blocked;
 	int both_blocked;
 	int gov_blocked;
+	/* waits of the last cpu for the other one to reach wfi */
+	u32 rendezvous;
+	u32 rendezvous_aborts;
+	ktime_t rendezvous_sum;
+	ktime_t rendezvous_max;
 	struct state_history_state *states;
 };
 static DEFINE_PER_CPU(struct state_history, *state_history);
@@ -352,6 +357,24 @@ void ux500_ci_dbg_register_reason(int idx, bool power_state_req,
 	}
 }
 
+void ux500_ci_dbg_rendezvous(ktime_t wait, bool aborted)
+{
+	unsigned long flags;
+	struct state_history *sh;
+
+	spin_lock_irqsave(&dbg_lock, flags);
+
+	sh = per_cpu(state_history, smp_processor_id());
+	sh->rendezvous++;
+	if (aborted)
+		sh->rendezvous_aborts++;
+	sh->rendezvous_sum = ktime_add(sh->rendezvous_sum, wait);
+	if (ktime_to_us(wait) > ktime_to_us(sh->rendezvous_max))
+		sh->rendezvous_max = wait;
+
+	spin_unlock_irqrestore(&dbg_lock, flags);
+}
+
 void ux500_ci_dbg_log(int ctarget, ktime_t enter_time)
 {
 	int i;
@@ -465,6 +488,10 @@ static void state_history_reset(void)
 		sh->time_blocked = 0;
 		sh->both_blocked = 0;
 		sh->gov_blocked = 0;
+		sh->rendezvous = 0;
+		sh->rendezvous_aborts = 0;
+		sh->rendezvous_sum = ktime_set(0, 0);
+		sh->rendezvous_max = ktime_set(0, 0);
 	}
 	spin_unlock_irqrestore(&dbg_lock, flags);
 }
@@ -672,6 +699,16 @@ static int stats_print(struct seq_file *s, void *p)
 		seq_printf(s, "delta accounted vs wall clock: %lld us\n",
 			   ktime_to_us(ktime_sub(wall, total)));
 
+		if (sh->rendezvous) {
+			s64 avg = ktime_to_us(sh->rendezvous_sum);
+
+			do_div(avg, sh->rendezvous);
+			seq_printf(s, "rendezvous: %u aborted: %u "
+				   "avg %lld max %lld us\n",
+				   sh->rendezvous, sh->rendezvous_aborts, avg,
+				   ktime_to_us(sh->rendezvous_max));
+		}
+
 		for (i = 0; i < cstates_len; i++)
 			stats_disp_one(s, sh, total_us, i);
 
@@ -22,6 +22,7 @@ void ux500_ci_dbg_exit_latency(int ctarget, ktime_t now, ktime_t exit,
 
 void ux500_ci_dbg_register_reason(int idx, bool power_state_req,
 				  u32 sleep_time, u32 max_depth);
+void ux500_ci_dbg_rendezvous(ktime_t wait, bool aborted);
 
 bool ux500_ci_dbg_force_ape_on(void);
 int ux500_ci_dbg_deepest_state(void);
@@ -47,6 +48,7 @@ static inline void ux500_ci_dbg_wake_latency(int ctarget, int sleep_time) { }
 
 static inline void ux500_ci_dbg_register_reason(int idx, bool power_state_req,
 						u32 sleep_time, u32 max_depth) { }
+static inline void ux500_ci_dbg_rendezvous(ktime_t wait, bool aborted) { }
 
 static inline bool ux500_ci_dbg_force_ape_on(void)
 {
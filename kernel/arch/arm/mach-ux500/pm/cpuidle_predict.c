@@ -0,0 +1,250 @@
+/*
+ * Copyright (C) ST-Ericsson SA 2011
+ *
+ * License terms: GNU General Public License (GPL) version 2
+ *
+ * Idle length predictor for the ux500 cpuidle driver.
+ *
+ * Most wake ups on this platform are not timers but interrupts from the
+ * modem, the touch screen or the WLAN, which often come at a steady pace.
+ * The interval between two wake ups is learnt for each such interrupt and
+ * the idle time is predicted as the earliest of the next timer and the
+ * next expected interrupt, so that states with a high entry cost are not
+ * entered just before one of them fires.
+ */
+
+#include <linux/kernel.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include "cpuidle.h"
+#include "cpuidle_predict.h"
+
+/* Number of interrupts tracked at the same time */
+#define PREDICT_SOURCES		8
+/* Samples needed before an interrupt is trusted */
+#define PREDICT_MIN_SAMPLES	4
+/* Longer intervals are not considered periodic */
+#define PREDICT_MAX_INTERVAL	(2 * USEC_PER_SEC)
+#define PREDICT_MAX_STATES	10
+
+struct wake_source {
+	int irq;
+	u32 samples;
+	s64 last_us;	/* last wake up */
+	s32 avg_us;	/* average interval */
+	s32 dev_us;	/* average deviation from avg_us */
+};
+
+static DEFINE_SPINLOCK(predict_lock);
+static struct wake_source sources[PREDICT_SOURCES];
+static u32 predict_enable = 1;
+
+static struct {
+	u32 shortened;	/* predictions below the next timer */
+	u32 timer_wakes;
+	u32 irq_wakes;
+	u32 entries[PREDICT_MAX_STATES];
+	u32 early[PREDICT_MAX_STATES];	/* woken before the threshold */
+} predict_stats;
+
+static struct cstate *cstates;
+static int cstates_len;
+
+u32 ux500_ci_predict_sleep(ktime_t now, u32 sleep_time)
+{
+	s64 now_us = ktime_to_us(now);
+	s64 next;
+	u32 predicted = sleep_time;
+	int i;
+
+	if (!predict_enable)
+		return sleep_time;
+
+	spin_lock(&predict_lock);
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		struct wake_source *s = &sources[i];
+
+		if (s->samples < PREDICT_MIN_SAMPLES ||
+		    s->dev_us > s->avg_us / 2)
+			continue;
+
+		/* Missed its slot, it is no longer coming at this pace */
+		if (now_us > s->last_us + s->avg_us + 2 * s->dev_us)
+			continue;
+
+		next = s->last_us + s->avg_us - s->dev_us - now_us;
+		if (next < 0)
+			next = 0;
+		if (next < predicted)
+			predicted = (u32)next;
+	}
+
+	spin_unlock(&predict_lock);
+
+	return predicted;
+}
+
+void ux500_ci_predict_shortened(void)
+{
+	spin_lock(&predict_lock);
+	predict_stats.shortened++;
+	spin_unlock(&predict_lock);
+}
+
+static struct wake_source *find_source(int irq)
+{
+	struct wake_source *oldest = &sources[0];
+	int i;
+
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		if (sources[i].samples && sources[i].irq == irq)
+			return &sources[i];
+		if (!sources[i].samples ||
+		    sources[i].last_us < oldest->last_us)
+			oldest = &sources[i];
+	}
+
+	oldest->irq = irq;
+	oldest->samples = 0;
+	return oldest;
+}
+
+void ux500_ci_predict_wake(int irq, bool timer, int target,
+			   ktime_t enter, ktime_t wake)
+{
+	struct wake_source *s;
+	s64 wake_us = ktime_to_us(wake);
+	s64 interval;
+	s32 err;
+
+	spin_lock(&predict_lock);
+
+	if (target >= 0 && target < PREDICT_MAX_STATES) {
+		predict_stats.entries[target]++;
+		if (ktime_to_us(ktime_sub(wake, enter)) <
+		    cstates[target].threshold)
+			predict_stats.early[target]++;
+	}
+
+	if (timer || irq < 0) {
+		predict_stats.timer_wakes++;
+		goto out;
+	}
+	predict_stats.irq_wakes++;
+
+	s = find_source(irq);
+	if (!s->samples)
+		goto first;
+
+	interval = wake_us - s->last_us;
+	if (interval > PREDICT_MAX_INTERVAL) {
+		s->samples = 0;
+		goto first;
+	}
+
+	if (s->samples == 1) {
+		s->avg_us = (s32)interval;
+		s->dev_us = (s32)interval / 2;
+	} else {
+		err = (s32)interval - s->avg_us;
+		s->avg_us += err / 8;
+		s->dev_us += (abs(err) - s->dev_us) / 4;
+	}
+first:
+	s->samples++;
+	s->last_us = wake_us;
+out:
+	spin_unlock(&predict_lock);
+}
+
+static int predict_stats_print(struct seq_file *m, void *p)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&predict_lock, flags);
+
+	seq_printf(m, "shortened predictions: %u\n", predict_stats.shortened);
+	seq_printf(m, "timer wake ups: %u\ninterrupt wake ups: %u\n",
+		   predict_stats.timer_wakes, predict_stats.irq_wakes);
+
+	seq_printf(m, "\nstate  entries  early\n");
+	for (i = 0; i < min(cstates_len, PREDICT_MAX_STATES); i++)
+		seq_printf(m, "%5d %8u %6u\n", i, predict_stats.entries[i],
+			   predict_stats.early[i]);
+
+	seq_printf(m, "\n irq samples interval deviation\n");
+	for (i = 0; i < PREDICT_SOURCES; i++) {
+		if (!sources[i].samples)
+			continue;
+		seq_printf(m, "%4d %7u %8d %9d\n", sources[i].irq,
+			   sources[i].samples, sources[i].avg_us,
+			   sources[i].dev_us);
+	}
+
+	spin_unlock_irqrestore(&predict_lock, flags);
+	return 0;
+}
+
+static ssize_t predict_stats_write(struct file *file,
+				   const char __user *user_buf,
+				   size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&predict_lock, flags);
+	memset(&predict_stats, 0, sizeof(predict_stats));
+	memset(sources, 0, sizeof(sources));
+	spin_unlock_irqrestore(&predict_lock, flags);
+
+	return count;
+}
+
+static int predict_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, predict_stats_print, inode->i_private);
+}
+
+static const struct file_operations predict_stats_fops = {
+	.open = predict_stats_open,
+	.write = predict_stats_write,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+	.owner = THIS_MODULE,
+};
+
+static struct dentry *predict_dir;
+
+void ux500_ci_predict_init(void)
+{
+	cstates = ux500_ci_get_cstates(&cstates_len);
+
+	predict_dir = debugfs_create_dir("cpuidle_predict", NULL);
+	if (IS_ERR_OR_NULL(predict_dir))
+		return;
+
+	if (IS_ERR_OR_NULL(debugfs_create_u32("enable",
+					      S_IWUSR | S_IWGRP | S_IRUGO,
+					      predict_dir, &predict_enable)))
+		goto fail;
+
+	if (IS_ERR_OR_NULL(debugfs_create_file("stats",
+					       S_IWUSR | S_IWGRP | S_IRUGO,
+					       predict_dir, NULL,
+					       &predict_stats_fops)))
+		goto fail;
+
+	return;
+fail:
+	debugfs_remove_recursive(predict_dir);
+	predict_dir = NULL;
+}
+
+void ux500_ci_predict_remove(void)
+{
+	debugfs_remove_recursive(predict_dir);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) ST-Ericsson SA 2011
+ *
+ * License terms: GNU General Public License (GPL) version 2
+ */
+
+#ifndef CPUIDLE_PREDICT_H
+#define CPUIDLE_PREDICT_H
+
+#include <linux/ktime.h>
+
+void ux500_ci_predict_init(void);
+void ux500_ci_predict_remove(void);
+
+/*
+ * ux500_ci_predict_sleep() - expected idle time, in us, given the time
+ * left until the next timer; never longer than sleep_time.
+ */
+u32 ux500_ci_predict_sleep(ktime_t now, u32 sleep_time);
+
+/*
+ * ux500_ci_predict_shortened() - count a sleep state chosen on a prediction
+ * shorter than the time left until the next timer.
+ */
+void ux500_ci_predict_shortened(void);
+
+/*
+ * ux500_ci_predict_wake() - learn from a wake up of the system.
+ * @irq: wake up interrupt, -1 if unknown
+ * @timer: woken by the scheduled timer rather than by an interrupt
+ * @target: state that was entered
+ * @enter: when the state was entered
+ * @wake: when the cpu left wfi
+ */
+void ux500_ci_predict_wake(int irq, bool timer, int target,
+			   ktime_t enter, ktime_t wake);
+
+#endif
@@ -95,6 +95,25 @@ bool ux500_pm_gic_pending_interrupt(void)
 	return false;
 }
 
+int ux500_pm_gic_pending_irq(void)
+{
+	u32 pending;
+	int i;
+
+	for (i = 0; i < GIC_NUMBER_REGS; i++) {
+
+		pending = readl(__io_address(U8500_GIC_DIST_BASE) +
+				GIC_DIST_PENDING_SET + i * 4) &
+			readl(__io_address(U8500_GIC_DIST_BASE) +
+			      GIC_DIST_ENABLE_SET + i * 4);
+
+		if (pending)
+			return i * 32 + __ffs(pending);
+	}
+
+	return -1;
+}
+
 #define GIC_NUMBER_SPI_REGS 4
 bool ux500_pm_prcmu_pending_interrupt(void)
 {
@@ -114,6 +133,24 @@ bool ux500_pm_prcmu_pending_interrupt(void)
 	return false;
 }
 
+int ux500_pm_prcmu_pending_irq(void)
+{
+	u32 pending;
+	int i;
+
+	for (i = 0; i < GIC_NUMBER_SPI_REGS; i++) {
+
+		pending = readl(PRCM_ARMITVAL31TO0 + i * 4) &
+			readl(PRCM_ARMITMSK31TO0 + i * 4);
+
+		/* +1 due to skip STI and PPI */
+		if (pending)
+			return (i + 1) * 32 + __ffs(pending);
+	}
+
+	return -1;
+}
+
 void ux500_pm_prcmu_set_ioforce(bool enable)
 {
 	if (enable)
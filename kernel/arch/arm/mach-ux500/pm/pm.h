@@ -47,6 +47,22 @@ bool ux500_pm_gic_pending_interrupt(void);
  */
 bool ux500_pm_prcmu_pending_interrupt(void);
 
+/**
+ * ux500_pm_gic_pending_irq()
+ *
+ * returns the lowest pending and enabled interrupt number in the GIC,
+ * or -1 if there is none.
+ */
+int ux500_pm_gic_pending_irq(void);
+
+/**
+ * ux500_pm_prcmu_pending_irq()
+ *
+ * returns the lowest pending interrupt number seen by the PRCMU while
+ * the GIC is decoupled, or -1 if there is none.
+ */
+int ux500_pm_prcmu_pending_irq(void);
+
 /**
  * ux500_pm_prcmu_set_ioforce()
  *
@@ -10,7 +10,6 @@
 #include <linux/earlysuspend.h>
 #include <linux/cpu.h>
 #include <linux/sched.h>
-#include <linux/tick.h>
 #include <linux/workqueue.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
@@ -18,10 +17,13 @@
 #include <linux/kernel_stat.h>
 #include <linux/ktime.h>
 #include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/slab.h>
 #include <mach/prcmu.h>
 #include "cpufreq-dbx500.h"
 
 #define CPULOAD_MEAS_DELAY	3000 /* 3 secondes of delta */
+#define MIN_HOTPLUG_DELAY	20 /* ms, floor of the plug check period */
 #define PRCMU_TCDM_VOICE_CALL_FLAG (U8500_PRCMU_TCDM_BASE + 0xDD4)
 
 /* debug */
@@ -40,18 +42,12 @@ enum ux500_uc {
 	UX500_UC_MAX,
 };
 
-/* cpu load monitor struct */
+/* cpu load monitor: periods averaged for the load trend */
 #define LOAD_MONITOR 4
-struct hotplug_cpu_info {
-	cputime64_t prev_cpu_wall;
-	cputime64_t prev_cpu_idle;
-	cputime64_t prev_cpu_io;
-	unsigned int load[LOAD_MONITOR];
-	unsigned int io[LOAD_MONITOR];
-	unsigned int idx;
-};
+static struct cpu_load_window usecase_load;
 
-static DEFINE_PER_CPU(struct hotplug_cpu_info, hotplug_info);
+/* load figures of the trigger criteria are in percent */
+#define LOAD_PERCENT(x) (((x) * 100) >> CPU_LOAD_SHIFT)
 
 /* Auto trigger criteria */
 /* loadavg threshold */
@@ -67,7 +63,41 @@ static unsigned long max_instant = 85;
 
 /* Number of interrupts per second before exiting auto mode */
 static u32 exit_irq_per_s = 1000;
-static u64 old_num_irqs;
+
+struct irq_rate {
+	u64 num_irqs;
+	ktime_t last;
+};
+static struct irq_rate usecase_irqs;
+
+/*
+ * Plug check: while the second cpu is offline it is brought back as soon
+ * as the runnable tasks, averaged over a few hotplug_delay periods, or
+ * the interrupt rate show that one cpu is not enough, or on user input,
+ * instead of waiting for the next CPULOAD_MEAS_DELAY decision.  The
+ * load based decision then leaves it online for at least plug_hold ms.
+ */
+static unsigned long hotplug_delay = 100;	/* ms */
+static unsigned long max_nr_running = 150;	/* runnable tasks * 100 */
+static unsigned long plug_hold = CPULOAD_MEAS_DELAY;	/* ms */
+static unsigned long plug_hold_until;	/* jiffies */
+static unsigned long avg_nr_running;
+static struct cpu_load_window hotplug_load;
+static struct irq_rate hotplug_irqs;
+
+/* cpu_up()/cpu_down() latency, reported in debugfs */
+struct hotplug_latency {
+	u32 count;
+	u32 max_us;
+	u64 total_us;
+};
+
+static struct {
+	struct hotplug_latency up;
+	struct hotplug_latency down;
+	u32 load_plugs;
+	u32 input_plugs;
+} hotplug_stats;
 
 static DEFINE_MUTEX(user_config_mutex);
 static DEFINE_MUTEX(state_mutex);
@@ -141,6 +171,8 @@ static struct usecase_config usecase_conf[UX500_UC_MAX] = {
 
 /* daemon */
 static struct delayed_work work_usecase;
+static struct delayed_work work_hotplug;
+static struct work_struct work_input;
 static struct early_suspend usecase_early_suspend;
 
 /* calculate loadavg */
@@ -169,47 +201,15 @@ static unsigned long determine_cpu_load(void)
 
 	/* get cpu load of each cpu */
 	for_each_online_cpu(i) {
-		unsigned int load, iowait;
-		unsigned int idle_time, iowait_time, wall_time;
-		cputime64_t cur_wall_time, cur_idle_time, cur_iowait_time;
-		struct hotplug_cpu_info *info;
+		struct cpu_load_sample sample;
+		unsigned int load;
 
-		info = &per_cpu(hotplug_info, i);
-
-		/* update both cur_idle_time and cur_wall_time */
-		cur_idle_time = get_cpu_idle_time_us(i, &cur_wall_time);
-		cur_iowait_time = get_cpu_iowait_time_us(i, &cur_wall_time);
-
-		/* how much wall time has passed since last iteration? */
-		wall_time = (unsigned int) cputime64_sub(cur_wall_time,
-							info->prev_cpu_wall);
-		info->prev_cpu_wall = cur_wall_time;
-
-		/* how much idle time has passed since last iteration? */
-		idle_time = (unsigned int) cputime64_sub(cur_idle_time,
-							info->prev_cpu_idle);
-		info->prev_cpu_idle = cur_idle_time;
-
-		/* how much io wait time has passed since last iteration? */
-		iowait_time = (unsigned int) cputime64_sub(cur_iowait_time,
-							info->prev_cpu_io);
-		info->prev_cpu_io = cur_iowait_time;
-
-		if (unlikely(!wall_time || wall_time < idle_time))
+		if (cpu_load_sample(&usecase_load, i, &sample))
 			continue;
 
 		/* load is the percentage of time not spent in idle */
-		load = 100 * (wall_time - idle_time) / wall_time;
-		info->load[info->idx] = load;
-		hp_printk("cpu %d load %u ", i, load);
-
-		/* iowait is the percentage of time not spent in io wait */
-		iowait = 100 * (iowait_time) / wall_time;
-		info->io[info->idx++] = load;
-		hp_printk("iowait %u\n", iowait);
-
-		if (info->idx >= LOAD_MONITOR)
-			info->idx = 0;
+		load = LOAD_PERCENT(sample.load);
+		hp_printk("cpu %d load %u\n", i, load);
 
 		total_load += load;
 	}
@@ -219,20 +219,14 @@ static unsigned long determine_cpu_load(void)
 
 static unsigned long determine_cpu_load_trend(void)
 {
-	int i, j, k;
+	int i;
 	unsigned long total_load = 0;
 
 	/* Get cpu load of each cpu */
 	for_each_online_cpu(i) {
-		unsigned int load = 0;
-		struct hotplug_cpu_info *info;
+		unsigned int load;
 
-		info = &per_cpu(hotplug_info, i);
-
-		for (k = 0, j = info->idx; k < LOAD_MONITOR; k++, j++)
-			load +=	info->load[j];
-
-		load /= LOAD_MONITOR;
+		load = LOAD_PERCENT(cpu_load_trend(&usecase_load, i));
 
 		hp_printk("cpu %d load trend %u\n", i, load);
 
@@ -244,21 +238,15 @@ static unsigned long determine_cpu_load_trend(void)
 
 static unsigned long determine_cpu_balance_trend(void)
 {
-	int i, j, k;
+	int i;
 	unsigned long total_load = 0;
 	unsigned long min_load = (unsigned long) (-1);
 
 	/* Get cpu load of each cpu */
 	for_each_online_cpu(i) {
-		unsigned int load = 0;
-		struct hotplug_cpu_info *info;
-
-	info = &per_cpu(hotplug_info, i);
+		unsigned int load;
 
-		for (k = 0, j = info->idx; k < LOAD_MONITOR; k++, j++)
-			load +=	info->load[j];
-
-		load /= LOAD_MONITOR;
+		load = LOAD_PERCENT(cpu_load_trend(&usecase_load, i));
 
 		if (min_load > load)
 			min_load = load;
@@ -277,32 +265,16 @@ static void init_cpu_load_trend(void)
 {
 	int i;
 
-	for_each_possible_cpu(i) {
-		struct hotplug_cpu_info *info;
-		int j;
-
-		info = &per_cpu(hotplug_info, i);
-
-		info->prev_cpu_idle = get_cpu_idle_time_us(i,
-						&(info->prev_cpu_wall));
-		info->prev_cpu_io = get_cpu_iowait_time_us(i,
-						&(info->prev_cpu_wall));
-
-		for (j = 0; j < LOAD_MONITOR; j++) {
-			info->load[j] = 100;
-			info->io[j] = 100;
-		}
-		info->idx = 0;
-	}
+	for_each_possible_cpu(i)
+		cpu_load_window_reset(&usecase_load, i, CPU_LOAD_ONE);
 }
 
-static u32 get_num_interrupts_per_s(void)
+static u32 get_num_interrupts_per_s(struct irq_rate *rate)
 {
 	int cpu;
 	int i;
 	u64 num_irqs = 0;
 	ktime_t now;
-	static ktime_t last;
 	unsigned int delta;
 	u32 irqs = 0;
 
@@ -313,21 +285,31 @@ static u32 get_num_interrupts_per_s(void)
 			num_irqs += kstat_irqs_cpu(i, cpu);
 	}
 	pr_debug("%s: total num irqs: %lld, previous %lld\n",
-					__func__, num_irqs, old_num_irqs);
+					__func__, num_irqs, rate->num_irqs);
 
-	if (old_num_irqs > 0) {
-		delta = (u32)ktime_to_ms(ktime_sub(now, last)) / 1000;
-		irqs = ((u32)(num_irqs - old_num_irqs)) / delta;
-	}
+	delta = (u32)ktime_to_ms(ktime_sub(now, rate->last));
+	if (rate->num_irqs > 0 && delta)
+		irqs = div_u64((num_irqs - rate->num_irqs) * MSEC_PER_SEC,
+			       delta);
 
-	old_num_irqs = num_irqs;
-	last = now;
+	rate->num_irqs = num_irqs;
+	rate->last = now;
 
 	pr_debug("delta irqs per sec:%d\n", irqs);
 
 	return irqs;
 }
 
+static void hotplug_account(struct hotplug_latency *lat, ktime_t start)
+{
+	u32 us = (u32)ktime_to_us(ktime_sub(ktime_get(), start));
+
+	lat->count++;
+	lat->total_us += us;
+	if (us > lat->max_us)
+		lat->max_us = us;
+}
+
 static int set_cpufreq(int cpu, int min_freq, int max_freq)
 {
 	int ret;
@@ -379,11 +361,18 @@ static void set_cpu_config(enum ux500_uc new_uc)
 
 	/* Cpu hotplug */
 	if (!(usecase_conf[new_uc].second_cpu_online) &&
-	    (num_online_cpus() > 1))
+	    (num_online_cpus() > 1)) {
+		ktime_t start = ktime_get();
+
 		cpu_down(1);
-	else if ((usecase_conf[new_uc].second_cpu_online) &&
-		 (num_online_cpus() < 2))
+		hotplug_account(&hotplug_stats.down, start);
+	} else if ((usecase_conf[new_uc].second_cpu_online) &&
+		 (num_online_cpus() < 2)) {
+		ktime_t start = ktime_get();
+
 		cpu_up(1);
+		hotplug_account(&hotplug_stats.up, start);
+	}
 
 	if(usecase_conf[new_uc].max_arm_opp)
 		max_freq = dbx500_cpufreq_percent2freq(usecase_conf[new_uc].max_arm_opp);
@@ -425,6 +414,56 @@ exit:
 	user_config_updated = false;
 }
 
+static unsigned long hotplug_jiffies(void)
+{
+	return msecs_to_jiffies(max(hotplug_delay,
+				    (unsigned long)MIN_HOTPLUG_DELAY));
+}
+
+/* Start the load decision and the plug check, user_config_mutex held */
+static void start_usecase_work(void)
+{
+	int i;
+
+	is_work_scheduled = true;
+	/* jiffies starts out negative, a zero deadline would hold for minutes */
+	plug_hold_until = jiffies;
+
+	for_each_possible_cpu(i)
+		cpu_load_window_reset(&hotplug_load, i, 0);
+	avg_nr_running = 0;
+	get_num_interrupts_per_s(&hotplug_irqs);
+
+	schedule_delayed_work_on(0, &work_usecase,
+				msecs_to_jiffies(CPULOAD_MEAS_DELAY));
+	schedule_delayed_work_on(0, &work_hotplug, hotplug_jiffies());
+}
+
+/*
+ * Stop both works; they take user_config_mutex, so it must not be held
+ * by the caller.
+ */
+static void stop_usecase_work(void)
+{
+	cancel_delayed_work_sync(&work_usecase);
+	cancel_delayed_work_sync(&work_hotplug);
+	cancel_work_sync(&work_input);
+}
+
+/* Whether a burst of activity may bring the second cpu online */
+static bool plug_allowed(void)
+{
+	return is_work_scheduled && num_online_cpus() < 2 &&
+		!(usecase_conf[UX500_UC_USER].enable &&
+		  usecase_conf[UX500_UC_USER].force_usecase);
+}
+
+static void plug_second_cpu(void)
+{
+	plug_hold_until = jiffies + msecs_to_jiffies(plug_hold);
+	set_cpu_config(UX500_UC_NORMAL);
+}
+
 /*
  * Start load measurment every 6 s in order detrmine if can unplug one CPU.
  * In order to not corrupt measurment, the first load average is not done
@@ -439,13 +478,8 @@ static void usecase_earlysuspend_callback(struct early_suspend *h)
 	is_early_suspend = true;
 
 	if (usecase_conf[UX500_UC_AUTO].enable ||
-		usecase_conf[UX500_UC_USER].enable) {
-
-		is_work_scheduled = true;
-
-		schedule_delayed_work_on(0, &work_usecase,
-				msecs_to_jiffies(CPULOAD_MEAS_DELAY));
-	}
+		usecase_conf[UX500_UC_USER].enable)
+		start_usecase_work();
 
 	mutex_unlock(&user_config_mutex);
 }
@@ -462,7 +496,7 @@ static void usecase_lateresume_callback(struct early_suspend *h)
 		 * be unlocked before we call to cancel the work.
 		 */
 		mutex_unlock(&user_config_mutex);
-		cancel_delayed_work_sync(&work_usecase);
+		stop_usecase_work();
 		mutex_lock(&user_config_mutex);
 		is_work_scheduled = false;
 	}
@@ -504,7 +538,7 @@ static void delayed_usecase_work(struct work_struct *work)
 	hp_printk("load balancing trend = %lu min %lu\n",
 					balance, max_unbalance);
 
-	irqs_per_s = get_num_interrupts_per_s();
+	irqs_per_s = get_num_interrupts_per_s(&usecase_irqs);
 
 	/* Dont let configuration change in the middle of our calculations. */
 	mutex_lock(&user_config_mutex);
@@ -535,6 +569,10 @@ static void delayed_usecase_work(struct work_struct *work)
 		dec_perf = true;
 	}
 
+	/* Keep a cpu plugged by the plug check for at least plug_hold */
+	if (dec_perf && time_before(jiffies, plug_hold_until))
+		dec_perf = false;
+
 	/*
 	 * set_cpu_config() will not update the config unless it has been
 	 * changed.
@@ -558,6 +596,112 @@ static void delayed_usecase_work(struct work_struct *work)
 
 }
 
+static void delayed_hotplug_work(struct work_struct *work)
+{
+	unsigned long nr_running = 0;
+	u32 irqs_per_s;
+	int i;
+
+	for_each_online_cpu(i) {
+		struct cpu_load_sample sample;
+
+		if (!cpu_load_sample(&hotplug_load, i, &sample))
+			nr_running += LOAD_PERCENT(sample.nr);
+	}
+	avg_nr_running = (3 * avg_nr_running + nr_running) / 4;
+	irqs_per_s = get_num_interrupts_per_s(&hotplug_irqs);
+
+	if (avg_nr_running > max_nr_running || irqs_per_s > exit_irq_per_s) {
+		mutex_lock(&user_config_mutex);
+		if (plug_allowed()) {
+			hp_printk("plug: nr_running %lu irqs %u\n",
+				  avg_nr_running, irqs_per_s);
+			hotplug_stats.load_plugs++;
+			plug_second_cpu();
+		}
+		mutex_unlock(&user_config_mutex);
+	}
+
+	schedule_delayed_work_on(0, &work_hotplug, hotplug_jiffies());
+}
+
+static void usecase_input_work(struct work_struct *work)
+{
+	mutex_lock(&user_config_mutex);
+	if (plug_allowed()) {
+		hotplug_stats.input_plugs++;
+		plug_second_cpu();
+	}
+	mutex_unlock(&user_config_mutex);
+}
+
+static void usecase_input_event(struct input_handle *handle,
+				unsigned int type, unsigned int code, int value)
+{
+	/* rechecked under user_config_mutex by the work */
+	if (is_work_scheduled && num_online_cpus() < 2)
+		schedule_work(&work_input);
+}
+
+static int usecase_input_connect(struct input_handler *handler,
+				 struct input_dev *dev,
+				 const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "usecase";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err_free_handle;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err_unregister_handle;
+
+	return 0;
+
+err_unregister_handle:
+	input_unregister_handle(handle);
+err_free_handle:
+	kfree(handle);
+	return error;
+}
+
+static void usecase_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id usecase_input_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_KEY) },
+	},
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+	},
+	{ },
+};
+
+static struct input_handler usecase_input_handler = {
+	.event		= usecase_input_event,
+	.connect	= usecase_input_connect,
+	.disconnect	= usecase_input_disconnect,
+	.name		= "usecase",
+	.id_table	= usecase_input_ids,
+};
+
 static struct dentry *usecase_dir;
 
 #ifdef CONFIG_DEBUG_FS
@@ -591,6 +735,9 @@ define_set(max_unbalance);
 define_set(trend_unbalance);
 define_set(min_trend);
 define_set(max_instant);
+define_set(hotplug_delay);
+define_set(max_nr_running);
+define_set(plug_hold);
 define_set(debug);
 
 #define define_print(_name) \
@@ -605,6 +752,9 @@ define_print(max_unbalance);
 define_print(trend_unbalance);
 define_print(min_trend);
 define_print(max_instant);
+define_print(hotplug_delay);
+define_print(max_nr_running);
+define_print(plug_hold);
 define_print(debug);
 
 #define define_open(_name) \
@@ -619,6 +769,9 @@ define_open(max_unbalance);
 define_open(trend_unbalance);
 define_open(min_trend);
 define_open(max_instant);
+define_open(hotplug_delay);
+define_open(max_nr_running);
+define_open(plug_hold);
 define_open(debug);
 
 #define define_dbg_file(_name) \
@@ -638,6 +791,9 @@ define_dbg_file(max_unbalance);
 define_dbg_file(trend_unbalance);
 define_dbg_file(min_trend);
 define_dbg_file(max_instant);
+define_dbg_file(hotplug_delay);
+define_dbg_file(max_nr_running);
+define_dbg_file(plug_hold);
 define_dbg_file(debug);
 
 struct dbg_file {
@@ -660,9 +816,45 @@ static struct dbg_file debug_entry[] = {
 	define_dbg_entry(trend_unbalance),
 	define_dbg_entry(min_trend),
 	define_dbg_entry(max_instant),
+	define_dbg_entry(hotplug_delay),
+	define_dbg_entry(max_nr_running),
+	define_dbg_entry(plug_hold),
 	define_dbg_entry(debug),
 };
 
+static int hotplug_stats_print(struct seq_file *s, void *p)
+{
+	seq_printf(s, "online: %u avg %llu us max %u us\n",
+		   hotplug_stats.up.count,
+		   hotplug_stats.up.count ?
+		   div_u64(hotplug_stats.up.total_us,
+			   hotplug_stats.up.count) : 0,
+		   hotplug_stats.up.max_us);
+	seq_printf(s, "offline: %u avg %llu us max %u us\n",
+		   hotplug_stats.down.count,
+		   hotplug_stats.down.count ?
+		   div_u64(hotplug_stats.down.total_us,
+			   hotplug_stats.down.count) : 0,
+		   hotplug_stats.down.max_us);
+	seq_printf(s, "load plugs: %u\ninput plugs: %u\n",
+		   hotplug_stats.load_plugs, hotplug_stats.input_plugs);
+	seq_printf(s, "avg nr_running: %lu\n", avg_nr_running);
+	return 0;
+}
+
+static int hotplug_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, hotplug_stats_print, inode->i_private);
+}
+
+static const struct file_operations hotplug_stats_fops = {
+	.open = hotplug_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+	.owner = THIS_MODULE,
+};
+
 static int setup_debugfs(void)
 {
 	int i;
@@ -685,6 +877,11 @@ static int setup_debugfs(void)
 					      usecase_dir,
 					      &exit_irq_per_s)))
 		goto fail;
+
+	if (IS_ERR_OR_NULL(debugfs_create_file("hotplug_stats", S_IRUGO,
+					       usecase_dir, NULL,
+					       &hotplug_stats_fops)))
+		goto fail;
 	return 0;
 fail:
 	debugfs_remove_recursive(usecase_dir);
@@ -850,14 +1047,11 @@ static ssize_t store_dc_attr(struct sysdev_class *class,
 		if ((is_early_suspend ||
 			(usecase_conf[UX500_UC_USER].enable &&
 			usecase_conf[UX500_UC_USER].force_usecase)) &&
-			!is_work_scheduled) {
-			schedule_delayed_work_on(0, &work_usecase,
-				msecs_to_jiffies(CPULOAD_MEAS_DELAY));
-			is_work_scheduled = true;
-		}
+			!is_work_scheduled)
+			start_usecase_work();
 	} else if (is_work_scheduled) {
 		mutex_unlock(&user_config_mutex);
-		cancel_delayed_work_sync(&work_usecase);
+		stop_usecase_work();
 		mutex_lock(&user_config_mutex);
 		is_work_scheduled = false;
 		set_cpu_config(UX500_UC_NORMAL);
@@ -928,28 +1122,46 @@ static int __init init_usecase_devices(void)
 	usecase_early_suspend.level = 200;
 	usecase_early_suspend.suspend = usecase_earlysuspend_callback;
 	usecase_early_suspend.resume = usecase_lateresume_callback;
+	/* May run alongside the other async handlers of its level */
+	usecase_early_suspend.async = true;
 	register_early_suspend(&usecase_early_suspend);
 
 	/* register delayed queuework */
 	INIT_DELAYED_WORK_DEFERRABLE(&work_usecase,
 				     delayed_usecase_work);
+	INIT_DELAYED_WORK_DEFERRABLE(&work_hotplug,
+				     delayed_hotplug_work);
+	INIT_WORK(&work_input, usecase_input_work);
 
+	err = cpu_load_window_init(&usecase_load, "usecase", LOAD_MONITOR);
+	if (err)
+		goto error;
+	err = cpu_load_window_init(&hotplug_load, "usecase-hotplug", 1);
+	if (err)
+		goto error0;
 	init_cpu_load_trend();
 
 	err = setup_debugfs();
 	if (err)
-		goto error;
+		goto error1;
 	err = usecase_sysfs_init();
 	if (err)
 		goto error2;
 
 	usecase_cpuidle_init();
 
+	if (input_register_handler(&usecase_input_handler))
+		pr_err("usecase-gov: input_register_handler failed\n");
+
 	prcmu_qos_add_requirement(PRCMU_QOS_ARM_OPP, "usecase", 25);
 
 	return 0;
 error2:
 	debugfs_remove_recursive(usecase_dir);
+error1:
+	cpu_load_window_exit(&hotplug_load);
+error0:
+	cpu_load_window_exit(&usecase_load);
 error:
 	unregister_early_suspend(&usecase_early_suspend);
 	return err;
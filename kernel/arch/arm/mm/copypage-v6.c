@@ -11,7 +11,10 @@
 #include <linux/spinlock.h>
 #include <linux/mm.h>
 #include <linux/highmem.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
 
+#include <asm/neon.h>
 #include <asm/pgtable.h>
 #include <asm/shmparam.h>
 #include <asm/tlbflush.h>
@@ -29,6 +32,48 @@
 
 static DEFINE_SPINLOCK(v6_lock);
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void copy_page_neon(void *to, const void *from);
+extern void clear_page_neon(void *to);
+
+/*
+ * -1: pick by timing both at boot, 0: never use NEON, 1: always use it
+ * when present.
+ */
+static int v6_neon_param = -1;
+static int v6_use_neon __read_mostly;
+
+static int __init v6_neon_setup(char *str)
+{
+	get_option(&str, &v6_neon_param);
+	return 1;
+}
+__setup("neon_copypage=", v6_neon_setup);
+
+static inline void v6_copy_page(void *kto, void *kfrom)
+{
+	if (v6_use_neon) {
+		kernel_neon_begin();
+		copy_page_neon(kto, kfrom);
+		kernel_neon_end();
+	} else
+		copy_page(kto, kfrom);
+}
+
+static inline void v6_clear_page(void *kaddr)
+{
+	if (v6_use_neon) {
+		kernel_neon_begin();
+		clear_page_neon(kaddr);
+		kernel_neon_end();
+	} else
+		clear_page(kaddr);
+}
+#else
+#define v6_copy_page(kto, kfrom)	copy_page(kto, kfrom)
+#define v6_clear_page(kaddr)		clear_page(kaddr)
+#endif
+
 /*
  * Copy the user page.  No aliasing to deal with so we can just
  * attack the kernel's existing mapping of these pages.
@@ -40,7 +85,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 
 	kfrom = kmap_atomic(from, KM_USER0);
 	kto = kmap_atomic(to, KM_USER1);
-	copy_page(kto, kfrom);
+	v6_copy_page(kto, kfrom);
 	__cpuc_flush_dcache_area(kto, PAGE_SIZE);
 	kunmap_atomic(kto, KM_USER1);
 	kunmap_atomic(kfrom, KM_USER0);
@@ -53,7 +98,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 static void v6_clear_user_highpage_nonaliasing(struct page *page, unsigned long vaddr)
 {
 	void *kaddr = kmap_atomic(page, KM_USER0);
-	clear_page(kaddr);
+	v6_clear_page(kaddr);
 	kunmap_atomic(kaddr, KM_USER0);
 }
 
@@ -100,7 +145,7 @@ static void v6_copy_user_highpage_aliasing(struct page *to,
 	flush_tlb_kernel_page(kfrom);
 	flush_tlb_kernel_page(kto);
 
-	copy_page((void *)kto, (void *)kfrom);
+	v6_copy_page((void *)kto, (void *)kfrom);
 
 	spin_unlock(&v6_lock);
 }
@@ -126,7 +171,7 @@ static void v6_clear_user_highpage_aliasing(struct page *page, unsigned long vad
 
 	set_pte_ext(TOP_PTE(to_address) + offset, pfn_pte(page_to_pfn(page), PAGE_KERNEL), 0);
 	flush_tlb_kernel_page(to);
-	clear_page((void *)to);
+	v6_clear_page((void *)to);
 
 	spin_unlock(&v6_lock);
 }
@@ -147,3 +192,71 @@ static int __init v6_userpage_init(void)
 }
 
 core_initcall(v6_userpage_init);
+
+#ifdef CONFIG_KERNEL_MODE_NEON
+#define V6_BENCH_LOOPS	256
+
+/* Returns MB/s for V6_BENCH_LOOPS page copies with the given routine. */
+static unsigned long __init v6_bench_copy(void *to, void *from, int neon)
+{
+	unsigned long long t0, t;
+	int i;
+
+	v6_use_neon = neon;
+	v6_copy_page(to, from);		/* warm up caches and TLB */
+	preempt_disable();
+	t0 = sched_clock();
+	for (i = 0; i < V6_BENCH_LOOPS; i++)
+		v6_copy_page(to, from);
+	t = sched_clock() - t0;
+	preempt_enable();
+
+	if (!t)
+		t = 1;
+	/* bytes per ns * 1000 == MB/s (decimal) */
+	return (unsigned long)div64_u64((u64)V6_BENCH_LOOPS * PAGE_SIZE * 1000,
+					t);
+}
+
+/*
+ * Whether NEON wins depends on the core, the L2 setup and the memory
+ * clock, so time both copy loops once instead of guessing.  The pages
+ * stay cache resident, so this compares the loops rather than the
+ * DRAM bandwidth they share.
+ */
+static int __init v6_neon_select(void)
+{
+	struct page *pages;
+	unsigned long arm_mbs, neon_mbs;
+	void *a, *b;
+
+	if (!cpu_has_neon() || v6_neon_param == 0)
+		return 0;
+	if (v6_neon_param > 0) {
+		v6_use_neon = 1;
+		goto out;
+	}
+
+	pages = alloc_pages(GFP_KERNEL, 1);
+	if (!pages)
+		return 0;
+	a = page_address(pages);
+	b = a + PAGE_SIZE;
+	memset(b, 0x5a, PAGE_SIZE);
+
+	arm_mbs = v6_bench_copy(a, b, 0);
+	neon_mbs = v6_bench_copy(a, b, 1);
+	__free_pages(pages, 1);
+
+	printk(KERN_INFO "copy_page: %lu MB/s arm, %lu MB/s neon\n",
+			arm_mbs, neon_mbs);
+	v6_use_neon = neon_mbs > arm_mbs;
+out:
+	printk(KERN_INFO "copy_page: using %s routines\n",
+			v6_use_neon ? "neon" : "arm");
+	return 0;
+}
+
+/* after vfp_init() has set HWCAP_NEON */
+late_initcall_sync(v6_neon_select);
+#endif
@@ -15,6 +15,7 @@
 #include <linux/sched.h>
 #include <linux/init.h>
 
+#include <asm/neon.h>
 #include <asm/thread_notify.h>
 #include <asm/vfp.h>
 
@@ -483,6 +484,52 @@ void vfp_flush_hwstate(struct thread_info *thread)
 	put_cpu();
 }
 
+#ifdef CONFIG_KERNEL_MODE_NEON
+
+/*
+ * Kernel-side NEON support.  The register contents owned by the kernel
+ * never need preserving: preemption is off for the whole section and
+ * interrupt handlers may not use NEON.  Whatever user state is live in
+ * the hardware is saved, and last_VFP_context[] is cleared so that the
+ * owner reloads it on its next VFP instruction.
+ */
+void kernel_neon_begin(void)
+{
+	unsigned int cpu;
+	u32 fpexc;
+
+	BUG_ON(in_interrupt());
+	cpu = get_cpu();
+
+	fpexc = fmrx(FPEXC) | FPEXC_EN;
+	fmxr(FPEXC, fpexc);
+
+	/*
+	 * On SMP the switch notifier has already saved any other
+	 * thread's state, which may since have moved on to another CPU,
+	 * so only the current thread's registers can be live here.
+	 */
+#ifdef CONFIG_SMP
+	if (last_VFP_context[cpu] == &current_thread_info()->vfpstate)
+		vfp_save_state(last_VFP_context[cpu], fpexc);
+#else
+	if (last_VFP_context[cpu])
+		vfp_save_state(last_VFP_context[cpu], fpexc);
+#endif
+	last_VFP_context[cpu] = NULL;
+}
+EXPORT_SYMBOL(kernel_neon_begin);
+
+void kernel_neon_end(void)
+{
+	/* Disable the unit so the next user access traps and reloads. */
+	fmxr(FPEXC, fmrx(FPEXC) & ~FPEXC_EN);
+	put_cpu();
+}
+EXPORT_SYMBOL(kernel_neon_end);
+
+#endif /* CONFIG_KERNEL_MODE_NEON */
+
 #include <linux/smp.h>
 
 /*
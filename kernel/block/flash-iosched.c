@@ -0,0 +1,509 @@
+/*
+ *  Flash i/o scheduler, for eMMC and SD cards.
+ *
+ *  Based on the deadline i/o scheduler,
+ *  Copyright (C) 2002 Jens Axboe <axboe@kernel.dk>
+ */
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/blkdev.h>
+#include <linux/elevator.h>
+#include <linux/bio.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/init.h>
+#include <linux/compiler.h>
+#include <linux/rbtree.h>
+#include <linux/hash.h>
+#include <linux/sched.h>
+
+/*
+ * See Documentation/block/flash-iosched.txt
+ */
+static const int sync_expire = HZ / 4;	/* max time before a sync request is submitted. */
+static const int async_expire = 5 * HZ;	/* ditto for async writes, these limits are SOFT! */
+static const int writes_starved = 4;	/* max sync requests dispatched ahead of writes */
+static const int sync_quantum = 4;	/* sync requests of a process served in a row */
+static const int erase_block_kb = 512;	/* writes are batched in chunks this big */
+
+#define FLASH_FLOW_BITS	3
+#define FLASH_FLOWS	(1 << FLASH_FLOW_BITS)
+
+struct flash_data {
+	/*
+	 * run time data
+	 */
+
+	/*
+	 * all requests are on a sort_list, used to merge them and to batch
+	 * writes; sync requests are on the fifo of their flow, async writes
+	 * on async_fifo
+	 */
+	struct rb_root sort_list[2];
+	struct list_head flow_fifo[FLASH_FLOWS];
+	struct list_head async_fifo;
+	unsigned int nr_sync;
+	unsigned int nr_async;
+
+	unsigned int cur_flow;		/* flow being served */
+	unsigned int flow_served;	/* requests it was given in a row */
+	unsigned int starved;		/* sync requests ahead of writes */
+
+	/*
+	 * next write of the erase block being written, NULL when not
+	 * in a write batch
+	 */
+	struct request *next_write;
+	sector_t batch_end;
+
+	/*
+	 * settings that change how the i/o scheduler behaves
+	 */
+	int fifo_expire[2];		/* indexed by rq_is_sync() */
+	int writes_starved;
+	int sync_quantum;
+	int erase_block_kb;
+	int front_merges;
+};
+
+static void flash_move_request(struct flash_data *, struct request *);
+
+static inline struct rb_root *
+flash_rb_root(struct flash_data *fd, struct request *rq)
+{
+	return &fd->sort_list[rq_data_dir(rq)];
+}
+
+/*
+ * get the request after `rq' in sector-sorted order
+ */
+static inline struct request *
+flash_latter_request(struct request *rq)
+{
+	struct rb_node *node = rb_next(&rq->rb_node);
+
+	if (node)
+		return rb_entry_rq(node);
+
+	return NULL;
+}
+
+static void
+flash_add_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	struct rb_root *root = flash_rb_root(fd, rq);
+	struct request *__alias;
+
+	while (unlikely(__alias = elv_rb_add(root, rq)))
+		flash_move_request(fd, __alias);
+}
+
+static inline void
+flash_del_rq_rb(struct flash_data *fd, struct request *rq)
+{
+	if (fd->next_write == rq) {
+		fd->next_write = flash_latter_request(rq);
+		if (fd->next_write && blk_rq_pos(fd->next_write) >= fd->batch_end)
+			fd->next_write = NULL;
+	}
+
+	elv_rb_del(flash_rb_root(fd, rq), rq);
+}
+
+/*
+ * Processes are spread over a few flows, each with its own fifo. Sync
+ * requests are dispatched from the flows in turn, so that one process
+ * streaming reads cannot hold back the others.
+ */
+static unsigned int flash_flow(void)
+{
+	return hash_32(current->tgid, FLASH_FLOW_BITS);
+}
+
+/*
+ * add rq to rbtree and fifo
+ */
+static void
+flash_add_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	const int sync = rq_is_sync(rq);
+
+	flash_add_rq_rb(fd, rq);
+
+	/*
+	 * set expire time and add to fifo list
+	 */
+	rq_set_fifo_time(rq, jiffies + fd->fifo_expire[sync]);
+	if (sync) {
+		unsigned int flow = flash_flow();
+
+		/* flow + 1, so that only async requests have it NULL */
+		rq->elevator_private = (void *)(long)(flow + 1);
+		list_add_tail(&rq->queuelist, &fd->flow_fifo[flow]);
+		fd->nr_sync++;
+	} else {
+		rq->elevator_private = NULL;
+		list_add_tail(&rq->queuelist, &fd->async_fifo);
+		fd->nr_async++;
+	}
+}
+
+/*
+ * remove rq from rbtree and fifo.
+ */
+static void flash_remove_request(struct request_queue *q, struct request *rq)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	if (rq->elevator_private)
+		fd->nr_sync--;
+	else
+		fd->nr_async--;
+
+	rq_fifo_clear(rq);
+	flash_del_rq_rb(fd, rq);
+}
+
+static int
+flash_merge(struct request_queue *q, struct request **req, struct bio *bio)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *__rq;
+
+	/*
+	 * check for front merge
+	 */
+	if (fd->front_merges) {
+		sector_t sector = bio->bi_sector + bio_sectors(bio);
+
+		__rq = elv_rb_find(&fd->sort_list[bio_data_dir(bio)], sector);
+		if (__rq) {
+			BUG_ON(sector != blk_rq_pos(__rq));
+
+			if (elv_rq_merge_ok(__rq, bio)) {
+				*req = __rq;
+				return ELEVATOR_FRONT_MERGE;
+			}
+		}
+	}
+
+	return ELEVATOR_NO_MERGE;
+}
+
+static void flash_merged_request(struct request_queue *q,
+				 struct request *req, int type)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	/*
+	 * if the merge was a front merge, we need to reposition request
+	 */
+	if (type == ELEVATOR_FRONT_MERGE) {
+		elv_rb_del(flash_rb_root(fd, req), req);
+		flash_add_rq_rb(fd, req);
+	}
+}
+
+static void
+flash_merged_requests(struct request_queue *q, struct request *req,
+		      struct request *next)
+{
+	/*
+	 * if next expires before rq, assign its expire time to rq
+	 * and move into next position (next will be deleted) in fifo,
+	 * as long as they are on the same fifo
+	 */
+	if (!list_empty(&req->queuelist) && !list_empty(&next->queuelist) &&
+	    req->elevator_private == next->elevator_private) {
+		if (time_before(rq_fifo_time(next), rq_fifo_time(req))) {
+			list_move(&req->queuelist, &next->queuelist);
+			rq_set_fifo_time(req, rq_fifo_time(next));
+		}
+	}
+
+	/*
+	 * kill knowledge of next, this one is a goner
+	 */
+	flash_remove_request(q, next);
+}
+
+/*
+ * move request from sort list to dispatch queue.
+ */
+static void
+flash_move_request(struct flash_data *fd, struct request *rq)
+{
+	struct request_queue *q = rq->q;
+
+	flash_remove_request(q, rq);
+	elv_dispatch_add_tail(q, rq);
+}
+
+static inline int flash_fifo_expired(struct list_head *fifo)
+{
+	struct request *rq = rq_entry_fifo(fifo->next);
+
+	return time_after(jiffies, rq_fifo_time(rq));
+}
+
+/*
+ * Start a batch with the oldest async write: every queued write to the
+ * same erase block is dispatched with it, in sector order, so that the
+ * card sees the block written in one go.
+ */
+static struct request *flash_start_write_batch(struct flash_data *fd)
+{
+	struct request *rq = rq_entry_fifo(fd->async_fifo.next);
+	sector_t chunk = fd->erase_block_kb << 1;
+	sector_t start = blk_rq_pos(rq);
+	struct rb_node *node;
+
+	if (chunk) {
+		sector_div(start, chunk);
+		start *= chunk;
+	}
+	fd->batch_end = start + (chunk ? chunk : blk_rq_sectors(rq));
+
+	/* back up to the first write of the erase block */
+	while ((node = rb_prev(&rq->rb_node)) &&
+	       blk_rq_pos(rb_entry_rq(node)) >= start)
+		rq = rb_entry_rq(node);
+
+	return rq;
+}
+
+/*
+ * The sync request to serve next: the oldest one if it is overdue,
+ * otherwise from the current flow until it used its quantum, then from
+ * the next flow with requests. A flow that runs dry loses its turn,
+ * nothing waits for it to send more.
+ */
+static struct request *flash_next_sync(struct flash_data *fd)
+{
+	unsigned int i, flow;
+
+	for (i = 0; i < FLASH_FLOWS; i++)
+		if (!list_empty(&fd->flow_fifo[i]) &&
+		    flash_fifo_expired(&fd->flow_fifo[i])) {
+			flow = i;
+			goto found;
+		}
+
+	flow = fd->cur_flow;
+	if (list_empty(&fd->flow_fifo[flow]) ||
+	    fd->flow_served >= fd->sync_quantum) {
+		for (i = 1; i <= FLASH_FLOWS; i++) {
+			flow = (fd->cur_flow + i) % FLASH_FLOWS;
+			if (!list_empty(&fd->flow_fifo[flow]))
+				break;
+		}
+	}
+
+found:
+	if (flow != fd->cur_flow) {
+		fd->cur_flow = flow;
+		fd->flow_served = 0;
+	}
+	fd->flow_served++;
+
+	return rq_entry_fifo(fd->flow_fifo[flow].next);
+}
+
+/*
+ * flash_dispatch_requests selects the next request: a running write
+ * batch is finished first, then sync requests go ahead of async writes
+ * unless writes have been starved for too long or have expired.
+ */
+static int flash_dispatch_requests(struct request_queue *q, int force)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+	struct request *rq;
+
+	if (fd->next_write) {
+		rq = fd->next_write;
+		goto dispatch_request;
+	}
+
+	if (fd->nr_async &&
+	    (!fd->nr_sync || fd->starved >= fd->writes_starved ||
+	     flash_fifo_expired(&fd->async_fifo))) {
+		fd->starved = 0;
+		rq = flash_start_write_batch(fd);
+		goto dispatch_request;
+	}
+
+	if (!fd->nr_sync)
+		return 0;
+
+	if (fd->nr_async)
+		fd->starved++;
+	rq = flash_next_sync(fd);
+
+dispatch_request:
+	if (rq_data_dir(rq) == WRITE && fd->batch_end) {
+		fd->next_write = flash_latter_request(rq);
+		if (fd->next_write &&
+		    blk_rq_pos(fd->next_write) >= fd->batch_end)
+			fd->next_write = NULL;
+	}
+	if (!fd->next_write)
+		fd->batch_end = 0;
+
+	flash_move_request(fd, rq);
+
+	return 1;
+}
+
+static int flash_queue_empty(struct request_queue *q)
+{
+	struct flash_data *fd = q->elevator->elevator_data;
+
+	return !fd->nr_sync && !fd->nr_async;
+}
+
+static void flash_exit_queue(struct elevator_queue *e)
+{
+	struct flash_data *fd = e->elevator_data;
+
+	BUG_ON(fd->nr_sync || fd->nr_async);
+
+	kfree(fd);
+}
+
+/*
+ * initialize elevator private data (flash_data).
+ */
+static void *flash_init_queue(struct request_queue *q)
+{
+	struct flash_data *fd;
+	int i;
+
+	fd = kmalloc_node(sizeof(*fd), GFP_KERNEL | __GFP_ZERO, q->node);
+	if (!fd)
+		return NULL;
+
+	for (i = 0; i < FLASH_FLOWS; i++)
+		INIT_LIST_HEAD(&fd->flow_fifo[i]);
+	INIT_LIST_HEAD(&fd->async_fifo);
+	fd->sort_list[READ] = RB_ROOT;
+	fd->sort_list[WRITE] = RB_ROOT;
+	fd->fifo_expire[1] = sync_expire;
+	fd->fifo_expire[0] = async_expire;
+	fd->writes_starved = writes_starved;
+	fd->sync_quantum = sync_quantum;
+	fd->erase_block_kb = erase_block_kb;
+	fd->front_merges = 1;
+	return fd;
+}
+
+/*
+ * sysfs parts below
+ */
+
+static ssize_t
+flash_var_show(int var, char *page)
+{
+	return sprintf(page, "%d\n", var);
+}
+
+static ssize_t
+flash_var_store(int *var, const char *page, size_t count)
+{
+	char *p = (char *) page;
+
+	*var = simple_strtol(p, &p, 10);
+	return count;
+}
+
+#define SHOW_FUNCTION(__FUNC, __VAR, __CONV)				\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data = __VAR;						\
+	if (__CONV)							\
+		__data = jiffies_to_msecs(__data);			\
+	return flash_var_show(__data, (page));				\
+}
+SHOW_FUNCTION(flash_sync_expire_show, fd->fifo_expire[1], 1);
+SHOW_FUNCTION(flash_async_expire_show, fd->fifo_expire[0], 1);
+SHOW_FUNCTION(flash_writes_starved_show, fd->writes_starved, 0);
+SHOW_FUNCTION(flash_sync_quantum_show, fd->sync_quantum, 0);
+SHOW_FUNCTION(flash_erase_block_kb_show, fd->erase_block_kb, 0);
+SHOW_FUNCTION(flash_front_merges_show, fd->front_merges, 0);
+#undef SHOW_FUNCTION
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct flash_data *fd = e->elevator_data;			\
+	int __data;							\
+	int ret = flash_var_store(&__data, (page), count);		\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	if (__CONV)							\
+		*(__PTR) = msecs_to_jiffies(__data);			\
+	else								\
+		*(__PTR) = __data;					\
+	return ret;							\
+}
+STORE_FUNCTION(flash_sync_expire_store, &fd->fifo_expire[1], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_async_expire_store, &fd->fifo_expire[0], 0, INT_MAX, 1);
+STORE_FUNCTION(flash_writes_starved_store, &fd->writes_starved, 0, INT_MAX, 0);
+STORE_FUNCTION(flash_sync_quantum_store, &fd->sync_quantum, 1, INT_MAX, 0);
+STORE_FUNCTION(flash_erase_block_kb_store, &fd->erase_block_kb, 0, 64 * 1024, 0);
+STORE_FUNCTION(flash_front_merges_store, &fd->front_merges, 0, 1, 0);
+#undef STORE_FUNCTION
+
+#define FD_ATTR(name) \
+	__ATTR(name, S_IRUGO|S_IWUSR, flash_##name##_show, \
+				      flash_##name##_store)
+
+static struct elv_fs_entry flash_attrs[] = {
+	FD_ATTR(sync_expire),
+	FD_ATTR(async_expire),
+	FD_ATTR(writes_starved),
+	FD_ATTR(sync_quantum),
+	FD_ATTR(erase_block_kb),
+	FD_ATTR(front_merges),
+	__ATTR_NULL
+};
+
+static struct elevator_type iosched_flash = {
+	.ops = {
+		.elevator_merge_fn = 		flash_merge,
+		.elevator_merged_fn =		flash_merged_request,
+		.elevator_merge_req_fn =	flash_merged_requests,
+		.elevator_dispatch_fn =		flash_dispatch_requests,
+		.elevator_add_req_fn =		flash_add_request,
+		.elevator_queue_empty_fn =	flash_queue_empty,
+		.elevator_former_req_fn =	elv_rb_former_request,
+		.elevator_latter_req_fn =	elv_rb_latter_request,
+		.elevator_init_fn =		flash_init_queue,
+		.elevator_exit_fn =		flash_exit_queue,
+	},
+
+	.elevator_attrs = flash_attrs,
+	.elevator_name = "flash",
+	.elevator_owner = THIS_MODULE,
+};
+
+static int __init flash_init(void)
+{
+	elv_register(&iosched_flash);
+
+	return 0;
+}
+
+static void __exit flash_exit(void)
+{
+	elv_unregister(&iosched_flash);
+}
+
+module_init(flash_init);
+module_exit(flash_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("flash IO scheduler");
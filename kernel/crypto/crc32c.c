@@ -133,8 +133,49 @@ static const u32 crc32c_table[256] = {
  * crc using table.
  */
 
+/*
+ * crc32c_slice[n][b] is the crc of byte b followed by n zero bytes,
+ * which lets the main loop fold in 8 bytes per step (slicing by 8).
+ * Row 0 is crc32c_table itself; the rest is filled in at init time.
+ */
+static u32 crc32c_slice[8][256] __read_mostly;
+
+static void __init crc32c_init_slice(void)
+{
+	u32 crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = crc32c_table[i];
+		crc32c_slice[0][i] = crc;
+		for (j = 1; j < 8; j++) {
+			crc = crc32c_table[crc & 0xff] ^ (crc >> 8);
+			crc32c_slice[j][i] = crc;
+		}
+	}
+}
+
 static u32 crc32c(u32 crc, const u8 *data, unsigned int length)
 {
+	const u32 (*t)[256] = crc32c_slice;
+	const __le32 *b;
+	u32 q;
+
+	while (length && ((unsigned long)data & 3)) {
+		crc = crc32c_table[(crc ^ *data++) & 0xFFL] ^ (crc >> 8);
+		length--;
+	}
+
+	for (b = (const __le32 *)data; length >= 8; length -= 8) {
+		crc ^= le32_to_cpu(*b++);
+		q = le32_to_cpu(*b++);
+		crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff] ^
+		      t[5][(crc >> 16) & 0xff] ^ t[4][crc >> 24] ^
+		      t[3][q & 0xff] ^ t[2][(q >> 8) & 0xff] ^
+		      t[1][(q >> 16) & 0xff] ^ t[0][q >> 24];
+	}
+	data = (const u8 *)b;
+
 	while (length--)
 		crc = crc32c_table[(crc ^ *data++) & 0xFFL] ^ (crc >> 8);
 
@@ -244,6 +285,7 @@ static struct shash_alg alg = {
 
 static int __init crc32c_mod_init(void)
 {
+	crc32c_init_slice();
 	return crypto_register_shash(&alg);
 }
 
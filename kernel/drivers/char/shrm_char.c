@@ -8,6 +8,7 @@
  */
 
 #include <linux/err.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/errno.h>
 #include <linux/poll.h>
@@ -29,7 +30,8 @@
 
 #define SIZE_OF_FIFO (512*1024)
 
-static u8 message_fifo[ISA_DEVICES][SIZE_OF_FIFO];
+/* page aligned so that the queues can be mapped to user space */
+static u8 message_fifo[ISA_DEVICES][SIZE_OF_FIFO] __aligned(PAGE_SIZE);
 
 static u8 wr_rpc_msg[10*1024];
 static u8 wr_sec_msg[10*1024];
@@ -128,6 +130,8 @@ void shrm_char_reset_queues(struct shrm_dev *shrm)
 		q->readptr = 0;
 		q->writeptr = 0;
 		q->no = 0;
+		q->ring->head = q->ring->tail;
+		q->ring_tail = q->ring->tail;
 
 		/* wake up the blocking read/select */
 		atomic_set(&q->q_rp, 1);
@@ -152,6 +156,15 @@ void shrm_char_reset_queues(struct shrm_dev *shrm)
 static int create_queue(struct message_queue *q, u32 devicetype,
 						struct shrm_dev *shrm)
 {
+	q->ring = (struct t_dlp_ring *)get_zeroed_page(GFP_KERNEL);
+	if (!q->ring)
+		return -ENOMEM;
+	q->ring->magic = DLP_MMAP_RING_MAGIC;
+	q->ring->data_offset = DLP_MMAP_CTRL_SIZE;
+	q->ring->data_size = SIZE_OF_FIFO;
+	q->ring->ndesc = DLP_MMAP_RING_DESCS;
+	q->ring_tail = 0;
+	q->ring_mapped = 0;
 	q->fifo_base = (u8 *)&message_fifo[devicetype];
 	q->size = SIZE_OF_FIFO;
 	q->readptr = 0;
@@ -171,6 +184,79 @@ static void delete_queue(struct message_queue *q)
 	q->size = 0;
 	q->readptr = 0;
 	q->writeptr = 0;
+	free_page((unsigned long)q->ring);
+	q->ring = NULL;
+}
+
+/**
+ * ring_publish() - make a queued message visible to the mmap reader
+ * @q:		message queue
+ * @msg:	message just added to the queue
+ *
+ * Called with q->update_lock held.
+ */
+static void ring_publish(struct message_queue *q, struct queue_element *msg)
+{
+	struct t_dlp_ring *ring = q->ring;
+	struct t_dlp_ring_desc *desc;
+
+	desc = &ring->desc[ring->head % DLP_MMAP_RING_DESCS];
+	desc->offset = msg->offset;
+	desc->size = msg->size;
+	/* descriptor must be visible before the reader sees the new head */
+	smp_wmb();
+	ring->head++;
+}
+
+/**
+ * ring_reclaim() - release the messages consumed by the mmap reader
+ * @q:	message queue
+ *
+ * The reader only moves the shared tail; the queue space behind it is given
+ * back here, lazily, whenever the driver needs it or the reader polls.
+ * Called with q->update_lock held.
+ */
+static void ring_reclaim(struct message_queue *q)
+{
+	u32 tail = ACCESS_ONCE(q->ring->tail);
+
+	/* the reader is done with the data before it moved the tail */
+	smp_mb();
+	while (q->ring_tail != tail && !list_empty(&q->msg_list)) {
+		remove_msg_from_queue(q);
+		q->ring_tail++;
+	}
+}
+
+/**
+ * check_space_in_queue() - check that a new message fits in the queue
+ * @q:		message queue
+ * @size:	size in bytes
+ *
+ * Must be called, with q->update_lock held, before the message is copied
+ * into the queue. The space an mmap reader has consumed is reclaimed first.
+ * If the queue or the ring is full, the message is counted as dropped and
+ * -ENOSPC is returned.
+ */
+int check_space_in_queue(struct message_queue *q, u32 size)
+{
+	u32 used;
+
+	if (q->ring_mapped) {
+		ring_reclaim(q);
+		if (q->ring->head - q->ring_tail >= DLP_MMAP_RING_DESCS)
+			goto full;
+	}
+
+	used = (q->writeptr + q->size - q->readptr) % q->size;
+	if (used + size >= q->size)
+		goto full;
+
+	return 0;
+
+full:
+	q->ring->dropped++;
+	return -ENOSPC;
 }
 
 /**
@@ -180,7 +266,7 @@ static void delete_queue(struct message_queue *q)
  *
  * This function tries to allocate n_bytes of size in FIFO q.
  * It returns negative number when no memory can be allocated
- * currently.
+ * currently. check_space_in_queue() must have been called first.
  */
 int add_msg_to_queue(struct message_queue *q, u32 size)
 {
@@ -217,6 +303,8 @@ int add_msg_to_queue(struct message_queue *q, u32 size)
 		wake_up_interruptible(&q->wq_readable);
 	} else
 		list_add_tail(&new_msg->entry, &q->msg_list);
+	if (q->ring_mapped)
+		ring_publish(q, new_msg);
 
 	dev_dbg(shrm->dev, "%s OUT\n", __func__);
 	return 0;
@@ -329,6 +417,11 @@ static u32 isa_select(struct file *filp,
 			return -1;
 
 	q = &isadev->dl_queue;
+	if (q->ring_mapped) {
+		spin_lock_bh(&q->update_lock);
+		ring_reclaim(q);
+		spin_unlock_bh(&q->update_lock);
+	}
 	poll_wait(filp, &q->wq_readable, wait);
 	if (atomic_read(&q->q_rp) == 1)
 		mask = POLLIN | POLLRDNORM;
@@ -372,6 +465,10 @@ ssize_t isa_read(struct file *filp, char __user *buf, size_t len, loff_t *ppos)
 		return -ENODEV;
 	}
 
+	/* messages are handed out through the mmap ring instead */
+	if (q->ring_mapped)
+		return -EBUSY;
+
 	spin_lock_bh(&q->update_lock);
 	if (list_empty(&q->msg_list)) {
 		spin_unlock_bh(&q->update_lock);
@@ -581,17 +678,84 @@ static int isa_ioctl(struct inode *inode, struct file *filp,
  * @filp:	file descriptor pointer
  * @vma:	virtual area memory structure.
  *
- * This function maps kernel FIFO into user space. This function
- * shall be called twice to map both uplink and downlink buffers.
+ * This function maps the downlink queue of the device into user space as
+ * described in mach/isa_ioctl.h: the ring control page followed by the
+ * queue mapped twice. From then on, until the device is closed, received
+ * messages are only handed out through the ring and read() is refused.
+ * Only MMAP_DLQUEUE is supported, uplink messages still go through write().
+ * The ISI, IPCCTRL and IPCDATA queues are also drained by the network
+ * interfaces, which do not know about the ring, so they can not be mapped.
  */
 static int isa_mmap(struct file *filp, struct vm_area_struct *vma)
 {
 	struct isadev_context *isadev = filp->private_data;
-	struct shrm_dev *shrm = isadev->dl_queue.shrm;
+	struct message_queue *q = &isadev->dl_queue;
+	struct shrm_dev *shrm = q->shrm;
+	struct queue_element *msg;
+	unsigned long data = vma->vm_start + DLP_MMAP_CTRL_SIZE;
+	unsigned long pfn;
+	u32 queued = 0;
+	int ret, l2_header;
 
 	u32 m = iminor(filp->f_path.dentry->d_inode);
 	dev_dbg(shrm->dev, "%s %d\n", __func__, m);
 
+	BUILD_BUG_ON(DLP_MMAP_CTRL_SIZE != PAGE_SIZE);
+	BUILD_BUG_ON(DLP_MMAP_DATA_SIZE != SIZE_OF_FIFO);
+
+	if (vma->vm_pgoff != MMAP_DLQUEUE ||
+			vma->vm_end - vma->vm_start != DLP_MMAP_SIZE ||
+			!(vma->vm_flags & VM_SHARED))
+		return -EINVAL;
+
+	l2_header = shrm_get_cdev_l2header(isadev->device_id);
+	if (l2_header == ISI_MESSAGING || l2_header == IPCCTRL ||
+			l2_header == IPCDATA)
+		return -EINVAL;
+
+	mutex_lock(&isa_lock);
+	if (q->ring_mapped) {
+		mutex_unlock(&isa_lock);
+		return -EBUSY;
+	}
+
+	ret = remap_pfn_range(vma, vma->vm_start,
+			virt_to_phys(q->ring) >> PAGE_SHIFT,
+			DLP_MMAP_CTRL_SIZE, vma->vm_page_prot);
+	pfn = virt_to_phys(q->fifo_base) >> PAGE_SHIFT;
+	if (!ret)
+		ret = remap_pfn_range(vma, data, pfn, SIZE_OF_FIFO,
+				vma->vm_page_prot);
+	if (!ret)
+		ret = remap_pfn_range(vma, data + SIZE_OF_FIFO, pfn,
+				SIZE_OF_FIFO, vma->vm_page_prot);
+	if (ret) {
+		dev_err(shrm->dev, "failed to map queue %d\n", m);
+		mutex_unlock(&isa_lock);
+		return ret;
+	}
+
+	/*
+	 * Hand whatever is already queued over to the ring, dropping the
+	 * oldest messages if there are more than it can describe.
+	 */
+	spin_lock_bh(&q->update_lock);
+	q->ring->head = 0;
+	q->ring->tail = 0;
+	q->ring->dropped = 0;
+	q->ring_tail = 0;
+	list_for_each_entry(msg, &q->msg_list, entry)
+		queued++;
+	for (; queued > DLP_MMAP_RING_DESCS; queued--) {
+		remove_msg_from_queue(q);
+		q->ring->dropped++;
+	}
+	list_for_each_entry(msg, &q->msg_list, entry)
+		ring_publish(q, msg);
+	q->ring_mapped = 1;
+	spin_unlock_bh(&q->update_lock);
+	mutex_unlock(&isa_lock);
+
 	return 0;
 }
 
@@ -630,6 +794,14 @@ static int isa_close(struct inode *inode, struct file *filp)
 	}
 	atomic_set(&isa_context->is_open[idx], 1);
 
+	/* give back what the mmap reader consumed, the rest goes to read() */
+	if (isadev->dl_queue.ring_mapped) {
+		spin_lock_bh(&isadev->dl_queue.update_lock);
+		ring_reclaim(&isadev->dl_queue);
+		isadev->dl_queue.ring_mapped = 0;
+		spin_unlock_bh(&isadev->dl_queue.update_lock);
+	}
+
 	switch (m) {
 	case RPC_MESSAGING:
 		dev_info(shrm->dev, "Close RPC_MESSAGING Device\n");
@@ -869,8 +1041,12 @@ int isa_init(struct shrm_dev *shrm)
 
 		if (retval < 0) {
 			dev_err(shrm->dev, "create dl_queue failed\n");
-			delete_queue(&isadev->dl_queue);
-			kfree(isadev);
+			while (--no_dev >= 0) {
+				isadev = &isa_context->isadev[no_dev];
+				delete_queue(&isadev->dl_queue);
+			}
+			kfree(isa_context->isadev);
+			isa_context->isadev = NULL;
 			return retval;
 		}
 	}
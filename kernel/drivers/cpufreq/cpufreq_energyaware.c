@@ -0,0 +1,408 @@
+/*
+ *  drivers/cpufreq/cpufreq_energyaware.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * 'energyaware' picks, at every sample, the frequency which is expected
+ * to keep the scheduling latency of the cpu below a target for the least
+ * energy.
+ *
+ * The load comes from the scheduler, through the cpu load windows of
+ * cpufreq_load.c, rather than from idle time: besides the fraction of
+ * time the cpu had something to run, it tells how many tasks were
+ * runnable on average and how long they ran between context switches.
+ * At a candidate frequency f the cpu would be busy
+ * rho(f) = rho(cur) * cur / f of the time and a task would run for
+ * s(f) = s(cur) * cur / f; the mean time a woken task waits for the cpu
+ * is then estimated as in an M/M/1 queue, s * rho / (1 - rho).
+ *
+ * Among the frequencies meeting the latency target, the one with the
+ * lowest average power active(f) * rho + idle(f) * (1 - rho) is chosen,
+ * using the table registered with cpufreq_power_table_set().  Without a
+ * table this is simply the lowest frequency meeting the target.  When
+ * none does, the highest one is used.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/cpu.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+
+#define DEF_SAMPLING_RATE		(20000)
+#define MIN_SAMPLING_RATE		(10000)
+#define DEF_LATENCY_TARGET		(4000)
+#define MIN_LATENCY_TARGET		(100)
+#define TRANSITION_LATENCY_LIMIT	(10 * 1000 * 1000)
+
+/* Fixed point for the load figures: EA_ONE is one fully busy cpu. */
+#define EA_SHIFT			CPU_LOAD_SHIFT
+#define EA_ONE				CPU_LOAD_ONE
+/* Above this busy fraction, runnable tasks are counted as extra load. */
+#define EA_SATURATED			(EA_ONE * 95 / 100)
+
+static void do_ea_timer(struct work_struct *work);
+static int cpufreq_governor_ea(struct cpufreq_policy *policy,
+				unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGYAWARE
+static
+#endif
+struct cpufreq_governor cpufreq_gov_energyaware = {
+	.name			= "energyaware",
+	.governor		= cpufreq_governor_ea,
+	.max_transition_latency	= TRANSITION_LATENCY_LIMIT,
+	.owner			= THIS_MODULE,
+};
+
+struct cpu_ea_info_s {
+	struct cpufreq_policy *cur_policy;
+	struct delayed_work work;
+	struct cpufreq_frequency_table *freq_table;
+	int cpu;
+	/*
+	 * percpu mutex that serializes governor limit change with
+	 * do_ea_timer invocation.
+	 */
+	struct mutex timer_mutex;
+};
+static DEFINE_PER_CPU(struct cpu_ea_info_s, ea_cpu_info);
+
+static unsigned int ea_enable;	/* number of CPUs using this policy */
+
+static struct cpu_load_window ea_load;
+
+/*
+ * ea_mutex protects ea_tuners_ins from concurrent changes on different
+ * CPUs. It protects ea_enable in governor start/stop.
+ */
+static DEFINE_MUTEX(ea_mutex);
+
+static struct workqueue_struct *kenergyaware_wq;
+
+static struct ea_tuners {
+	unsigned int sampling_rate;
+	unsigned int latency_target;
+	unsigned int target_misses;
+} ea_tuners_ins = {
+	.sampling_rate = DEF_SAMPLING_RATE,
+	.latency_target = DEF_LATENCY_TARGET,
+};
+
+/************************** sysfs interface ************************/
+
+#define show_one(file_name, object)					\
+static ssize_t show_##file_name						\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return sprintf(buf, "%u\n", ea_tuners_ins.object);		\
+}
+show_one(sampling_rate, sampling_rate);
+show_one(latency_target, latency_target);
+show_one(target_misses, target_misses);
+
+static ssize_t store_sampling_rate(struct kobject *a, struct attribute *b,
+				   const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1)
+		return -EINVAL;
+
+	mutex_lock(&ea_mutex);
+	ea_tuners_ins.sampling_rate = max(input, (unsigned int)MIN_SAMPLING_RATE);
+	mutex_unlock(&ea_mutex);
+
+	return count;
+}
+
+static ssize_t store_latency_target(struct kobject *a, struct attribute *b,
+				    const char *buf, size_t count)
+{
+	unsigned int input;
+	int ret;
+
+	ret = sscanf(buf, "%u", &input);
+	if (ret != 1 || input < MIN_LATENCY_TARGET)
+		return -EINVAL;
+
+	mutex_lock(&ea_mutex);
+	ea_tuners_ins.latency_target = input;
+	mutex_unlock(&ea_mutex);
+
+	return count;
+}
+
+define_one_global_rw(sampling_rate);
+define_one_global_rw(latency_target);
+define_one_global_ro(target_misses);
+
+static struct attribute *ea_attributes[] = {
+	&sampling_rate.attr,
+	&latency_target.attr,
+	&target_misses.attr,
+	NULL
+};
+
+static struct attribute_group ea_attr_group = {
+	.attrs = ea_attributes,
+	.name = "energyaware",
+};
+
+/************************** sysfs end ************************/
+
+/*
+ * Load of one cpu since the previous sample: busy fraction, corrected
+ * for the queued tasks once the cpu is saturated, and the mean run time
+ * between two context switches in ns.
+ */
+static unsigned int ea_cpu_load(int cpu, u64 *run_ns)
+{
+	struct cpu_load_sample sample;
+	unsigned int load;
+
+	if (cpu_load_sample(&ea_load, cpu, &sample))
+		return 0;
+
+	load = sample.load;
+	if (load >= EA_SATURATED)
+		load = max(load, sample.nr);
+
+	*run_ns = sample.run_ns;
+	return load;
+}
+
+static unsigned int ea_power(const struct cpufreq_power_entry *power,
+			     unsigned int freq, unsigned int load)
+{
+	int i;
+
+	if (!power)
+		return freq;
+
+	for (i = 0; power[i].frequency != CPUFREQ_TABLE_END; i++) {
+		if (power[i].frequency == freq)
+			return (power[i].active * load +
+				power[i].idle * (EA_ONE - load)) >> EA_SHIFT;
+	}
+	/* frequency missing from the table, never prefer it */
+	return UINT_MAX;
+}
+
+static unsigned int ea_select_freq(struct cpufreq_policy *policy,
+				   struct cpufreq_frequency_table *table,
+				   unsigned int load, u64 run_ns)
+{
+	const struct cpufreq_power_entry *power = cpufreq_power_table_get();
+	u64 target_ns = (u64)ea_tuners_ins.latency_target * NSEC_PER_USEC;
+	unsigned int best_freq = 0, best_power = UINT_MAX;
+	unsigned int freq, f_load, f_power;
+	u64 f_run, wait;
+	int i;
+
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		freq = table[i].frequency;
+		if (freq == CPUFREQ_ENTRY_INVALID ||
+		    freq < policy->min || freq > policy->max)
+			continue;
+
+		f_load = div_u64((u64)load * policy->cur, freq);
+		if (f_load >= EA_ONE)
+			continue;
+
+		f_run = div_u64(run_ns * policy->cur, freq);
+		wait = div_u64(f_run * f_load, EA_ONE - f_load);
+		if (wait > target_ns)
+			continue;
+
+		f_power = ea_power(power, freq, f_load);
+		if (f_power < best_power ||
+		    (f_power == best_power && freq < best_freq)) {
+			best_power = f_power;
+			best_freq = freq;
+		}
+	}
+
+	if (!best_freq) {
+		ea_tuners_ins.target_misses++;
+		best_freq = policy->max;
+	}
+	return best_freq;
+}
+
+static void ea_check_cpu(struct cpu_ea_info_s *this_info)
+{
+	struct cpufreq_policy *policy = this_info->cur_policy;
+	unsigned int max_load = 0, load, freq;
+	u64 max_run_ns = 0, run_ns;
+	unsigned int j;
+
+	if (!this_info->freq_table)
+		return;
+
+	/* The most loaded cpu of the policy decides */
+	for_each_cpu(j, policy->cpus) {
+		load = ea_cpu_load(j, &run_ns);
+		if (load > max_load) {
+			max_load = load;
+			max_run_ns = run_ns;
+		}
+	}
+
+	freq = ea_select_freq(policy, this_info->freq_table, max_load,
+			      max_run_ns);
+	if (freq != policy->cur)
+		__cpufreq_driver_target(policy, freq, CPUFREQ_RELATION_L);
+}
+
+static void do_ea_timer(struct work_struct *work)
+{
+	struct cpu_ea_info_s *ea_info =
+		container_of(work, struct cpu_ea_info_s, work.work);
+	unsigned int cpu = ea_info->cpu;
+	int delay;
+
+	mutex_lock(&ea_info->timer_mutex);
+	ea_check_cpu(ea_info);
+
+	/* We want all CPUs to do sampling nearly on same jiffy */
+	delay = usecs_to_jiffies(ea_tuners_ins.sampling_rate);
+	if (num_online_cpus() > 1)
+		delay -= jiffies % delay;
+	queue_delayed_work_on(cpu, kenergyaware_wq, &ea_info->work, delay);
+	mutex_unlock(&ea_info->timer_mutex);
+}
+
+static inline void ea_timer_init(struct cpu_ea_info_s *ea_info)
+{
+	/* We want all CPUs to do sampling nearly on same jiffy */
+	int delay = usecs_to_jiffies(ea_tuners_ins.sampling_rate);
+	delay -= jiffies % delay;
+
+	INIT_DELAYED_WORK_DEFERRABLE(&ea_info->work, do_ea_timer);
+	queue_delayed_work_on(ea_info->cpu, kenergyaware_wq, &ea_info->work,
+		delay);
+}
+
+static inline void ea_timer_exit(struct cpu_ea_info_s *ea_info)
+{
+	cancel_delayed_work_sync(&ea_info->work);
+}
+
+static int cpufreq_governor_ea(struct cpufreq_policy *policy,
+			       unsigned int event)
+{
+	unsigned int cpu = policy->cpu;
+	struct cpu_ea_info_s *this_info;
+	unsigned int j;
+	int rc;
+
+	this_info = &per_cpu(ea_cpu_info, cpu);
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if ((!cpu_online(cpu)) || (!policy->cur))
+			return -EINVAL;
+
+		mutex_lock(&ea_mutex);
+		ea_enable++;
+		for_each_cpu(j, policy->cpus) {
+			struct cpu_ea_info_s *j_info;
+			j_info = &per_cpu(ea_cpu_info, j);
+			j_info->cur_policy = policy;
+			cpu_load_window_reset(&ea_load, j, 0);
+		}
+		this_info->cpu = cpu;
+		this_info->freq_table = cpufreq_frequency_get_table(cpu);
+
+		if (ea_enable == 1) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+						&ea_attr_group);
+			if (rc) {
+				ea_enable--;
+				mutex_unlock(&ea_mutex);
+				return rc;
+			}
+		}
+		mutex_unlock(&ea_mutex);
+
+		mutex_init(&this_info->timer_mutex);
+		ea_timer_init(this_info);
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		ea_timer_exit(this_info);
+
+		mutex_lock(&ea_mutex);
+		mutex_destroy(&this_info->timer_mutex);
+		ea_enable--;
+		mutex_unlock(&ea_mutex);
+		if (!ea_enable)
+			sysfs_remove_group(cpufreq_global_kobject,
+					   &ea_attr_group);
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		mutex_lock(&this_info->timer_mutex);
+		if (policy->max < this_info->cur_policy->cur)
+			__cpufreq_driver_target(this_info->cur_policy,
+				policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > this_info->cur_policy->cur)
+			__cpufreq_driver_target(this_info->cur_policy,
+				policy->min, CPUFREQ_RELATION_L);
+		mutex_unlock(&this_info->timer_mutex);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_gov_ea_init(void)
+{
+	int err;
+
+	kenergyaware_wq = create_workqueue("kenergyaware");
+	if (!kenergyaware_wq) {
+		printk(KERN_ERR "Creation of kenergyaware failed\n");
+		return -EFAULT;
+	}
+	err = cpu_load_window_init(&ea_load, "energyaware", 1);
+	if (err)
+		goto err_wq;
+	err = cpufreq_register_governor(&cpufreq_gov_energyaware);
+	if (err)
+		goto err_load;
+
+	return 0;
+
+err_load:
+	cpu_load_window_exit(&ea_load);
+err_wq:
+	destroy_workqueue(kenergyaware_wq);
+	return err;
+}
+
+static void __exit cpufreq_gov_ea_exit(void)
+{
+	cpufreq_unregister_governor(&cpufreq_gov_energyaware);
+	cpu_load_window_exit(&ea_load);
+	destroy_workqueue(kenergyaware_wq);
+}
+
+MODULE_DESCRIPTION("'cpufreq_energyaware' - A cpufreq governor meeting a "
+	"scheduling latency target at the lowest energy");
+MODULE_LICENSE("GPL");
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGYAWARE
+fs_initcall(cpufreq_gov_ea_init);
+#else
+module_init(cpufreq_gov_ea_init);
+#endif
+module_exit(cpufreq_gov_ea_exit);
@@ -0,0 +1,138 @@
+/*
+ *  drivers/cpufreq/cpufreq_load.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Per-cpu load tracking shared by the cpufreq governors and the platform
+ * hotplug logic, so that they all see the same figures for a cpu instead
+ * of each recomputing them from idle time.
+ *
+ * The figures come from the scheduler (sched_get_cpu_load()), which is
+ * sampled only when a user asks for a new period: nothing here runs on
+ * its own, an idle system is not woken up to keep the windows current.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
+#include <trace/events/power.h>
+
+struct cpu_load_window_cpu {
+	struct sched_cpu_load prev;
+	unsigned int idx;
+	unsigned int history[0];
+};
+
+/**
+ * cpu_load_window_init - allocate the per-cpu state of a window
+ * @win:	window to set up
+ * @name:	name reported by the cpu_load trace event
+ * @depth:	number of periods averaged by cpu_load_trend(), at least 1
+ */
+int cpu_load_window_init(struct cpu_load_window *win, const char *name,
+			 unsigned int depth)
+{
+	int cpu;
+
+	if (!depth)
+		return -EINVAL;
+
+	win->name = name;
+	win->depth = depth;
+	win->cpu = __alloc_percpu(sizeof(struct cpu_load_window_cpu) +
+				  depth * sizeof(unsigned int),
+				  __alignof__(struct cpu_load_window_cpu));
+	if (!win->cpu)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu)
+		cpu_load_window_reset(win, cpu, 0);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpu_load_window_init);
+
+void cpu_load_window_exit(struct cpu_load_window *win)
+{
+	free_percpu(win->cpu);
+	win->cpu = NULL;
+}
+EXPORT_SYMBOL_GPL(cpu_load_window_exit);
+
+/**
+ * cpu_load_window_reset - start a new period for a cpu
+ * @win:	window
+ * @cpu:	cpu whose history is restarted
+ * @load:	value the history is filled with
+ */
+void cpu_load_window_reset(struct cpu_load_window *win, int cpu,
+			   unsigned int load)
+{
+	struct cpu_load_window_cpu *c = per_cpu_ptr(win->cpu, cpu);
+	unsigned int i;
+
+	sched_get_cpu_load(cpu, &c->prev);
+	for (i = 0; i < win->depth; i++)
+		c->history[i] = load;
+	c->idx = 0;
+}
+EXPORT_SYMBOL_GPL(cpu_load_window_reset);
+
+/**
+ * cpu_load_sample - close the current period of a cpu
+ * @win:	window
+ * @cpu:	cpu to sample
+ * @sample:	load of the cpu since the previous call
+ *
+ * Returns -EAGAIN, and leaves the history untouched, when the runqueue
+ * clock did not move since the previous sample.
+ */
+int cpu_load_sample(struct cpu_load_window *win, int cpu,
+		    struct cpu_load_sample *sample)
+{
+	struct cpu_load_window_cpu *c = per_cpu_ptr(win->cpu, cpu);
+	struct sched_cpu_load now;
+	u64 wall, busy, nr, switches;
+
+	sched_get_cpu_load(cpu, &now);
+	wall = now.time - c->prev.time;
+	busy = now.busy_sum - c->prev.busy_sum;
+	nr = now.nr_running_sum - c->prev.nr_running_sum;
+	switches = now.nr_switches - c->prev.nr_switches;
+	c->prev = now;
+
+	if (unlikely(!wall || busy > wall))
+		return -EAGAIN;
+
+	sample->load = div64_u64(busy << CPU_LOAD_SHIFT, wall);
+	sample->nr = div64_u64(nr << CPU_LOAD_SHIFT, wall);
+	sample->run_ns = div64_u64(busy, switches ? switches : 1);
+
+	c->history[c->idx] = sample->load;
+	if (++c->idx >= win->depth)
+		c->idx = 0;
+
+	trace_cpu_load(win->name, cpu, sample->load, sample->nr);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(cpu_load_sample);
+
+/**
+ * cpu_load_trend - mean load of a cpu over the last @win->depth periods
+ */
+unsigned int cpu_load_trend(struct cpu_load_window *win, int cpu)
+{
+	struct cpu_load_window_cpu *c = per_cpu_ptr(win->cpu, cpu);
+	unsigned int i, load = 0;
+
+	for (i = 0; i < win->depth; i++)
+		load += c->history[i];
+
+	return load / win->depth;
+}
+EXPORT_SYMBOL_GPL(cpu_load_trend);
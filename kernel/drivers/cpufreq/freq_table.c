@@ -234,6 +234,25 @@ struct cpufreq_frequency_table *cpufreq_frequency_get_table(unsigned int cpu)
 }
 EXPORT_SYMBOL_GPL(cpufreq_frequency_get_table);
 
+static const struct cpufreq_power_entry *cpufreq_power_table;
+
+/*
+ * The power table describes the platform cpus, it is shared by all of
+ * them and must stay valid for as long as it is set.
+ */
+void cpufreq_power_table_set(const struct cpufreq_power_entry *table)
+{
+	dprintk("setting power table to %p\n", table);
+	cpufreq_power_table = table;
+}
+EXPORT_SYMBOL_GPL(cpufreq_power_table_set);
+
+const struct cpufreq_power_entry *cpufreq_power_table_get(void)
+{
+	return cpufreq_power_table;
+}
+EXPORT_SYMBOL_GPL(cpufreq_power_table_get);
+
 MODULE_AUTHOR("Dominik Brodowski <linux@brodo.de>");
 MODULE_DESCRIPTION("CPUfreq frequency table helpers");
 MODULE_LICENSE("GPL");
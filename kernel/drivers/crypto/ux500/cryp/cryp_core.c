@@ -11,6 +11,7 @@
 #include <linux/clk.h>
 #include <linux/completion.h>
 #include <linux/crypto.h>
+#include <linux/debugfs.h>
 #include <linux/dmaengine.h>
 #include <linux/err.h>
 #include <linux/errno.h>
@@ -22,6 +23,7 @@
 #include <linux/platform_device.h>
 #include <mach/regulator.h>
 #include <linux/semaphore.h>
+#include <linux/workqueue.h>
 
 #include <crypto/aes.h>
 #include <crypto/algapi.h>
@@ -41,21 +43,69 @@
 #define CRYP_MAX_KEY_SIZE	32
 #define BYTES_PER_WORD		4
 
+#define CRYP_QUEUE_LENGTH	64
+/* Requests run before the device is handed back to other users */
+#define CRYP_MAX_BATCH		16
+
 static int cryp_mode;
 static atomic_t session_id;
 
 static struct stedma40_chan_cfg *mem_to_engine;
 static struct stedma40_chan_cfg *engine_to_mem;
 
+/**
+ * struct cryp_stats - Counters exported in debugfs.
+ * @requests: Number of ablkcipher requests run.
+ * @bytes: Number of bytes processed by those requests.
+ * @dma_requests: Requests run in DMA mode.
+ * @cpu_requests: Requests run in polling or interrupt mode.
+ * @batches: Number of times the device was taken to run queued requests.
+ * @max_batch: Largest number of requests run in one batch.
+ */
+struct cryp_stats {
+	u32 requests;
+	u64 bytes;
+	u32 dma_requests;
+	u32 cpu_requests;
+	u32 batches;
+	u32 max_batch;
+};
+
 /**
  * struct cryp_driver_data - data specific to the driver.
  *
  * @device_list: A list of registered devices to choose from.
  * @device_allocation: A semaphore initialized with number of devices.
+ * @queue: ablkcipher requests waiting for a device.
+ * @queue_lock: Lock for queue.
+ * @workqueue: Runs the queued requests.
+ * @work: The work item draining queue.
+ * @stats: Request counters, only updated from work.
+ * @debugfs_dir: debugfs directory holding the counters.
  */
 struct cryp_driver_data {
 	struct klist device_list;
 	struct semaphore device_allocation;
+	struct crypto_queue queue;
+	spinlock_t queue_lock;
+	struct workqueue_struct *workqueue;
+	struct work_struct work;
+	struct cryp_stats stats;
+	struct dentry *debugfs_dir;
+};
+
+/**
+ * struct cryp_req_ctx - Per request context.
+ * @algodir: Encrypt or decrypt.
+ * @algomode: Algorithm and chaining mode.
+ * @blocksize: Block size of the algorithm.
+ * @dma: Run the request in DMA mode.
+ */
+struct cryp_req_ctx {
+	enum cryp_algorithm_dir algodir;
+	enum cryp_algo_mode algomode;
+	u32 blocksize;
+	bool dma;
 };
 
 /**
@@ -811,11 +861,11 @@ static int get_nents(struct scatterlist *sg, int nbytes)
 	return nents;
 }
 
-static int ablk_dma_crypt(struct ablkcipher_request *areq)
+static int ablk_dma_crypt(struct ablkcipher_request *areq,
+			  struct cryp_device_data *device_data)
 {
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
 	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-	struct cryp_device_data *device_data;
 
 	int bytes_written = 0;
 	int bytes_read = 0;
@@ -825,21 +875,11 @@ static int ablk_dma_crypt(struct ablkcipher_request *areq)
 
 	ctx->datalen = areq->nbytes;
 	ctx->outlen = areq->nbytes;
-
-	ret = cryp_get_device_data(ctx, &device_data);
-	if (ret)
-		return ret;
-
-	ret = cryp_enable_power(device_data->dev, device_data, false);
-	if (ret) {
-		dev_err(device_data->dev, "[%s]: "
-			"cryp_enable_power() failed!", __func__);
-		goto out;
-	}
+	ctx->iv = areq->info;
 
 	ret = cryp_setup_context(ctx, device_data);
 	if (ret)
-		goto out_power;
+		return ret;
 
 	/* We have the device now, so store the nents in the dma struct. */
 	ctx->device->dma.nents_src = get_nents(areq->src, ctx->datalen);
@@ -857,35 +897,18 @@ static int ablk_dma_crypt(struct ablkcipher_request *areq)
 	cryp_save_device_context(device_data, &ctx->dev_ctx, cryp_mode);
 	ctx->updated = 1;
 
-out_power:
-	if (cryp_disable_power(device_data->dev, device_data, false))
-		dev_err(device_data->dev, "[%s]: "
-			"cryp_disable_power() failed!", __func__);
-
-out:
-	spin_lock(&device_data->ctx_lock);
-	device_data->current_ctx = NULL;
-	ctx->device = NULL;
-	spin_unlock(&device_data->ctx_lock);
-
-	/*
-	 * The down_interruptible part for this semaphore is called in
-	 * cryp_get_device_data.
-	 */
-	up(&driver_data.device_allocation);
-
 	if (unlikely(bytes_written != bytes_read))
 		return -EPERM;
 
 	return 0;
 }
 
-static int ablk_crypt(struct ablkcipher_request *areq)
+static int ablk_crypt(struct ablkcipher_request *areq,
+		      struct cryp_device_data *device_data)
 {
 	struct ablkcipher_walk walk;
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
 	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-	struct cryp_device_data *device_data;
 	unsigned long src_paddr;
 	unsigned long dst_paddr;
 	int ret;
@@ -893,24 +916,13 @@ static int ablk_crypt(struct ablkcipher_request *areq)
 
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ret = cryp_get_device_data(ctx, &device_data);
-	if (ret)
-		goto out;
-
-	ret = cryp_enable_power(device_data->dev, device_data, false);
-	if (ret) {
-		dev_err(device_data->dev, "[%s]: "
-			"cryp_enable_power() failed!", __func__);
-		goto out_power;
-	}
-
 	ablkcipher_walk_init(&walk, areq->dst, areq->src, areq->nbytes);
 	ret = ablkcipher_walk_phys(areq, &walk);
 
 	if (ret) {
 		pr_err(DEV_DBG_NAME "[%s]: ablkcipher_walk_phys() failed!",
 			__func__);
-		goto out_power;
+		return ret;
 	}
 
 	while ((nbytes = walk.nbytes) > 0) {
@@ -925,35 +937,180 @@ static int ablk_crypt(struct ablkcipher_request *areq)
 
 		ret = hw_crypt_noxts(ctx, device_data);
 		if (ret)
-			goto out_power;
+			return ret;
 
 		nbytes -= ctx->datalen;
 		ret = ablkcipher_walk_done(areq, &walk, nbytes);
 		if (ret)
-			goto out_power;
+			return ret;
 	}
 	ablkcipher_walk_complete(&walk);
 
-out_power:
-	if (cryp_disable_power(device_data->dev, device_data, false))
-		dev_err(device_data->dev, "[%s]: "
-			"cryp_disable_power() failed!", __func__);
-out:
-	/* Release the device */
+	return 0;
+}
+
+/**
+ * cryp_run_request - Runs one ablkcipher request on an allocated device.
+ * @areq: The request.
+ * @device_data: The device, powered and allocated by the caller.
+ */
+static int cryp_run_request(struct ablkcipher_request *areq,
+			    struct cryp_device_data *device_data)
+{
+	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
+	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
+	struct cryp_req_ctx *req_ctx = ablkcipher_request_ctx(areq);
+	int ret;
+
+	spin_lock(&device_data->ctx_lock);
+	device_data->current_ctx = ctx;
+	ctx->device = device_data;
+	spin_unlock(&device_data->ctx_lock);
+
+	ctx->config.algodir = req_ctx->algodir;
+	ctx->config.algomode = req_ctx->algomode;
+	ctx->blocksize = req_ctx->blocksize;
+	/* Each request carries its own IV, so program the engine again. */
+	ctx->updated = 0;
+
+	driver_data.stats.requests++;
+	driver_data.stats.bytes += areq->nbytes;
+
+	if (req_ctx->dma) {
+		driver_data.stats.dma_requests++;
+		ret = ablk_dma_crypt(areq, device_data);
+	} else {
+		driver_data.stats.cpu_requests++;
+		ret = ablk_crypt(areq, device_data);
+	}
+
 	spin_lock(&device_data->ctx_lock);
-	device_data->current_ctx = NULL;
 	ctx->device = NULL;
 	spin_unlock(&device_data->ctx_lock);
 
-	/*
-	 * The down_interruptible part for this semaphore is called in
-	 * cryp_get_device_data.
-	 */
-	up(&driver_data.device_allocation);
+	return ret;
+}
+
+static struct ablkcipher_request *cryp_dequeue(void)
+{
+	struct crypto_async_request *async_req, *backlog;
+	unsigned long flags;
+
+	spin_lock_irqsave(&driver_data.queue_lock, flags);
+	backlog = crypto_get_backlog(&driver_data.queue);
+	async_req = crypto_dequeue_request(&driver_data.queue);
+	spin_unlock_irqrestore(&driver_data.queue_lock, flags);
+
+	if (backlog)
+		backlog->complete(backlog, -EINPROGRESS);
+
+	return async_req ? ablkcipher_request_cast(async_req) : NULL;
+}
+
+static void cryp_complete(struct ablkcipher_request *areq, int ret)
+{
+	local_bh_disable();
+	areq->base.complete(&areq->base, ret);
+	local_bh_enable();
+}
+
+/**
+ * cryp_queue_work - Runs the queued ablkcipher requests.
+ * @work: The driver work item.
+ *
+ * The device is taken and powered once for up to CRYP_MAX_BATCH requests,
+ * instead of once per request.
+ */
+static void cryp_queue_work(struct work_struct *work)
+{
+	struct ablkcipher_request *areq;
+	struct cryp_ctx *ctx;
+	struct cryp_device_data *device_data;
+	int batch;
+	int ret;
+
+	while ((areq = cryp_dequeue()) != NULL) {
+		ctx = crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(areq));
+
+		ret = cryp_get_device_data(ctx, &device_data);
+		if (ret) {
+			cryp_complete(areq, ret);
+			continue;
+		}
+
+		ret = cryp_enable_power(device_data->dev, device_data, false);
+		if (ret) {
+			dev_err(device_data->dev, "[%s]: "
+				"cryp_enable_power() failed!", __func__);
+			cryp_complete(areq, ret);
+			goto out;
+		}
+
+		batch = 0;
+		do {
+			ret = cryp_run_request(areq, device_data);
+			cryp_complete(areq, ret);
+		} while (++batch < CRYP_MAX_BATCH &&
+			 (areq = cryp_dequeue()) != NULL);
+
+		driver_data.stats.batches++;
+		if (batch > driver_data.stats.max_batch)
+			driver_data.stats.max_batch = batch;
+
+		if (cryp_disable_power(device_data->dev, device_data, false))
+			dev_err(device_data->dev, "[%s]: "
+				"cryp_disable_power() failed!", __func__);
+out:
+		spin_lock(&device_data->ctx_lock);
+		device_data->current_ctx = NULL;
+		spin_unlock(&device_data->ctx_lock);
+
+		/*
+		 * The down_interruptible part for this semaphore is called in
+		 * cryp_get_device_data.
+		 */
+		up(&driver_data.device_allocation);
+	}
+}
+
+/**
+ * cryp_enqueue - Queues an ablkcipher request for the device.
+ * @areq: The request.
+ * @algodir: Encrypt or decrypt.
+ * @algomode: Algorithm and chaining mode.
+ * @blocksize: Block size of the algorithm.
+ * @dma: Run the request in DMA mode.
+ */
+static int cryp_enqueue(struct ablkcipher_request *areq,
+			enum cryp_algorithm_dir algodir,
+			enum cryp_algo_mode algomode,
+			u32 blocksize, bool dma)
+{
+	struct cryp_req_ctx *req_ctx = ablkcipher_request_ctx(areq);
+	unsigned long flags;
+	int ret;
+
+	req_ctx->algodir = algodir;
+	req_ctx->algomode = algomode;
+	req_ctx->blocksize = blocksize;
+	req_ctx->dma = dma;
+
+	spin_lock_irqsave(&driver_data.queue_lock, flags);
+	ret = ablkcipher_enqueue_request(&driver_data.queue, areq);
+	spin_unlock_irqrestore(&driver_data.queue_lock, flags);
+
+	queue_work(driver_data.workqueue, &driver_data.work);
 
 	return ret;
 }
 
+static int cryp_ablkcipher_cra_init(struct crypto_tfm *tfm)
+{
+	tfm->crt_ablkcipher.reqsize = sizeof(struct cryp_req_ctx);
+
+	return 0;
+}
+
 static int aes_ablkcipher_setkey(struct crypto_ablkcipher *cipher,
 				 const u8 *key, unsigned int keylen)
 {
@@ -1338,266 +1495,170 @@ static void des3_decrypt(struct crypto_tfm *tfm, u8 *out, const u8 *in)
 
 static int aes_ecb_encrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_ECB;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
-	if (cryp_mode == CRYP_MODE_DMA)
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_AES_ECB,
+			    AES_BLOCK_SIZE, cryp_mode == CRYP_MODE_DMA);
 }
 
 static int aes_ecb_decrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_ECB;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
-	if (cryp_mode == CRYP_MODE_DMA)
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_AES_ECB,
+			    AES_BLOCK_SIZE, cryp_mode == CRYP_MODE_DMA);
 }
 
 static int aes_cbc_encrypt(struct ablkcipher_request *areq)
 {
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
 	u32 *flags = &cipher->base.crt_flags;
 
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_CBC;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
 	/* Only DMA for ablkcipher, since givcipher not yet supported */
-	if ((cryp_mode == CRYP_MODE_DMA) &&
-			(*flags & CRYPTO_ALG_TYPE_ABLKCIPHER))
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_AES_CBC,
+			    AES_BLOCK_SIZE,
+			    (cryp_mode == CRYP_MODE_DMA) &&
+			    (*flags & CRYPTO_ALG_TYPE_ABLKCIPHER));
 }
 
 static int aes_cbc_decrypt(struct ablkcipher_request *areq)
 {
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
 	u32 *flags = &cipher->base.crt_flags;
 
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_CBC;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
 	/* Only DMA for ablkcipher, since givcipher not yet supported */
-	if ((cryp_mode == CRYP_MODE_DMA) &&
-			(*flags & CRYPTO_ALG_TYPE_ABLKCIPHER))
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_AES_CBC,
+			    AES_BLOCK_SIZE,
+			    (cryp_mode == CRYP_MODE_DMA) &&
+			    (*flags & CRYPTO_ALG_TYPE_ABLKCIPHER));
 }
 
 static int aes_ctr_encrypt(struct ablkcipher_request *areq)
 {
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
 	u32 *flags = &cipher->base.crt_flags;
 
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_CTR;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
 	/* Only DMA for ablkcipher, since givcipher not yet supported */
-	if ((cryp_mode == CRYP_MODE_DMA) &&
-			(*flags & CRYPTO_ALG_TYPE_ABLKCIPHER))
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_AES_CTR,
+			    AES_BLOCK_SIZE,
+			    (cryp_mode == CRYP_MODE_DMA) &&
+			    (*flags & CRYPTO_ALG_TYPE_ABLKCIPHER));
 }
 
 static int aes_ctr_decrypt(struct ablkcipher_request *areq)
 {
 	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
 	u32 *flags = &cipher->base.crt_flags;
 
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_AES_CTR;
-	ctx->blocksize = AES_BLOCK_SIZE;
-
 	/* Only DMA for ablkcipher, since givcipher not yet supported */
-	if ((cryp_mode == CRYP_MODE_DMA) &&
-			(*flags & CRYPTO_ALG_TYPE_ABLKCIPHER))
-		return ablk_dma_crypt(areq);
-
-	/* For everything except DMA, we run the non DMA version. */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_AES_CTR,
+			    AES_BLOCK_SIZE,
+			    (cryp_mode == CRYP_MODE_DMA) &&
+			    (*flags & CRYPTO_ALG_TYPE_ABLKCIPHER));
 }
 
 static int des_ecb_encrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_DES_ECB;
-	ctx->blocksize = DES_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_DES_ECB,
+			    DES_BLOCK_SIZE, false);
 }
 
 static int des_ecb_decrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_DES_ECB;
-	ctx->blocksize = DES_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_DES_ECB,
+			    DES_BLOCK_SIZE, false);
 }
 
 static int des_cbc_encrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_DES_CBC;
-	ctx->blocksize = DES_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_DES_CBC,
+			    DES_BLOCK_SIZE, false);
 }
 
 static int des_cbc_decrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_DES_CBC;
-	ctx->blocksize = DES_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_DES_CBC,
+			    DES_BLOCK_SIZE, false);
 }
 
 static int des3_ecb_encrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_TDES_ECB;
-	ctx->blocksize = DES3_EDE_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_TDES_ECB,
+			    DES3_EDE_BLOCK_SIZE, false);
 }
 
 static int des3_ecb_decrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_TDES_ECB;
-	ctx->blocksize = DES3_EDE_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_TDES_ECB,
+			    DES3_EDE_BLOCK_SIZE, false);
 }
 
 static int des3_cbc_encrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_ENCRYPT;
-	ctx->config.algomode = CRYP_ALGO_TDES_CBC;
-	ctx->blocksize = DES3_EDE_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_ENCRYPT, CRYP_ALGO_TDES_CBC,
+			    DES3_EDE_BLOCK_SIZE, false);
 }
 
 static int des3_cbc_decrypt(struct ablkcipher_request *areq)
 {
-	struct crypto_ablkcipher *cipher = crypto_ablkcipher_reqtfm(areq);
-	struct cryp_ctx *ctx = crypto_ablkcipher_ctx(cipher);
-
 	pr_debug(DEV_DBG_NAME " [%s]", __func__);
 
-	ctx->config.algodir = CRYP_ALGORITHM_DECRYPT;
-	ctx->config.algomode = CRYP_ALGO_TDES_CBC;
-	ctx->blocksize = DES3_EDE_BLOCK_SIZE;
-
 	/*
 	 * Run the non DMA version also for DMA, since DMA is currently not
 	 * working for DES.
 	 */
-	return ablk_crypt(areq);
+	return cryp_enqueue(areq, CRYP_ALGORITHM_DECRYPT, CRYP_ALGO_TDES_CBC,
+			    DES3_EDE_BLOCK_SIZE, false);
 }
 
 /**
@@ -1685,6 +1746,7 @@ static struct crypto_alg aes_ecb_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(aes_ecb_alg.cra_list),
 	.cra_u			=	{
@@ -1711,6 +1773,7 @@ static struct crypto_alg aes_cbc_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(aes_cbc_alg.cra_list),
 	.cra_u			=	{
@@ -1738,6 +1801,7 @@ static struct crypto_alg aes_ctr_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(aes_ctr_alg.cra_list),
 	.cra_u			=	{
@@ -1765,6 +1829,7 @@ static struct crypto_alg des_ecb_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(des_ecb_alg.cra_list),
 	.cra_u			=	{
@@ -1791,6 +1856,7 @@ static struct crypto_alg des_cbc_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(des_cbc_alg.cra_list),
 	.cra_u			=	{
@@ -1818,6 +1884,7 @@ static struct crypto_alg des3_ecb_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(des3_ecb_alg.cra_list),
 	.cra_u			=	{
@@ -1844,6 +1911,7 @@ static struct crypto_alg des3_cbc_alg = {
 	.cra_ctxsize		=	sizeof(struct cryp_ctx),
 	.cra_alignmask		=	3,
 	.cra_type		=	&crypto_ablkcipher_type,
+	.cra_init		=	cryp_ablkcipher_cra_init,
 	.cra_module		=	THIS_MODULE,
 	.cra_list		=	LIST_HEAD_INIT(des3_cbc_alg.cra_list),
 	.cra_u			=	{
@@ -2285,20 +2353,63 @@ static struct platform_driver cryp_driver = {
 	}
 };
 
+static void cryp_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("ux500_cryp", NULL);
+
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_u32("requests", S_IRUGO, dir,
+			   &driver_data.stats.requests);
+	debugfs_create_u64("bytes", S_IRUGO, dir, &driver_data.stats.bytes);
+	debugfs_create_u32("dma_requests", S_IRUGO, dir,
+			   &driver_data.stats.dma_requests);
+	debugfs_create_u32("cpu_requests", S_IRUGO, dir,
+			   &driver_data.stats.cpu_requests);
+	debugfs_create_u32("batches", S_IRUGO, dir,
+			   &driver_data.stats.batches);
+	debugfs_create_u32("max_batch", S_IRUGO, dir,
+			   &driver_data.stats.max_batch);
+
+	driver_data.debugfs_dir = dir;
+}
+
 static int __init u8500_cryp_mod_init(void)
 {
+	int ret;
+
 	pr_debug("[%s] is called!", __func__);
 
 	klist_init(&driver_data.device_list, NULL, NULL);
 	/* Initialize the semaphore to 0 devices (locked state) */
 	sema_init(&driver_data.device_allocation, 0);
-	return platform_driver_register(&cryp_driver);
+
+	crypto_init_queue(&driver_data.queue, CRYP_QUEUE_LENGTH);
+	spin_lock_init(&driver_data.queue_lock);
+	INIT_WORK(&driver_data.work, cryp_queue_work);
+
+	driver_data.workqueue = create_singlethread_workqueue("u8500_cryp");
+	if (!driver_data.workqueue)
+		return -ENOMEM;
+
+	ret = platform_driver_register(&cryp_driver);
+	if (ret) {
+		destroy_workqueue(driver_data.workqueue);
+		return ret;
+	}
+
+	cryp_debugfs_init();
+
+	return 0;
 }
 
 static void __exit u8500_cryp_mod_fini(void)
 {
 	pr_debug("[%s] is called!", __func__);
+	debugfs_remove_recursive(driver_data.debugfs_dir);
 	platform_driver_unregister(&cryp_driver);
+	destroy_workqueue(driver_data.workqueue);
 	return;
 }
 
@@ -9,6 +9,13 @@
 #define _HASH_ALG_H
 
 #include <linux/bitops.h>
+#include <linux/completion.h>
+#include <linux/dmaengine.h>
+#include <linux/scatterlist.h>
+
+#include <crypto/hash.h>
+
+#include <mach/crypto-ux500.h>
 
 /* Number of bytes the message digest */
 #define HASH_MSG_DIGEST_SIZE	32
@@ -36,6 +43,15 @@
 #define HASH_RESET_LEN_HIGH_VAL		0x0
 #define HASH_RESET_LEN_LOW_VAL		0x0
 
+/* DMA transfers are done in words */
+#define HASH_DMA_ALIGN_SIZE		4
+/* Below this, the DMA setup costs more than feeding DIN from the CPU */
+#define HASH_DMA_PERFORMANCE_MIN_SIZE	1024
+/* Default size below which digest() is done by the software fallback */
+#define HASH_FALLBACK_SIZE		256
+/* Time to wait for a DMA transfer to complete */
+#define HASH_DMA_TIMEOUT		msecs_to_jiffies(1000)
+
 /* Control register bitfields */
 #define HASH_CR_RESUME_MASK	0x11FCF
 
@@ -278,6 +294,39 @@ enum hash_op {
 	HASH_OPER_MODE_HMAC = 0x1
 };
 
+/**
+ * enum hash_mode - Enumeration for selecting the way data is fed to the HASH.
+ * @HASH_MODE_CPU:	Data is written to HASH_DIN by the CPU.
+ * @HASH_MODE_DMA:	Large aligned messages are transferred by DMA.
+ */
+enum hash_mode {
+	HASH_MODE_CPU = 0,
+	HASH_MODE_DMA = 1
+};
+
+/**
+ * enum hash_req_op - Operation a queued request is waiting for.
+ * @HASH_REQ_UPDATE:	ahash update.
+ * @HASH_REQ_FINAL:	ahash final.
+ * @HASH_REQ_DIGEST:	ahash digest, i.e. update and final in one go.
+ */
+enum hash_req_op {
+	HASH_REQ_UPDATE,
+	HASH_REQ_FINAL,
+	HASH_REQ_DIGEST
+};
+
+/**
+ * struct hash_req_ctx - The per request context.
+ * @op:	The operation to perform when the request is dequeued.
+ * @fallback_desc: Descriptor for the software fallback, followed by its
+ *		context. Must be the last member.
+ */
+struct hash_req_ctx {
+	enum hash_req_op	op;
+	struct shash_desc	fallback_desc;
+};
+
 /**
  * struct hash_config - Configuration data for the hardware.
  * @data_format:	Format of data entered into the hash data in register.
@@ -299,6 +348,7 @@ struct hash_config {
  * @config:	The current configuration.
  * @digestsize	The size of current digest.
  * @device	Pointer to the device structure.
+ * @fallback:	Software implementation used for short messages.
  */
 struct hash_ctx {
 	u8			key[HASH_BLOCK_SIZE];
@@ -308,6 +358,27 @@ struct hash_ctx {
 	struct hash_config	config;
 	int			digestsize;
 	struct hash_device_data	*device;
+	struct crypto_shash	*fallback;
+};
+
+/**
+ * struct hash_dma - Structure used for dma.
+ * @mask:		DMA capabilities bitmap mask.
+ * @complete:		Used to wait for the end of the transfer.
+ * @chan_mem2hash:	DMA channel, NULL if DMA is not used.
+ * @cfg_mem2hash:	DMA channel configuration.
+ * @sg:			Scatterlist being transferred.
+ * @sg_len:		Number of mapped entries in @sg.
+ * @nents:		Number of entries in @sg.
+ */
+struct hash_dma {
+	dma_cap_mask_t			mask;
+	struct completion		complete;
+	struct dma_chan			*chan_mem2hash;
+	struct stedma40_chan_cfg	*cfg_mem2hash;
+	struct scatterlist		*sg;
+	int				sg_len;
+	int				nents;
 };
 
 /**
@@ -322,6 +393,7 @@ struct hash_ctx {
  * @regulator:		Pointer to the device's power control.
  * @clk:		Pointer to the device's clock control.
  * @restore_dev_state:	TRUE = saved state, FALSE = no saved state.
+ * @dma:		Structure used for dma.
  */
 struct hash_device_data {
 	struct hash_register __iomem	*base;
@@ -334,6 +406,7 @@ struct hash_device_data {
 	struct ux500_regulator		*regulator;
 	struct clk			*clk;
 	bool				restore_dev_state;
+	struct hash_dma			dma;
 };
 
 int hash_check_hw(struct hash_device_data *device_data);
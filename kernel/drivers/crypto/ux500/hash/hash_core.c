@@ -12,6 +12,7 @@
 
 #include <linux/clk.h>
 #include <linux/device.h>
+#include <linux/dmaengine.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/io.h>
@@ -20,6 +21,8 @@
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/crypto.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <mach/regulator.h>
 #include <linux/bitops.h>
@@ -30,20 +33,34 @@
 #include <crypto/algapi.h>
 
 #include <mach/hardware.h>
+#include <plat/ste_dma40.h>
 
 #include "hash_alg.h"
 
 #define DEV_DBG_NAME "hashX hashX:"
 
+#define HASH_QUEUE_LENGTH	50
+
+static int hash_mode = HASH_MODE_DMA;
+static unsigned int hash_fallback_size = HASH_FALLBACK_SIZE;
+
 /**
  * struct hash_driver_data - data specific to the driver.
  *
  * @device_list:	A list of registered devices to choose from.
  * @device_allocation:	A semaphore initialized with number of devices.
+ * @queue:		Requests waiting for a device.
+ * @queue_lock:		Spinlock for queue.
+ * @workqueue:		Runs the requests, since they may have to sleep.
+ * @work:		The work item draining queue.
  */
 struct hash_driver_data {
 	struct klist		device_list;
 	struct semaphore	device_allocation;
+	struct crypto_queue	queue;
+	spinlock_t		queue_lock;
+	struct workqueue_struct	*workqueue;
+	struct work_struct	work;
 };
 
 static struct hash_driver_data	driver_data;
@@ -830,30 +847,207 @@ void hash_get_digest(struct hash_device_data *device_data,
 }
 
 /**
- * hash_update - The hash update function for SHA1/SHA2 (SHA256).
- * @req: The hash request for the job.
+ * hash_dma_setup_channel - Requests the DMA channel feeding HASH_DIN.
+ * @device_data:	Structure for the hash device.
+ * @dev:		The device, holding the channel configuration.
  */
-static int ahash_update(struct ahash_request *req)
+static void hash_dma_setup_channel(struct hash_device_data *device_data,
+		struct device *dev)
+{
+	struct hash_platform_data *platform_data = dev->platform_data;
+
+	dma_cap_zero(device_data->dma.mask);
+	dma_cap_set(DMA_SLAVE, device_data->dma.mask);
+
+	device_data->dma.cfg_mem2hash = &platform_data->mem_to_engine;
+	device_data->dma.chan_mem2hash =
+		dma_request_channel(device_data->dma.mask,
+				    stedma40_filter,
+				    device_data->dma.cfg_mem2hash);
+
+	init_completion(&device_data->dma.complete);
+}
+
+static void hash_dma_callback(void *data)
+{
+	struct hash_ctx *ctx = (struct hash_ctx *) data;
+
+	complete(&ctx->device->dma.complete);
+}
+
+/**
+ * hash_dma_valid_data - Checks if a message can be transferred by DMA.
+ * @sg:		Scatterlist holding the message.
+ * @nbytes:	Length of the message.
+ * @nents:	Number of scatterlist entries covering the message.
+ *
+ * The DMA moves whole words, so every entry has to be word aligned and a
+ * whole number of words long.
+ */
+static bool hash_dma_valid_data(struct scatterlist *sg, int nbytes,
+		int *nents)
+{
+	int count = 0;
+
+	if (!IS_ALIGNED(nbytes, HASH_DMA_ALIGN_SIZE))
+		return false;
+
+	while (nbytes > 0 && sg) {
+		if (!IS_ALIGNED(sg->offset, HASH_DMA_ALIGN_SIZE) ||
+		    !IS_ALIGNED(sg->length, HASH_DMA_ALIGN_SIZE) ||
+		    sg->length > nbytes)
+			return false;
+
+		nbytes -= sg->length;
+		count++;
+		sg = sg_next(sg);
+	}
+
+	*nents = count;
+
+	return nbytes == 0;
+}
+
+static int hash_set_dma_transfer(struct hash_ctx *ctx, struct scatterlist *sg)
+{
+	struct dma_async_tx_descriptor *desc;
+	struct dma_chan *channel = ctx->device->dma.chan_mem2hash;
+
+	dev_dbg(ctx->device->dev, "[%s]: ", __func__);
+
+	ctx->device->dma.sg = sg;
+	ctx->device->dma.sg_len = dma_map_sg(channel->device->dev,
+					     ctx->device->dma.sg,
+					     ctx->device->dma.nents,
+					     DMA_TO_DEVICE);
+	if (!ctx->device->dma.sg_len) {
+		dev_err(ctx->device->dev, "[%s]: Could not map the sg list "
+				"(TO_DEVICE)", __func__);
+		return -EFAULT;
+	}
+
+	desc = channel->device->device_prep_slave_sg(channel,
+				     ctx->device->dma.sg,
+				     ctx->device->dma.sg_len,
+				     DMA_TO_DEVICE,
+				     DMA_CTRL_ACK | DMA_PREP_INTERRUPT);
+	if (!desc) {
+		dev_err(ctx->device->dev, "[%s]: device_prep_slave_sg() "
+				"failed!", __func__);
+		dma_unmap_sg(channel->device->dev, ctx->device->dma.sg,
+			     ctx->device->dma.nents, DMA_TO_DEVICE);
+		return -EFAULT;
+	}
+
+	desc->callback = hash_dma_callback;
+	desc->callback_param = ctx;
+
+	desc->tx_submit(desc);
+	dma_async_issue_pending(channel);
+
+	return 0;
+}
+
+static void hash_dma_done(struct hash_ctx *ctx)
+{
+	struct dma_chan *chan = ctx->device->dma.chan_mem2hash;
+
+	chan->device->device_control(chan, DMA_TERMINATE_ALL, 0);
+	dma_unmap_sg(chan->device->dev, ctx->device->dma.sg,
+		     ctx->device->dma.nents, DMA_TO_DEVICE);
+}
+
+/**
+ * hash_dma_digest - Hashes a whole message, fed to the hardware by DMA.
+ * @req:	The hash request for the job.
+ * @nents:	Number of scatterlist entries covering the message.
+ */
+static int hash_dma_digest(struct ahash_request *req, int nents)
 {
 	int ret = 0;
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct hash_ctx *ctx = crypto_ahash_ctx(tfm);
+	struct hash_device_data *device_data;
+	u8 digest[HASH_MSG_DIGEST_SIZE];
 
-	pr_debug(DEV_DBG_NAME "[%s] ", __func__);
+	ret = hash_get_device_data(ctx, &device_data);
+	if (ret)
+		return ret;
 
-	ret = hash_hw_update(req);
+	dev_dbg(device_data->dev, "[%s] (ctx=0x%x)!", __func__, (u32) ctx);
+
+	/* Enable device power (and clock) */
+	ret = hash_enable_power(device_data, false);
 	if (ret) {
-		pr_err(DEV_DBG_NAME "[%s] hash_hw_update() failed!", __func__);
+		dev_err(device_data->dev, "[%s]: "
+				"hash_enable_power() failed!", __func__);
 		goto out;
 	}
 
+	ret = hash_setconfiguration(device_data, &ctx->config);
+	if (ret) {
+		dev_err(device_data->dev, "[%s] hash_setconfiguration() "
+				"failed!", __func__);
+		goto out_power;
+	}
+
+	/*
+	 * DMAE bit. HASH_DIN is written by the DMA and the digest
+	 * calculation is started by the last burst of the transfer.
+	 */
+	HASH_SET_BITS(&device_data->base->cr, HASH_CR_DMAE_MASK);
+	hash_begin(device_data, ctx);
+
+	device_data->dma.nents = nents;
+	ret = hash_set_dma_transfer(ctx, req->src);
+	if (ret)
+		goto out_dmae;
+
+	if (!wait_for_completion_timeout(&device_data->dma.complete,
+				HASH_DMA_TIMEOUT)) {
+		dev_err(device_data->dev, "[%s] DMA transfer timed out!",
+				__func__);
+		ret = -ETIMEDOUT;
+	}
+	hash_dma_done(ctx);
+	if (ret)
+		goto out_dmae;
+
+	while (device_data->base->str & HASH_STR_DCAL_MASK)
+		cpu_relax();
+
+	hash_get_digest(device_data, digest, ctx->config.algorithm);
+	memcpy(req->result, digest, ctx->digestsize);
+
+out_dmae:
+	HASH_CLEAR_BITS(&device_data->base->cr, HASH_CR_DMAE_MASK);
+
+out_power:
+	/* Disable power (and clock) */
+	if (hash_disable_power(device_data, false))
+		dev_err(device_data->dev, "[%s] hash_disable_power() failed!",
+				__func__);
+
 out:
+	spin_lock(&device_data->ctx_lock);
+	device_data->current_ctx = NULL;
+	ctx->device = NULL;
+	spin_unlock(&device_data->ctx_lock);
+
+	/*
+	 * The down_interruptible part for this semaphore is called in
+	 * hash_get_device_data.
+	 */
+	up(&driver_data.device_allocation);
+
 	return ret;
 }
 
 /**
- * hash_final - The hash final function for SHA1/SHA2 (SHA256).
+ * hash_hw_final - Pads the message and reads out the digest.
  * @req:	The hash request for the job.
  */
-static int ahash_final(struct ahash_request *req)
+static int hash_hw_final(struct ahash_request *req)
 {
 	int ret = 0;
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
@@ -920,6 +1114,173 @@ out:
 	return ret;
 }
 
+/**
+ * hash_hw_digest - Runs a queued digest request on the hardware.
+ * @req:	The hash request for the job.
+ */
+static int hash_hw_digest(struct ahash_request *req)
+{
+	int nents;
+	int ret = 0;
+
+	if (hash_mode == HASH_MODE_DMA &&
+	    req->nbytes >= HASH_DMA_PERFORMANCE_MIN_SIZE &&
+	    hash_dma_valid_data(req->src, req->nbytes, &nents))
+		return hash_dma_digest(req, nents);
+
+	if (req->nbytes)
+		ret = hash_hw_update(req);
+	if (ret)
+		return ret;
+
+	return hash_hw_final(req);
+}
+
+/**
+ * hash_queue_work - Runs the queued requests, one at a time.
+ * @work:	The driver work item.
+ *
+ * Getting a device and waiting for the hardware may sleep, so requests are
+ * handed over to this work instead of being run in the caller's context.
+ */
+static void hash_queue_work(struct work_struct *work)
+{
+	struct crypto_async_request *async_req, *backlog;
+	struct ahash_request *req;
+	struct hash_req_ctx *req_ctx;
+	unsigned long flags;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&driver_data.queue_lock, flags);
+		backlog = crypto_get_backlog(&driver_data.queue);
+		async_req = crypto_dequeue_request(&driver_data.queue);
+		spin_unlock_irqrestore(&driver_data.queue_lock, flags);
+
+		if (!async_req)
+			break;
+
+		if (backlog)
+			backlog->complete(backlog, -EINPROGRESS);
+
+		req = ahash_request_cast(async_req);
+		req_ctx = ahash_request_ctx(req);
+
+		switch (req_ctx->op) {
+		case HASH_REQ_UPDATE:
+			ret = hash_hw_update(req);
+			break;
+		case HASH_REQ_FINAL:
+			ret = hash_hw_final(req);
+			break;
+		case HASH_REQ_DIGEST:
+			ret = hash_hw_digest(req);
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+
+		local_bh_disable();
+		async_req->complete(async_req, ret);
+		local_bh_enable();
+	}
+}
+
+/**
+ * hash_enqueue - Queues a request for the hardware.
+ * @req:	The hash request for the job.
+ * @op:		What to do with it.
+ */
+static int hash_enqueue(struct ahash_request *req, enum hash_req_op op)
+{
+	struct hash_req_ctx *req_ctx = ahash_request_ctx(req);
+	unsigned long flags;
+	int ret;
+
+	req_ctx->op = op;
+
+	spin_lock_irqsave(&driver_data.queue_lock, flags);
+	ret = ahash_enqueue_request(&driver_data.queue, req);
+	spin_unlock_irqrestore(&driver_data.queue_lock, flags);
+
+	queue_work(driver_data.workqueue, &driver_data.work);
+
+	return ret;
+}
+
+/**
+ * hash_fallback_prepare - Sets up the software fallback descriptor.
+ * @ctx:	Hash context.
+ * @req:	The hash request for the job.
+ */
+static struct shash_desc *hash_fallback_prepare(struct hash_ctx *ctx,
+		struct ahash_request *req)
+{
+	struct hash_req_ctx *req_ctx = ahash_request_ctx(req);
+
+	req_ctx->fallback_desc.tfm = ctx->fallback;
+	req_ctx->fallback_desc.flags =
+		req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+
+	return &req_ctx->fallback_desc;
+}
+
+/**
+ * hash_update - The hash update function for SHA1/SHA2 (SHA256).
+ * @req: The hash request for the job.
+ */
+static int ahash_update(struct ahash_request *req)
+{
+	pr_debug(DEV_DBG_NAME "[%s] ", __func__);
+
+	if (!req->nbytes)
+		return 0;
+
+	return hash_enqueue(req, HASH_REQ_UPDATE);
+}
+
+/**
+ * hash_final - The hash final function for SHA1/SHA2 (SHA256).
+ * @req:	The hash request for the job.
+ *
+ * A message shorter than one block never reached the hardware, it is still
+ * sitting in ctx->state.buffer. Hashing it in software is cheaper than
+ * powering up the HASH block for it.
+ */
+static int ahash_final(struct ahash_request *req)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct hash_ctx *ctx = crypto_ahash_ctx(tfm);
+
+	pr_debug(DEV_DBG_NAME "[%s] ", __func__);
+
+	if (!ctx->updated && ctx->fallback)
+		return crypto_shash_digest(hash_fallback_prepare(ctx, req),
+				(u8 *)ctx->state.buffer, ctx->state.index,
+				req->result);
+
+	return hash_enqueue(req, HASH_REQ_FINAL);
+}
+
+/**
+ * hash_digest - The hash digest function for SHA1/SHA2 (SHA256).
+ * @req:	The hash request for the job.
+ *
+ * Messages shorter than hash_fallback_size are hashed in software.
+ */
+static int hash_digest(struct ahash_request *req)
+{
+	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
+	struct hash_ctx *ctx = crypto_ahash_ctx(tfm);
+
+	if (ctx->fallback && req->nbytes < hash_fallback_size)
+		return shash_ahash_digest(req,
+				hash_fallback_prepare(ctx, req));
+
+	return hash_enqueue(req, HASH_REQ_DIGEST);
+}
+
 static int ahash_sha1_init(struct ahash_request *req)
 {
 	struct crypto_ahash *tfm = crypto_ahash_reqtfm(req);
@@ -952,30 +1313,60 @@ static int ahash_sha256_init(struct ahash_request *req)
 
 static int ahash_sha1_digest(struct ahash_request *req)
 {
-	int ret2, ret1 = ahash_sha1_init(req);
-
-	if (ret1)
-		goto out;
+	int ret = ahash_sha1_init(req);
 
-	ret1 = ahash_update(req);
-	ret2 = ahash_final(req);
+	if (ret)
+		return ret;
 
-out:
-	return ret1 ? ret1 : ret2;
+	return hash_digest(req);
 }
 
 static int ahash_sha256_digest(struct ahash_request *req)
 {
-	int ret2, ret1 = ahash_sha256_init(req);
+	int ret = ahash_sha256_init(req);
 
-	if (ret1)
-		goto out;
+	if (ret)
+		return ret;
 
-	ret1 = ahash_update(req);
-	ret2 = ahash_final(req);
+	return hash_digest(req);
+}
 
-out:
-	return ret1 ? ret1 : ret2;
+/**
+ * hash_cra_init - Sets up the request size and the software fallback.
+ * @tfm:	The transform being created.
+ */
+static int hash_cra_init(struct crypto_tfm *tfm)
+{
+	struct hash_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *alg_name = crypto_tfm_alg_name(tfm);
+
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+			sizeof(struct hash_req_ctx));
+
+	ctx->fallback = crypto_alloc_shash(alg_name, 0,
+			CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback)) {
+		/* Not fatal, everything then goes to the hardware. */
+		pr_debug(DEV_DBG_NAME "[%s] No fallback for %s", __func__,
+				alg_name);
+		ctx->fallback = NULL;
+		return 0;
+	}
+
+	/* The fallback descriptor is per request, make room for its state. */
+	crypto_ahash_set_reqsize(__crypto_ahash_cast(tfm),
+			sizeof(struct hash_req_ctx) +
+			crypto_shash_descsize(ctx->fallback));
+
+	return 0;
+}
+
+static void hash_cra_exit(struct crypto_tfm *tfm)
+{
+	struct hash_ctx *ctx = crypto_tfm_ctx(tfm);
+
+	if (ctx->fallback)
+		crypto_free_shash(ctx->fallback);
 }
 
 static struct ahash_alg ahash_sha1_alg = {
@@ -991,6 +1382,8 @@ static struct ahash_alg ahash_sha1_alg = {
 		.cra_flags	 = CRYPTO_ALG_TYPE_AHASH | CRYPTO_ALG_ASYNC,
 		.cra_blocksize	 = SHA1_BLOCK_SIZE,
 		.cra_ctxsize	 = sizeof(struct hash_ctx),
+		.cra_init	 = hash_cra_init,
+		.cra_exit	 = hash_cra_exit,
 		.cra_module	 = THIS_MODULE,
 	}
 };
@@ -1009,6 +1402,8 @@ static struct ahash_alg ahash_sha256_alg = {
 		.cra_blocksize   = SHA256_BLOCK_SIZE,
 		.cra_ctxsize	 = sizeof(struct hash_ctx),
 		.cra_type	 = &crypto_ahash_type,
+		.cra_init	 = hash_cra_init,
+		.cra_exit	 = hash_cra_exit,
 		.cra_module      = THIS_MODULE,
 	}
 };
@@ -1138,6 +1533,17 @@ static int u8500_hash_probe(struct platform_device *pdev)
 		goto out_power;
 	}
 
+	if (hash_mode == HASH_MODE_DMA) {
+		if (dev->platform_data)
+			hash_dma_setup_channel(device_data, dev);
+
+		if (!device_data->dma.chan_mem2hash) {
+			dev_warn(dev, "[%s] No DMA channel, using CPU mode",
+					__func__);
+			hash_mode = HASH_MODE_CPU;
+		}
+	}
+
 	platform_set_drvdata(pdev, device_data);
 
 	/* Put the new device into the device list... */
@@ -1159,6 +1565,9 @@ static int u8500_hash_probe(struct platform_device *pdev)
 	return 0;
 
 out_power:
+	if (device_data->dma.chan_mem2hash)
+		dma_release_channel(device_data->dma.chan_mem2hash);
+
 	hash_disable_power(device_data, false);
 
 out_clk:
@@ -1227,6 +1636,9 @@ static int u8500_hash_remove(struct platform_device *pdev)
 		dev_err(dev, "[%s]: hash_disable_power() failed",
 			__func__);
 
+	if (device_data->dma.chan_mem2hash)
+		dma_release_channel(device_data->dma.chan_mem2hash);
+
 	clk_put(device_data->clk);
 	ux500_regulator_put(device_data->regulator);
 
@@ -1387,13 +1799,27 @@ static struct platform_driver hash_driver = {
  */
 static int __init u8500_hash_mod_init(void)
 {
+	int ret;
+
 	pr_debug("[%s] is called!", __func__);
 
 	klist_init(&driver_data.device_list, NULL, NULL);
 	/* Initialize the semaphore to 0 devices (locked state) */
 	sema_init(&driver_data.device_allocation, 0);
 
-	return platform_driver_register(&hash_driver);
+	crypto_init_queue(&driver_data.queue, HASH_QUEUE_LENGTH);
+	spin_lock_init(&driver_data.queue_lock);
+	INIT_WORK(&driver_data.work, hash_queue_work);
+
+	driver_data.workqueue = create_singlethread_workqueue("u8500_hash");
+	if (!driver_data.workqueue)
+		return -ENOMEM;
+
+	ret = platform_driver_register(&hash_driver);
+	if (ret)
+		destroy_workqueue(driver_data.workqueue);
+
+	return ret;
 }
 
 /**
@@ -1403,12 +1829,19 @@ static void __exit u8500_hash_mod_fini(void)
 {
 	pr_debug("[%s] is called!", __func__);
 	platform_driver_unregister(&hash_driver);
+	destroy_workqueue(driver_data.workqueue);
 	return;
 }
 
 module_init(u8500_hash_mod_init);
 module_exit(u8500_hash_mod_fini);
 
+module_param(hash_mode, int, 0);
+MODULE_PARM_DESC(hash_mode, "CPU = 0, DMA = 1 (default)");
+module_param(hash_fallback_size, uint, 0644);
+MODULE_PARM_DESC(hash_fallback_size,
+		"digest() of messages shorter than this is done in software");
+
 MODULE_DESCRIPTION("Driver for ST-Ericsson U8500 HASH engine.");
 MODULE_LICENSE("GPL");
 
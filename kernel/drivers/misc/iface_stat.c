@@ -18,39 +18,79 @@
 #include <linux/kernel.h>
 #include <linux/in.h>
 #include <linux/list.h>
+#include <linux/jiffies.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
 #include <linux/netdevice.h>
 #include <linux/inetdevice.h>
 #include <linux/rtnetlink.h>
 #include <linux/iface_stat.h>
+#include <net/net_namespace.h>
 
+/*
+ * Entries are only ever added, under RTNL.  Readers walk the list under
+ * RCU and use iface_seq to get consistent 64-bit values, so sampling the
+ * stats never needs RTNL.
+ */
 static LIST_HEAD(iface_list);
+static DEFINE_SEQLOCK(iface_seq);
 static struct proc_dir_entry *iface_stat_procdir;
 
 struct iface_stat {
 	struct list_head if_link;
 	char *iface_name;
-	unsigned long tx_bytes;
-	unsigned long rx_bytes;
-	unsigned long tx_packets;
-	unsigned long rx_packets;
+	int ifindex;		/* of the device last seen with this name */
+	u64 tx_bytes;
+	u64 rx_bytes;
+	u64 tx_packets;
+	u64 rx_packets;
+	u64 active_jiffies;	/* accumulated while active */
+	unsigned long active_since;
 	bool active;
 };
 
+/* Called with iface_seq write locked. */
+static void iface_set_active(struct iface_stat *entry, bool active)
+{
+	if (active == entry->active)
+		return;
+	if (active)
+		entry->active_since = jiffies;
+	else
+		entry->active_jiffies += jiffies - entry->active_since;
+	entry->active = active;
+}
+
+/* Time spent active, up to now, in milliseconds. */
+static u64 iface_active_ms(struct iface_stat *entry)
+{
+	u64 j = entry->active_jiffies;
+
+	if (entry->active)
+		j += jiffies - entry->active_since;
+	return (u64)jiffies_to_msecs(1) * j;
+}
+
 static int read_proc_entry(char *page, char **start, off_t off,
 		int count, int *eof, void *data)
 {
 	int len;
-	unsigned long value;
+	u64 value;
+	unsigned seq;
 	char *p = page;
-	unsigned long *iface_entry = (unsigned long *) data;
+	u64 *iface_entry = (u64 *) data;
 	if (!data)
 		return 0;
 
-	value = (unsigned long) (*iface_entry);
-	p += sprintf(p, "%lu\n", value);
+	do {
+		seq = read_seqbegin(&iface_seq);
+		value = *iface_entry;
+	} while (read_seqretry(&iface_seq, seq));
+	p += sprintf(p, "%llu\n", value);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
 	*start = page + off;
@@ -63,11 +103,11 @@ static int read_proc_bool_entry(char *page, char **start, off_t off,
 	int len;
 	bool value;
 	char *p = page;
-	unsigned long *iface_entry = (unsigned long *) data;
+	bool *iface_entry = (bool *) data;
 	if (!data)
 		return 0;
 
-	value = (bool) (*iface_entry);
+	value = *iface_entry;
 	p += sprintf(p, "%u\n", value ? 1 : 0);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
@@ -75,6 +115,28 @@ static int read_proc_bool_entry(char *page, char **start, off_t off,
 	return len;
 }
 
+static int read_proc_active_time(char *page, char **start, off_t off,
+		int count, int *eof, void *data)
+{
+	int len;
+	u64 value;
+	unsigned seq;
+	char *p = page;
+	struct iface_stat *iface_entry = (struct iface_stat *) data;
+	if (!data)
+		return 0;
+
+	do {
+		seq = read_seqbegin(&iface_seq);
+		value = iface_active_ms(iface_entry);
+	} while (read_seqretry(&iface_seq, seq));
+	p += sprintf(p, "%llu\n", value);
+	len = (p - page) - off;
+	*eof = (len <= count) ? 1 : 0;
+	*start = page + off;
+	return len;
+}
+
 /* Find the entry for tracking the specified interface. */
 static struct iface_stat *get_iface_stat(const char *ifname)
 {
@@ -127,12 +189,14 @@ void create_iface_stat(const struct in_device *in_dev)
 	entry = get_iface_stat(dev->name);
 	if (entry != NULL) {
 		pr_debug("iface_stat: Already monitoring device %s\n", ifname);
+		write_seqlock_bh(&iface_seq);
+		entry->ifindex = dev->ifindex;
+		iface_set_active(entry, !ipv4_is_loopback(ipaddr));
+		write_sequnlock_bh(&iface_seq);
 		if (ipv4_is_loopback(ipaddr)) {
-			entry->active = false;
 			pr_debug("iface_stat: Disabling monitor for "
 					"loopback device %s\n", ifname);
 		} else {
-			entry->active = true;
 			pr_debug("iface_stat: Re-enabling monitor for "
 					"device %s with ip %pI4\n",
 					ifname, &ipaddr);
@@ -158,15 +222,17 @@ void create_iface_stat(const struct in_device *in_dev)
 	}
 
 	strcpy(new_iface->iface_name, ifname);
-	/* Counters start at 0, so we can track 4GB of network traffic. */
+	new_iface->ifindex = dev->ifindex;
 	new_iface->tx_bytes = 0;
 	new_iface->rx_bytes = 0;
 	new_iface->rx_packets = 0;
 	new_iface->tx_packets = 0;
+	new_iface->active_jiffies = 0;
+	new_iface->active_since = jiffies;
 	new_iface->active = true;
 
 	/* Append the newly created iface stat struct to the list. */
-	list_add_tail(&new_iface->if_link, &iface_list);
+	list_add_tail_rcu(&new_iface->if_link, &iface_list);
 	proc_entry = proc_mkdir(ifname, iface_stat_procdir);
 
 	/* Keep reference to iface_stat so we know where to read stats from. */
@@ -185,6 +251,9 @@ void create_iface_stat(const struct in_device *in_dev)
 	create_proc_read_entry("active", S_IRUGO, proc_entry,
 			read_proc_bool_entry, &new_iface->active);
 
+	create_proc_read_entry("active_time_ms", S_IRUGO, proc_entry,
+			read_proc_active_time, new_iface);
+
 	pr_debug("iface_stat: Now monitoring device %s with ip %pI4\n",
 			ifname, &ipaddr);
 }
@@ -207,12 +276,14 @@ void iface_stat_update(struct net_device *dev)
 		return;
 	}
 
-	if (entry->active) { /* FIXME: Support for more than 4GB */
+	if (entry->active) {
+		write_seqlock_bh(&iface_seq);
 		entry->tx_bytes += stats->tx_bytes;
 		entry->tx_packets += stats->tx_packets;
 		entry->rx_bytes += stats->rx_bytes;
 		entry->rx_packets += stats->rx_packets;
-		entry->active = false;
+		iface_set_active(entry, false);
+		write_sequnlock_bh(&iface_seq);
 		pr_debug("iface_stat: Updating stats for "
 			       "dev %s which went down\n", dev->name);
 	} else
@@ -220,6 +291,92 @@ void iface_stat_update(struct net_device *dev)
 				"dev %s which went down\n", dev->name);
 }
 
+/*
+ * /proc/iface_stat_all: every monitored interface in one read.  Besides
+ * the totals saved when the device went away, the counters of the live
+ * device are reported for active entries, so a reader gets the complete
+ * picture without touching sysfs once per interface.
+ */
+static void *iface_stat_seq_start(struct seq_file *m, loff_t *pos)
+{
+	rcu_read_lock();
+	return seq_list_start_head(&iface_list, *pos);
+}
+
+static void *iface_stat_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &iface_list, pos);
+}
+
+static void iface_stat_seq_stop(struct seq_file *m, void *v)
+{
+	rcu_read_unlock();
+}
+
+static int iface_stat_seq_show(struct seq_file *m, void *v)
+{
+	struct iface_stat *entry;
+	struct iface_stat snap;
+	const struct net_device_stats *stats;
+	struct net_device *dev;
+	u64 live[4] = { 0, 0, 0, 0 };
+	u64 active_ms;
+	unsigned seq;
+
+	if (v == &iface_list) {
+		seq_puts(m, "iface ifindex active active_time_ms"
+			" rx_bytes rx_packets tx_bytes tx_packets"
+			" live_rx_bytes live_rx_packets"
+			" live_tx_bytes live_tx_packets\n");
+		return 0;
+	}
+
+	entry = list_entry(v, struct iface_stat, if_link);
+	do {
+		seq = read_seqbegin(&iface_seq);
+		snap = *entry;
+		active_ms = iface_active_ms(entry);
+	} while (read_seqretry(&iface_seq, seq));
+
+	if (snap.active) {
+		dev = dev_get_by_index_rcu(&init_net, snap.ifindex);
+		if (dev && !strcmp(dev->name, snap.iface_name)) {
+			stats = dev_get_stats(dev);
+			live[0] = stats->rx_bytes;
+			live[1] = stats->rx_packets;
+			live[2] = stats->tx_bytes;
+			live[3] = stats->tx_packets;
+		}
+	}
+
+	seq_printf(m, "%s %d %u %llu %llu %llu %llu %llu"
+			" %llu %llu %llu %llu\n",
+			snap.iface_name, snap.ifindex, snap.active ? 1 : 0,
+			active_ms, snap.rx_bytes, snap.rx_packets,
+			snap.tx_bytes, snap.tx_packets,
+			live[0], live[1], live[2], live[3]);
+	return 0;
+}
+
+static const struct seq_operations iface_stat_seq_ops = {
+	.start	= iface_stat_seq_start,
+	.next	= iface_stat_seq_next,
+	.stop	= iface_stat_seq_stop,
+	.show	= iface_stat_seq_show,
+};
+
+static int iface_stat_all_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &iface_stat_seq_ops);
+}
+
+static const struct file_operations iface_stat_all_fops = {
+	.open		= iface_stat_all_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 static int __init iface_stat_init(void)
 {
 	iface_stat_procdir = proc_mkdir("iface_stat", NULL);
@@ -228,6 +385,10 @@ static int __init iface_stat_init(void)
 		return -1;
 	}
 
+	if (!proc_create("iface_stat_all", S_IRUGO, NULL,
+				&iface_stat_all_fops))
+		pr_err("iface_stat: failed to create iface_stat_all\n");
+
 	return 0;
 }
 
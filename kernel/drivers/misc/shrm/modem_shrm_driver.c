@@ -225,6 +225,12 @@ static int audio_receive(struct shrm_dev *shrm, void *data,
 	audiodev = &shrm->isa_context->isadev[idx];
 	q = &audiodev->dl_queue;
 	spin_lock(&q->update_lock);
+	ret = check_space_in_queue(q, n_bytes);
+	if (ret < 0) {
+		/* the queue is full, the message is dropped */
+		spin_unlock(&q->update_lock);
+		return ret;
+	}
 	/* Memcopy RX data first */
 	if ((q->writeptr+n_bytes) >= q->size) {
 		psrc = (u8 *)data;
@@ -275,6 +281,12 @@ static int common_receive(struct shrm_dev *shrm, void *data,
 	isa_dev = &shrm->isa_context->isadev[idx];
 	q = &isa_dev->dl_queue;
 	spin_lock(&q->update_lock);
+	ret = check_space_in_queue(q, n_bytes);
+	if (ret < 0) {
+		/* the queue is full, the message is dropped */
+		spin_unlock(&q->update_lock);
+		return ret;
+	}
 	/* Memcopy RX data first */
 	if ((q->writeptr+n_bytes) >= q->size) {
 		dev_dbg(shrm->dev, "Inside Loop Back\n");
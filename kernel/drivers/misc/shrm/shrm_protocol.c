@@ -9,7 +9,9 @@
 
 #include <linux/hrtimer.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
 #include <linux/netlink.h>
+#include <linux/seq_file.h>
 #include <linux/workqueue.h>
 
 #include <mach/shrm.h>
@@ -64,6 +66,42 @@ static atomic_t mod_stuck = ATOMIC_INIT(0);
 static atomic_t fifo_full = ATOMIC_INIT(0);
 static struct shrm_dev *shm_dev;
 
+/**
+ * struct shrm_chan_stats - per channel FIFO statistics
+ * @tx_msgs:		messages written to the APE->CMT FIFO
+ * @tx_bytes:		payload bytes written to the APE->CMT FIFO
+ * @tx_full:		writes refused because the FIFO was full
+ * @tx_notify:		AcMsgPending notifications raised to the CMT
+ * @tx_acks:		AcReadNotifications received from the CMT
+ * @tx_lat_total:	sum of AcMsgPending to AcReadNotification times (ns)
+ * @tx_lat_max:		worst AcMsgPending to AcReadNotification time (ns)
+ * @tx_notify_time:	when the last AcMsgPending notification was raised
+ * @rx_msgs:		messages read from the CMT->APE FIFO
+ * @rx_bytes:		payload bytes read from the CMT->APE FIFO
+ * @rx_batches:		CaMsgPending interrupts which found messages
+ * @rx_max_batch:	most messages drained on a single interrupt
+ * @lock:		protects the counters, they are updated from the
+ *			writers, the channel workqueue and the tasklets
+ */
+struct shrm_chan_stats {
+	u32 tx_msgs;
+	u64 tx_bytes;
+	u32 tx_full;
+	u32 tx_notify;
+	u32 tx_acks;
+	u64 tx_lat_total;
+	u64 tx_lat_max;
+	ktime_t tx_notify_time;
+	u32 rx_msgs;
+	u64 rx_bytes;
+	u32 rx_batches;
+	u32 rx_max_batch;
+	spinlock_t lock;
+};
+
+static struct shrm_chan_stats shrm_stats[2];
+static struct dentry *shrm_debugfs_dir;
+
 /* Spin lock and tasklet declaration */
 DECLARE_TASKLET(shm_ca_0_tasklet, shm_ca_msgpending_0_tasklet, 0);
 DECLARE_TASKLET(shm_ca_1_tasklet, shm_ca_msgpending_1_tasklet, 0);
@@ -303,6 +341,34 @@ static int check_modem_in_reset(void)
 #endif
 }
 
+static void shrm_account_notify(struct shrm_chan_stats *st)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->tx_notify++;
+	st->tx_notify_time = ktime_get();
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
+static void shrm_account_ack(struct shrm_chan_stats *st)
+{
+	unsigned long flags;
+	s64 delta;
+
+	spin_lock_irqsave(&st->lock, flags);
+	if (st->tx_notify_time.tv64) {
+		delta = ktime_to_ns(ktime_sub(ktime_get(),
+					st->tx_notify_time));
+		st->tx_notify_time.tv64 = 0;
+		st->tx_acks++;
+		st->tx_lat_total += delta;
+		if (delta > st->tx_lat_max)
+			st->tx_lat_max = delta;
+	}
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
 void shm_ca_msgpending_0_tasklet(unsigned long tasklet_data)
 {
 	struct shrm_dev *shrm = (struct shrm_dev *)tasklet_data;
@@ -327,10 +393,14 @@ void shm_ca_msgpending_0_tasklet(unsigned long tasklet_data)
 	if (boot_state == BOOT_DONE) {
 		shrm_common_rx_state = SHRM_PTR_FREE;
 
-		if (reader_local_rptr != shared_rptr)
-			ca_msg_read_notification_0(shrm);
+		/*
+		 * receive_messages_common() acks everything it drained, only
+		 * send a stand-alone read notification if nothing is pending.
+		 */
 		if (reader_local_rptr != reader_local_wptr)
 			receive_messages_common(shrm);
+		else if (reader_local_rptr != shared_rptr)
+			ca_msg_read_notification_0(shrm);
 		get_reader_pointers(COMMON_CHANNEL, &reader_local_rptr,
 				&reader_local_wptr, &shared_rptr);
 		if (reader_local_rptr == reader_local_wptr)
@@ -405,10 +475,10 @@ void shm_ca_msgpending_1_tasklet(unsigned long tasklet_data)
 	}
 	shrm_audio_rx_state = SHRM_PTR_FREE;
 	/* Check we already read the message */
-	if (reader_local_rptr != shared_rptr)
-		ca_msg_read_notification_1(shrm);
 	if (reader_local_rptr != reader_local_wptr)
 		receive_messages_audio(shrm);
+	else if (reader_local_rptr != shared_rptr)
+		ca_msg_read_notification_1(shrm);
 
 	get_reader_pointers(AUDIO_CHANNEL, &reader_local_rptr,
 			&reader_local_wptr, &shared_rptr);
@@ -463,6 +533,7 @@ void shm_ac_read_notif_0_tasklet(unsigned long tasklet_data)
 		}
 
 	} else if (boot_state == BOOT_DONE) {
+		shrm_account_ack(&shrm_stats[COMMON_CHANNEL]);
 		if (writer_local_rptr != writer_local_wptr) {
 			shrm_common_tx_state = SHRM_PTR_FREE;
 			queue_work(shrm->shm_common_ch_wr_wq,
@@ -507,6 +578,7 @@ void shm_ac_read_notif_1_tasklet(unsigned long tasklet_data)
 		dev_err(shrm->dev, "Error Case in boot state\n");
 		return;
 	}
+	shrm_account_ack(&shrm_stats[AUDIO_CHANNEL]);
 	if (writer_local_rptr != writer_local_wptr) {
 		shrm_audio_tx_state = SHRM_PTR_FREE;
 		queue_work(shrm->shm_audio_ch_wr_wq,
@@ -790,6 +862,7 @@ static void send_ac_msg_pend_notify_0_work(struct work_struct *work)
 	log_this(251, NULL, 0, NULL, 0);
 	writel((1<<GOP_COMMON_AC_MSG_PENDING_NOTIFICATION_BIT),
 			shrm->intr_base + GOP_SET_REGISTER_BASE);
+	shrm_account_notify(&shrm_stats[COMMON_CHANNEL]);
 
 	/* timer to detect modem stuck or hang */
 	hrtimer_start(&mod_stuck_timer_0, ktime_set(MOD_STUCK_TIMEOUT, 0),
@@ -845,6 +918,7 @@ static void send_ac_msg_pend_notify_1_work(struct work_struct *work)
 	log_this(252, NULL, 0, NULL, 0);
 	writel((1<<GOP_AUDIO_AC_MSG_PENDING_NOTIFICATION_BIT),
 			shrm->intr_base + GOP_SET_REGISTER_BASE);
+	shrm_account_notify(&shrm_stats[AUDIO_CHANNEL]);
 
 	/* timer to detect modem stuck or hang */
 	hrtimer_start(&mod_stuck_timer_1, ktime_set(MOD_STUCK_TIMEOUT, 0),
@@ -890,11 +964,52 @@ void shm_nl_receive(struct sk_buff *skb)
 	};
 }
 
+static int shrm_stats_show(struct seq_file *s, void *unused)
+{
+	static const char * const names[] = { "common", "audio" };
+	struct shrm_chan_stats snap, *st = &snap;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(shrm_stats); i++) {
+		spin_lock_irqsave(&shrm_stats[i].lock, flags);
+		snap = shrm_stats[i];
+		spin_unlock_irqrestore(&shrm_stats[i].lock, flags);
+		seq_printf(s, "%s:\n", names[i]);
+		seq_printf(s, "  tx_msgs      %u\n", st->tx_msgs);
+		seq_printf(s, "  tx_bytes     %llu\n", st->tx_bytes);
+		seq_printf(s, "  tx_full      %u\n", st->tx_full);
+		seq_printf(s, "  tx_notify    %u\n", st->tx_notify);
+		seq_printf(s, "  tx_lat_avg   %llu us\n", st->tx_acks ?
+				div_u64(st->tx_lat_total, st->tx_acks) /
+				NSEC_PER_USEC : 0);
+		seq_printf(s, "  tx_lat_max   %llu us\n",
+				div_u64(st->tx_lat_max, NSEC_PER_USEC));
+		seq_printf(s, "  rx_msgs      %u\n", st->rx_msgs);
+		seq_printf(s, "  rx_bytes     %llu\n", st->rx_bytes);
+		seq_printf(s, "  rx_irqs      %u\n", st->rx_batches);
+		seq_printf(s, "  rx_max_batch %u\n", st->rx_max_batch);
+	}
+	return 0;
+}
+
+static int shrm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, shrm_stats_show, inode->i_private);
+}
+
+static const struct file_operations shrm_stats_fops = {
+	.open		= shrm_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 int shrm_protocol_init(struct shrm_dev *shrm,
 			received_msg_handler common_rx_handler,
 			received_msg_handler audio_rx_handler)
 {
-	int err;
+	int err, i;
 
 	shm_dev = shrm;
 	boot_state = BOOT_INIT;
@@ -1001,6 +1116,14 @@ int shrm_protocol_init(struct shrm_dev *shrm,
 	}
 #endif
 
+	memset(shrm_stats, 0, sizeof(shrm_stats));
+	for (i = 0; i < ARRAY_SIZE(shrm_stats); i++)
+		spin_lock_init(&shrm_stats[i].lock);
+	shrm_debugfs_dir = debugfs_create_dir("shrm", NULL);
+	if (!IS_ERR_OR_NULL(shrm_debugfs_dir))
+		debugfs_create_file("stats", S_IRUGO, shrm_debugfs_dir, NULL,
+				&shrm_stats_fops);
+
 	return 0;
 
 #ifdef CONFIG_U8500_SHRM_MODEM_SILENT_RESET
@@ -1028,6 +1151,8 @@ free_wq1:
 
 void shrm_protocol_deinit(struct shrm_dev *shrm)
 {
+	debugfs_remove_recursive(shrm_debugfs_dir);
+	shrm_debugfs_dir = NULL;
 	free_irq(IRQ_PRCMU_CA_SLEEP, NULL);
 	free_irq(IRQ_PRCMU_CA_WAKE, NULL);
 	free_irq(IRQ_PRCMU_MODEM_SW_RESET_REQ, NULL);
@@ -1280,6 +1405,7 @@ irqreturn_t ca_msg_pending_notif_1_irq_handler(int irq, void *ctrlr)
 int shm_write_msg(struct shrm_dev *shrm, u8 l2_header,
 					void *addr, u32 length)
 {
+	unsigned long flags;
 	u8 channel = 0;
 	int ret;
 
@@ -1322,6 +1448,10 @@ int shm_write_msg(struct shrm_dev *shrm, u8 l2_header,
 	if (ret < 0) {
 		dev_err(shrm->dev, "write message to fifo failed\n");
 		if (ret == -EAGAIN) {
+			spin_lock_irqsave(&shrm_stats[channel].lock, flags);
+			shrm_stats[channel].tx_full++;
+			spin_unlock_irqrestore(&shrm_stats[channel].lock,
+					flags);
 			/* Start a timer so as to handle this gently */
 			if(!atomic_read(&fifo_full)) {
 				atomic_set(&fifo_full, 1);
@@ -1332,9 +1462,16 @@ int shm_write_msg(struct shrm_dev *shrm, u8 l2_header,
 		}
 		return ret;
 	}
+	spin_lock_irqsave(&shrm_stats[channel].lock, flags);
+	shrm_stats[channel].tx_msgs++;
+	shrm_stats[channel].tx_bytes += length;
+	spin_unlock_irqrestore(&shrm_stats[channel].lock, flags);
+
 	/*
 	 * notify only if new msg copied is the only unread one
-	 * otherwise it means that reading process is ongoing
+	 * otherwise it means that reading process is ongoing.  Messages
+	 * queued while a notification is outstanding are published in one
+	 * go by the next AcMsgPending, see shm_ac_read_notif_*_tasklet().
 	 */
 	if (is_the_only_one_unread_message(shrm, channel, length)) {
 
@@ -1434,6 +1571,19 @@ void ca_msg_read_notification_1(struct shrm_dev *shrm)
 	dev_dbg(shrm->dev, "%s OUT\n", __func__);
 }
 
+static void shrm_account_rx(struct shrm_chan_stats *st, u32 batch, u32 bytes)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&st->lock, flags);
+	st->rx_msgs += batch;
+	st->rx_bytes += bytes;
+	st->rx_batches++;
+	if (batch > st->rx_max_batch)
+		st->rx_max_batch = batch;
+	spin_unlock_irqrestore(&st->lock, flags);
+}
+
 /**
  * receive_messages_common - receive common channnel msg from
  * CMT(Cellular Mobile Terminal)
@@ -1441,34 +1591,27 @@ void ca_msg_read_notification_1(struct shrm_dev *shrm)
  *
  * The messages sent from CMT to APE are written to the respective FIFO
  * and an interrupt is triggered by the CMT. This ca message pending
- * interrupt calls this function. This function sends a read notification
- * acknowledgement to the CMT and calls the common channel receive handler
- * where the messsage is copied to the respective(ISI, RPC, SECURIT) queue
- * based on the message l2 header.
+ * interrupt calls this function. This function drains the FIFO, calling
+ * the common channel receive handler where each messsage is copied to the
+ * respective(ISI, RPC, SECURIT) queue based on the message l2 header, and
+ * then sends a single read notification acknowledgement for the whole
+ * batch to the CMT. The CMT only raises a new ca message pending interrupt
+ * once it has seen the read notification, so the busier the channel the
+ * more messages get handled per interrupt.
  */
 void receive_messages_common(struct shrm_dev *shrm)
 {
+	struct shrm_chan_stats *st = &shrm_stats[COMMON_CHANNEL];
+	u32 batch = 0, bytes = 0;
 	u8 l2_header;
 	u32 len;
 
-	if (check_modem_in_reset()) {
-		dev_err(shrm->dev, "%s:Modem state reset or unknown.\n",
-				__func__);
-		return;
-	}
-
-	l2_header = read_one_l2msg_common(shrm, recieve_common_msg, &len);
-	/* Send Recieve_Call_back to Upper Layer */
 	if (!rx_common_handler) {
 		dev_err(shrm->dev, "common_rx_handler is Null\n");
 		BUG();
 	}
-	(*rx_common_handler)(l2_header, &recieve_common_msg, len,
-					shrm);
-	/* SendReadNotification */
-	ca_msg_read_notification_0(shrm);
 
-	while (read_remaining_messages_common()) {
+	do {
 		if (check_modem_in_reset()) {
 			dev_err(shrm->dev, "%s:Modem state reset or unknown.\n",
 					__func__);
@@ -1477,11 +1620,17 @@ void receive_messages_common(struct shrm_dev *shrm)
 
 		l2_header = read_one_l2msg_common(shrm, recieve_common_msg,
 								&len);
+		bytes += len;
+		batch++;
 		/* Send Recieve_Call_back to Upper Layer */
 		(*rx_common_handler)(l2_header,
 					&recieve_common_msg, len,
 					shrm);
-	}
+	} while (read_remaining_messages_common());
+
+	shrm_account_rx(st, batch, bytes);
+	/* SendReadNotification */
+	ca_msg_read_notification_0(shrm);
 }
 
 /**
@@ -1490,34 +1639,23 @@ void receive_messages_common(struct shrm_dev *shrm)
  *
  * The messages sent from CMT to APE are written to the respective FIFO
  * and an interrupt is triggered by the CMT. This ca message pending
- * interrupt calls this function. This function sends a read notification
- * acknowledgement to the CMT and calls the common channel receive handler
- * where the messsage is copied to the audio queue.
+ * interrupt calls this function. This function drains the FIFO into the
+ * audio queue through the audio channel receive handler and then sends a
+ * single read notification acknowledgement for the batch to the CMT.
  */
 void receive_messages_audio(struct shrm_dev *shrm)
 {
+	struct shrm_chan_stats *st = &shrm_stats[AUDIO_CHANNEL];
+	u32 batch = 0, bytes = 0;
 	u8 l2_header;
 	u32 len;
 
-	if (check_modem_in_reset()) {
-		dev_err(shrm->dev, "%s:Modem state reset or unknown.\n",
-				__func__);
-		return;
-	}
-
-	l2_header = read_one_l2msg_audio(shrm, recieve_audio_msg, &len);
-	/* Send Recieve_Call_back to Upper Layer */
-
 	if (!rx_audio_handler) {
 		dev_crit(shrm->dev, "audio_rx_handler is Null\n");
 		BUG();
 	}
-	(*rx_audio_handler)(l2_header, &recieve_audio_msg,
-					len, shrm);
 
-	/* SendReadNotification */
-	ca_msg_read_notification_1(shrm);
-	while (read_remaining_messages_audio())	{
+	do {
 		if (check_modem_in_reset()) {
 			dev_err(shrm->dev, "%s:Modem state reset or unknown.\n",
 					__func__);
@@ -1526,11 +1664,17 @@ void receive_messages_audio(struct shrm_dev *shrm)
 
 		l2_header = read_one_l2msg_audio(shrm,
 						recieve_audio_msg, &len);
+		bytes += len;
+		batch++;
 		/* Send Recieve_Call_back to Upper Layer */
 		(*rx_audio_handler)(l2_header,
 					&recieve_audio_msg, len,
 					shrm);
-	}
+	} while (read_remaining_messages_audio());
+
+	shrm_account_rx(st, batch, bytes);
+	/* SendReadNotification */
+	ca_msg_read_notification_1(shrm);
 }
 
 u8 get_boot_state()
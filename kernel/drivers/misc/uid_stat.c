@@ -13,54 +13,139 @@
  *
  */
 
-#include <asm/atomic.h>
-
 #include <linux/err.h>
+#include <linux/hash.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
 #include <linux/list.h>
+#include <linux/percpu.h>
 #include <linux/proc_fs.h>
+#include <linux/rculist.h>
+#include <linux/seq_file.h>
+#include <linux/seqlock.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/stat.h>
 #include <linux/uid_stat.h>
 #include <net/activity_stats.h>
 
+#define UID_HASH_BITS	6
+
+/*
+ * Entries are never freed, so lookups walk the hash chains under RCU
+ * only; uid_lock just serializes insertions.  Counters are per-cpu and
+ * are summed up when read.
+ */
 static DEFINE_SPINLOCK(uid_lock);
 static LIST_HEAD(uid_list);
+static struct hlist_head uid_hash[1 << UID_HASH_BITS];
 static struct proc_dir_entry *parent;
 
+struct uid_stat_cpu {
+	seqcount_t seq;
+	u64 val[UID_STAT_NR];
+};
+
 struct uid_stat {
 	struct list_head link;
+	struct hlist_node hnode;
 	uid_t uid;
-	atomic_t tcp_rcv;
-	atomic_t tcp_snd;
-	atomic_t tcp_rcv_pkt;
-	atomic_t tcp_snd_pkt;
-	atomic_t udp_rcv;
-	atomic_t udp_snd;
-	atomic_t udp_rcv_pkt;
-	atomic_t udp_snd_pkt;
+	struct uid_stat_cpu __percpu *cpu;
 };
 
-static int read_proc_entry(char *page, char **start, off_t off,
-			int count, int *eof, void *data)
+static const char *uid_stat_names[UID_STAT_NR] = {
+	[UID_STAT_TCP_RCV]	= "tcp_rcv",
+	[UID_STAT_TCP_SND]	= "tcp_snd",
+	[UID_STAT_TCP_RCV_PKT]	= "tcp_rcv_pkt",
+	[UID_STAT_TCP_SND_PKT]	= "tcp_snd_pkt",
+	[UID_STAT_UDP_RCV]	= "udp_rcv",
+	[UID_STAT_UDP_SND]	= "udp_snd",
+	[UID_STAT_UDP_RCV_PKT]	= "udp_rcv_pkt",
+	[UID_STAT_UDP_SND_PKT]	= "udp_snd_pkt",
+};
+
+/* Fold the per-cpu counters of an entry into val. */
+static void uid_stat_sum(struct uid_stat *entry, u64 *val)
+{
+	struct uid_stat_cpu *c;
+	u64 tmp[UID_STAT_NR];
+	unsigned int seq;
+	int cpu, i;
+
+	memset(val, 0, sizeof(u64) * UID_STAT_NR);
+	for_each_possible_cpu(cpu) {
+		c = per_cpu_ptr(entry->cpu, cpu);
+		do {
+			seq = read_seqcount_begin(&c->seq);
+			memcpy(tmp, c->val, sizeof(tmp));
+		} while (read_seqcount_retry(&c->seq, seq));
+		for (i = 0; i < UID_STAT_NR; i++)
+			val[i] += tmp[i];
+	}
+}
+
+/*
+ * The proc entries of a uid all point at the same uid_stat; each one
+ * gets its own reader so it knows which counter to report.
+ */
+static int read_proc_value(char *page, char **start, off_t off,
+			int count, int *eof, void *data, int idx)
 {
 	int len;
-	unsigned int value;
+	u64 val[UID_STAT_NR];
 	char *p = page;
-	atomic_t *uid_entry = (atomic_t *) data;
+	struct uid_stat *uid_entry = (struct uid_stat *) data;
 	if (!data)
 		return 0;
 
-	value = (unsigned int) (atomic_read(uid_entry) + INT_MIN);
-	p += sprintf(p, "%u\n", value);
+	uid_stat_sum(uid_entry, val);
+	p += sprintf(p, "%llu\n", val[idx]);
 	len = (p - page) - off;
 	*eof = (len <= count) ? 1 : 0;
 	*start = page + off;
 	return len;
 }
 
+#define UID_STAT_READ_PROC(idx)						\
+static int read_proc_##idx(char *page, char **start, off_t off,	\
+			int count, int *eof, void *data)		\
+{									\
+	return read_proc_value(page, start, off, count, eof, data, idx);\
+}
+
+UID_STAT_READ_PROC(UID_STAT_TCP_RCV)
+UID_STAT_READ_PROC(UID_STAT_TCP_SND)
+UID_STAT_READ_PROC(UID_STAT_TCP_RCV_PKT)
+UID_STAT_READ_PROC(UID_STAT_TCP_SND_PKT)
+UID_STAT_READ_PROC(UID_STAT_UDP_RCV)
+UID_STAT_READ_PROC(UID_STAT_UDP_SND)
+UID_STAT_READ_PROC(UID_STAT_UDP_RCV_PKT)
+UID_STAT_READ_PROC(UID_STAT_UDP_SND_PKT)
+
+static read_proc_t *uid_stat_readers[UID_STAT_NR] = {
+	[UID_STAT_TCP_RCV]	= read_proc_UID_STAT_TCP_RCV,
+	[UID_STAT_TCP_SND]	= read_proc_UID_STAT_TCP_SND,
+	[UID_STAT_TCP_RCV_PKT]	= read_proc_UID_STAT_TCP_RCV_PKT,
+	[UID_STAT_TCP_SND_PKT]	= read_proc_UID_STAT_TCP_SND_PKT,
+	[UID_STAT_UDP_RCV]	= read_proc_UID_STAT_UDP_RCV,
+	[UID_STAT_UDP_SND]	= read_proc_UID_STAT_UDP_SND,
+	[UID_STAT_UDP_RCV_PKT]	= read_proc_UID_STAT_UDP_RCV_PKT,
+	[UID_STAT_UDP_SND_PKT]	= read_proc_UID_STAT_UDP_SND_PKT,
+};
+
+static struct uid_stat *find_uid_stat(uid_t uid)
+{
+	struct uid_stat *uid_entry;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(uid_entry, node,
+			&uid_hash[hash_long(uid, UID_HASH_BITS)], hnode) {
+		if (uid_entry->uid == uid)
+			return uid_entry;
+	}
+	return NULL;
+}
+
 /* Find or create a new entry for tracking the specified uid. */
 static struct uid_stat *get_uid_stat(uid_t uid) {
 	unsigned long flags;
@@ -68,111 +153,143 @@ static struct uid_stat *get_uid_stat(uid_t uid) {
 	struct uid_stat *new_uid;
 	struct proc_dir_entry *proc_entry;
 	char uid_s[32];
+	int i;
 
-	spin_lock_irqsave(&uid_lock, flags);
-	list_for_each_entry(uid_entry, &uid_list, link) {
-		if (uid_entry->uid == uid) {
-			spin_unlock_irqrestore(&uid_lock, flags);
-			return uid_entry;
-		}
-	}
-	spin_unlock_irqrestore(&uid_lock, flags);
+	rcu_read_lock();
+	uid_entry = find_uid_stat(uid);
+	rcu_read_unlock();
+	if (uid_entry)
+		return uid_entry;
 
 	/* Create a new entry for tracking the specified uid. */
 	if ((new_uid = kmalloc(sizeof(struct uid_stat), GFP_KERNEL)) == NULL)
 		return NULL;
 
 	new_uid->uid = uid;
-	/* Counters start at INT_MIN, so we can track 4GB of network traffic. */
-	atomic_set(&new_uid->tcp_rcv, INT_MIN);
-	atomic_set(&new_uid->tcp_snd, INT_MIN);
-	atomic_set(&new_uid->tcp_snd_pkt, INT_MIN);
-	atomic_set(&new_uid->tcp_rcv_pkt, INT_MIN);
-	atomic_set(&new_uid->udp_rcv, INT_MIN);
-	atomic_set(&new_uid->udp_snd, INT_MIN);
-	atomic_set(&new_uid->udp_snd_pkt, INT_MIN);
-	atomic_set(&new_uid->udp_rcv_pkt, INT_MIN);
+	/* alloc_percpu() hands back zeroed memory. */
+	new_uid->cpu = alloc_percpu(struct uid_stat_cpu);
+	if (!new_uid->cpu) {
+		kfree(new_uid);
+		return NULL;
+	}
+	for_each_possible_cpu(i)
+		seqcount_init(&per_cpu_ptr(new_uid->cpu, i)->seq);
 
-	/* Append the newly created uid stat struct to the list. */
+	/* Another task may have raced us to it. */
 	spin_lock_irqsave(&uid_lock, flags);
-	list_add_tail(&new_uid->link, &uid_list);
+	uid_entry = find_uid_stat(uid);
+	if (uid_entry) {
+		spin_unlock_irqrestore(&uid_lock, flags);
+		free_percpu(new_uid->cpu);
+		kfree(new_uid);
+		return uid_entry;
+	}
+	/* Append the newly created uid stat struct to the list. */
+	list_add_tail_rcu(&new_uid->link, &uid_list);
+	hlist_add_head_rcu(&new_uid->hnode,
+			&uid_hash[hash_long(uid, UID_HASH_BITS)]);
 	spin_unlock_irqrestore(&uid_lock, flags);
 
 	sprintf(uid_s, "%d", uid);
 	proc_entry = proc_mkdir(uid_s, parent);
 
 	/* Keep reference to uid_stat so we know what uid to read stats from. */
-	create_proc_read_entry("tcp_snd", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->tcp_snd);
-
-	create_proc_read_entry("tcp_rcv", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->tcp_rcv);
-
-	create_proc_read_entry("tcp_snd_pkt", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->tcp_snd_pkt);
-
-	create_proc_read_entry("tcp_rcv_pkt", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->tcp_rcv_pkt);
-
-	create_proc_read_entry("udp_snd", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->udp_snd);
-
-	create_proc_read_entry("udp_rcv", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->udp_rcv);
-
-	create_proc_read_entry("udp_snd_pkt", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->udp_snd_pkt);
-
-	create_proc_read_entry("udp_rcv_pkt", S_IRUGO, proc_entry, read_proc_entry,
-			(void *) &new_uid->udp_rcv_pkt);
+	for (i = 0; i < UID_STAT_NR; i++)
+		create_proc_read_entry(uid_stat_names[i], S_IRUGO, proc_entry,
+				uid_stat_readers[i], (void *) new_uid);
 
 	return new_uid;
 }
 
-int uid_stat_tcp_snd(uid_t uid, int size) {
+static int uid_stat_add(uid_t uid, int bytes, int pkts, int size)
+{
 	struct uid_stat *entry;
+	struct uid_stat_cpu *c;
+	unsigned long flags;
+
 	activity_stats_update();
 	if ((entry = get_uid_stat(uid)) == NULL) {
 		return -1;
 	}
-	atomic_add(size, &entry->tcp_snd);
-	atomic_inc(&entry->tcp_snd_pkt);
+
+	/* softirq readers of sockets may interrupt us on this cpu */
+	local_irq_save(flags);
+	c = per_cpu_ptr(entry->cpu, smp_processor_id());
+	write_seqcount_begin(&c->seq);
+	c->val[bytes] += size;
+	c->val[pkts]++;
+	write_seqcount_end(&c->seq);
+	local_irq_restore(flags);
 	return 0;
 }
 
+int uid_stat_tcp_snd(uid_t uid, int size) {
+	return uid_stat_add(uid, UID_STAT_TCP_SND, UID_STAT_TCP_SND_PKT, size);
+}
+
 int uid_stat_tcp_rcv(uid_t uid, int size) {
-	struct uid_stat *entry;
-	activity_stats_update();
-	if ((entry = get_uid_stat(uid)) == NULL) {
-		return -1;
-	}
-	atomic_add(size, &entry->tcp_rcv);
-	atomic_inc(&entry->tcp_rcv_pkt);
-	return 0;
+	return uid_stat_add(uid, UID_STAT_TCP_RCV, UID_STAT_TCP_RCV_PKT, size);
 }
 
 int uid_stat_udp_snd(uid_t uid, int size) {
-	struct uid_stat *entry;
-	activity_stats_update();
-	if ((entry = get_uid_stat(uid)) == NULL) {
-		return -1;
-	}
-	atomic_add(size, &entry->udp_snd);
-	atomic_inc(&entry->udp_snd_pkt);
-	return 0;
+	return uid_stat_add(uid, UID_STAT_UDP_SND, UID_STAT_UDP_SND_PKT, size);
 }
 
 int uid_stat_udp_rcv(uid_t uid, int size) {
-	struct uid_stat *entry;
-	activity_stats_update();
-	if ((entry = get_uid_stat(uid)) == NULL) {
-		return -1;
-	}
-	atomic_add(size, &entry->udp_rcv);
-	atomic_inc(&entry->udp_rcv_pkt);
+	return uid_stat_add(uid, UID_STAT_UDP_RCV, UID_STAT_UDP_RCV_PKT, size);
+}
+
+/*
+ * /proc/uid_stat_all: one struct uid_stat_record per uid, so that all
+ * uids can be sampled with a single read.
+ */
+static void *uid_stat_seq_start(struct seq_file *m, loff_t *pos)
+{
+	rcu_read_lock();
+	return seq_list_start(&uid_list, *pos);
+}
+
+static void *uid_stat_seq_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	return seq_list_next(v, &uid_list, pos);
+}
+
+static void uid_stat_seq_stop(struct seq_file *m, void *v)
+{
+	rcu_read_unlock();
+}
+
+static int uid_stat_seq_show(struct seq_file *m, void *v)
+{
+	struct uid_stat *entry = list_entry(v, struct uid_stat, link);
+	struct uid_stat_record rec;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.uid = entry->uid;
+	uid_stat_sum(entry, rec.val);
+	seq_write(m, &rec, sizeof(rec));
 	return 0;
 }
 
+static const struct seq_operations uid_stat_seq_ops = {
+	.start	= uid_stat_seq_start,
+	.next	= uid_stat_seq_next,
+	.stop	= uid_stat_seq_stop,
+	.show	= uid_stat_seq_show,
+};
+
+static int uid_stat_all_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &uid_stat_seq_ops);
+}
+
+static const struct file_operations uid_stat_all_fops = {
+	.open		= uid_stat_all_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 static int __init uid_stat_init(void)
 {
 	parent = proc_mkdir("uid_stat", NULL);
@@ -180,6 +297,8 @@ static int __init uid_stat_init(void)
 		pr_err("uid_stat: failed to create proc entry\n");
 		return -1;
 	}
+	if (!proc_create("uid_stat_all", S_IRUGO, NULL, &uid_stat_all_fops))
+		pr_err("uid_stat: failed to create uid_stat_all\n");
 	return 0;
 }
 
@@ -31,6 +31,8 @@
 #include <linux/mutex.h>
 #include <linux/scatterlist.h>
 #include <linux/string_helpers.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -96,6 +98,9 @@ struct mmc_blk_data {
 
 	unsigned int	usage;
 	unsigned int	read_only;
+#ifdef CONFIG_DEBUG_FS
+	struct dentry	*debugfs_root;
+#endif
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -103,6 +108,16 @@ static DEFINE_MUTEX(open_lock);
 module_param(perdev_minors, int, 0444);
 MODULE_PARM_DESC(perdev_minors, "Minors numbers to allocate per device");
 
+/*
+ * Contiguous writes queued behind each other are sent to the card in one
+ * multi-block transfer, as one large request is much cheaper for the
+ * card's flash translation layer than several small ones.
+ */
+static unsigned int packed_writes = 8;
+
+module_param(packed_writes, uint, 0444);
+MODULE_PARM_DESC(packed_writes, "Writes sent in one transfer, 1 to disable");
+
 static struct mmc_blk_data *mmc_blk_get(struct gendisk *disk)
 {
 	struct mmc_blk_data *md;
@@ -182,13 +197,6 @@ static const struct block_device_operations mmc_bdops = {
 	.owner			= THIS_MODULE,
 };
 
-struct mmc_blk_request {
-	struct mmc_request	mrq;
-	struct mmc_command	cmd;
-	struct mmc_command	stop;
-	struct mmc_data		data;
-};
-
 static u32 mmc_sd_num_wr_blocks(struct mmc_card *card)
 {
 	int err;
@@ -327,130 +335,161 @@ mmc_blk_set_blksize(struct mmc_blk_data *md, struct mmc_card *card)
 	return 0;
 }
 
-static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+static int mmc_blk_err_check(struct mmc_card *card,
+			     struct mmc_async_req *areq)
 {
-	struct mmc_blk_data *md = mq->data;
-	struct mmc_card *card = md->queue.card;
-	struct mmc_blk_request brq;
-	int ret = 1, disable_multi = 0;
+	struct mmc_queue_req *mq_mrq = container_of(areq, struct mmc_queue_req,
+						    mmc_active);
+	struct mmc_blk_request *brq = &mq_mrq->brq;
+	struct request *req = mq_mrq->req;
 
-#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
-	if (mmc_bus_needs_resume(card->host)) {
-		mmc_resume_bus(card->host);
-		mmc_blk_set_blksize(md, card);
-	}
-#endif
+	/*
+	 * Anything but a complete, error free transfer is left to
+	 * mmc_blk_issue_rw_sync(), which knows how to retry it.
+	 */
+	if (brq->cmd.error || brq->data.error || brq->stop.error)
+		return 1;
+	if (brq->data.bytes_xfered != mmc_queue_req_sectors(mq_mrq) << 9)
+		return 1;
 
-	mmc_claim_host(card->host);
+	/* The card must be out of programming state before the next one */
+	if (wait_for_ready_state(card, req))
+		return 1;
 
-	do {
-		struct mmc_command cmd;
-		u32 readcmd, writecmd, status = 0;
-
-		memset(&brq, 0, sizeof(struct mmc_blk_request));
-		brq.mrq.cmd = &brq.cmd;
-		brq.mrq.data = &brq.data;
-
-		brq.cmd.arg = blk_rq_pos(req);
-		if (!mmc_card_blockaddr(card))
-			brq.cmd.arg <<= 9;
-		brq.cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
-		brq.data.blksz = 512;
-		brq.stop.opcode = MMC_STOP_TRANSMISSION;
-		brq.stop.arg = 0;
-		brq.stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
-		brq.data.blocks = blk_rq_sectors(req);
+	return 0;
+}
 
-		/*
-		 * The block layer doesn't support all sector count
-		 * restrictions, so we need to be prepared for too big
-		 * requests.
-		 */
-		if (brq.data.blocks > card->host->max_blk_count)
-			brq.data.blocks = card->host->max_blk_count;
+static void mmc_blk_rw_rq_prep(struct mmc_queue_req *mqrq,
+			       struct mmc_card *card,
+			       int disable_multi,
+			       struct mmc_queue *mq)
+{
+	u32 readcmd, writecmd;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+
+	memset(brq, 0, sizeof(struct mmc_blk_request));
+	brq->mrq.cmd = &brq->cmd;
+	brq->mrq.data = &brq->data;
+
+	brq->cmd.arg = blk_rq_pos(req);
+	if (!mmc_card_blockaddr(card))
+		brq->cmd.arg <<= 9;
+	brq->cmd.flags = MMC_RSP_SPI_R1 | MMC_RSP_R1 | MMC_CMD_ADTC;
+	brq->data.blksz = 512;
+	brq->stop.opcode = MMC_STOP_TRANSMISSION;
+	brq->stop.arg = 0;
+	brq->stop.flags = MMC_RSP_SPI_R1B | MMC_RSP_R1B | MMC_CMD_AC;
+	brq->data.blocks = mmc_queue_req_sectors(mqrq);
 
-		/*
-		 * After a read error, we redo the request one sector at a time
-		 * in order to accurately determine which sectors can be read
-		 * successfully.
-		 */
-		if (disable_multi && brq.data.blocks > 1)
-			brq.data.blocks = 1;
+	/*
+	 * The block layer doesn't support all sector count
+	 * restrictions, so we need to be prepared for too big
+	 * requests.
+	 */
+	if (brq->data.blocks > card->host->max_blk_count)
+		brq->data.blocks = card->host->max_blk_count;
 
-		if (brq.data.blocks > 1) {
-			/* SPI multiblock writes terminate using a special
-			 * token, not a STOP_TRANSMISSION request.
-			 */
-			if (!mmc_host_is_spi(card->host)
-					|| rq_data_dir(req) == READ)
-				brq.mrq.stop = &brq.stop;
-			readcmd = MMC_READ_MULTIPLE_BLOCK;
-			writecmd = MMC_WRITE_MULTIPLE_BLOCK;
-		} else {
-			brq.mrq.stop = NULL;
-			readcmd = MMC_READ_SINGLE_BLOCK;
-			writecmd = MMC_WRITE_BLOCK;
-		}
-		if (rq_data_dir(req) == READ) {
-			brq.cmd.opcode = readcmd;
-			brq.data.flags |= MMC_DATA_READ;
-		} else {
-			brq.cmd.opcode = writecmd;
-			brq.data.flags |= MMC_DATA_WRITE;
-		}
+	/*
+	 * After a read error, we redo the request one sector at a time
+	 * in order to accurately determine which sectors can be read
+	 * successfully.
+	 */
+	if (disable_multi && brq->data.blocks > 1)
+		brq->data.blocks = 1;
 
-#ifdef _MMC_SAFE_ACCESS_
-		if (card->type == MMC_TYPE_SD)
-			if (!mmc_is_available)
-				goto cmd_sdremove;
-#endif
+	if (brq->data.blocks > 1) {
+		/* SPI multiblock writes terminate using a special
+		 * token, not a STOP_TRANSMISSION request.
+		 */
+		if (!mmc_host_is_spi(card->host)
+				|| rq_data_dir(req) == READ)
+			brq->mrq.stop = &brq->stop;
+		readcmd = MMC_READ_MULTIPLE_BLOCK;
+		writecmd = MMC_WRITE_MULTIPLE_BLOCK;
+	} else {
+		brq->mrq.stop = NULL;
+		readcmd = MMC_READ_SINGLE_BLOCK;
+		writecmd = MMC_WRITE_BLOCK;
+	}
+	if (rq_data_dir(req) == READ) {
+		brq->cmd.opcode = readcmd;
+		brq->data.flags |= MMC_DATA_READ;
+	} else {
+		brq->cmd.opcode = writecmd;
+		brq->data.flags |= MMC_DATA_WRITE;
+	}
 
-		mmc_set_data_timeout(&brq.data, card);
+	mmc_set_data_timeout(&brq->data, card);
 
-		brq.data.sg = mq->sg;
-		brq.data.sg_len = mmc_queue_map_sg(mq);
+	brq->data.sg = mqrq->sg;
+	brq->data.sg_len = mmc_queue_map_sg(mq, mqrq);
 
-		/*
-		 * Adjust the sg list so it is the same size as the
-		 * request.
-		 */
-		if (brq.data.blocks != blk_rq_sectors(req)) {
-			int i, data_size = brq.data.blocks << 9;
-			struct scatterlist *sg;
-
-			for_each_sg(brq.data.sg, sg, brq.data.sg_len, i) {
-				data_size -= sg->length;
-				if (data_size <= 0) {
-					sg->length += data_size;
-					i++;
-					break;
-				}
+	/*
+	 * Adjust the sg list so it is the same size as the
+	 * request.
+	 */
+	if (brq->data.blocks != mmc_queue_req_sectors(mqrq)) {
+		int i, data_size = brq->data.blocks << 9;
+		struct scatterlist *sg;
+
+		for_each_sg(brq->data.sg, sg, brq->data.sg_len, i) {
+			data_size -= sg->length;
+			if (data_size <= 0) {
+				sg->length += data_size;
+				i++;
+				break;
 			}
-			brq.data.sg_len = i;
 		}
+		brq->data.sg_len = i;
+	}
 
-#ifdef _MMC_SAFE_ACCESS_
-		if (card->type == MMC_TYPE_SD)
-			if (!mmc_is_available)
-				goto cmd_sdremove;
-#endif
+	mqrq->mmc_active.mrq = &brq->mrq;
+	mqrq->mmc_active.err_check = mmc_blk_err_check;
 
+	mmc_queue_bounce_pre(mqrq);
+}
+
+/*
+ * Issue a request one transfer at a time, handling errors and retries.
+ * If @done is set, the first transfer has already been made through
+ * mmc_start_req() and only its result is left to handle.
+ */
+static int mmc_blk_issue_rw_sync(struct mmc_queue *mq,
+				 struct mmc_queue_req *mqrq, bool done)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_blk_request *brq = &mqrq->brq;
+	struct request *req = mqrq->req;
+	int ret = 1, disable_multi = 0;
 
-		mmc_queue_bounce_pre(mq);
+	do {
+		struct mmc_command cmd;
+		u32 status = 0;
 
-		mmc_wait_for_req(card->host, &brq.mrq);
+		if (!done) {
+#ifdef _MMC_SAFE_ACCESS_
+			if (card->type == MMC_TYPE_SD)
+				if (!mmc_is_available)
+					goto cmd_sdremove;
+#endif
+			mmc_blk_rw_rq_prep(mqrq, card, disable_multi, mq);
+			mmc_wait_for_req(card->host, &brq->mrq);
+		}
+		done = false;
 
-		mmc_queue_bounce_post(mq);
+		mmc_queue_bounce_post(mqrq);
 
 /* debug code */
 #ifdef MOVI_DEBUG
 		if (card->type == MMC_TYPE_MMC) {
 
-			gaCmdLog[gnCmdLogIdx].cmd = brq.cmd.opcode;
-			gaCmdLog[gnCmdLogIdx].arg = brq.cmd.arg;
-			gaCmdLog[gnCmdLogIdx].cnt = brq.data.blocks;
-			gaCmdLog[gnCmdLogIdx].rsp = brq.cmd.resp[0];
-			gaCmdLog[gnCmdLogIdx].stoprsp = brq.stop.resp[0];
+			gaCmdLog[gnCmdLogIdx].cmd = brq->cmd.opcode;
+			gaCmdLog[gnCmdLogIdx].arg = brq->cmd.arg;
+			gaCmdLog[gnCmdLogIdx].cnt = brq->data.blocks;
+			gaCmdLog[gnCmdLogIdx].rsp = brq->cmd.resp[0];
+			gaCmdLog[gnCmdLogIdx].stoprsp = brq->stop.resp[0];
 			gnCmdLogIdx++;
 
 			if (gnCmdLogIdx >= 5)
@@ -462,8 +501,8 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * until later as we need to wait for the card to leave
 		 * programming mode even when things go wrong.
 		 */
-		if (!brq.cmd.error && !brq.stop.error &&
-			brq.data.error == -EAGAIN) {
+		if (!brq->cmd.error && !brq->stop.error &&
+			brq->data.error == -EAGAIN) {
 			printk(KERN_WARNING "%s: retrying transfer\n",
 					req->rq_disk->disk_name);
 			if (wait_for_ready_state(card, req))
@@ -471,8 +510,8 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			continue;
 		}
 
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
-			if (brq.data.blocks > 1 && rq_data_dir(req) == READ) {
+		if (brq->cmd.error || brq->data.error || brq->stop.error) {
+			if (brq->data.blocks > 1 && rq_data_dir(req) == READ) {
 				/* Redo read one sector at a time */
 				printk(KERN_WARNING "%s: retrying using single "
 				       "block read\n", req->rq_disk->disk_name);
@@ -485,7 +524,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		}
 
 #ifdef MOVI_DEBUG
-		if (brq.cmd.error) {
+		if (brq->cmd.error) {
 			if (card->type == MMC_TYPE_MMC) {
 
 				status = get_card_status(card, req, &status, 0);
@@ -571,11 +610,11 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			}
 		}
 #endif
-		if (brq.cmd.error) {
+		if (brq->cmd.error) {
 			printk(KERN_ERR "%s: error %d sending read/write "
 			       "command, response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.cmd.error,
-			       brq.cmd.resp[0], status);
+			       req->rq_disk->disk_name, brq->cmd.error,
+			       brq->cmd.resp[0], status);
 			if(R1_CURRENT_STATE(status) == 6 || R1_CURRENT_STATE(status) == 5)
 			{
 				struct mmc_command cmd;
@@ -589,26 +628,26 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 			}
 		}
 
-		if (brq.data.error) {
-			if (brq.data.error == -ETIMEDOUT && brq.mrq.stop)
+		if (brq->data.error) {
+			if (brq->data.error == -ETIMEDOUT && brq->mrq.stop)
 				/* 'Stop' response contains card status */
-				status = brq.mrq.stop->resp[0];
+				status = brq->mrq.stop->resp[0];
 			printk(KERN_ERR "%s: error %d transferring data,"
 			       " sector %u, nr %u, card status %#x\n",
-			       req->rq_disk->disk_name, brq.data.error,
+			       req->rq_disk->disk_name, brq->data.error,
 			       (unsigned)blk_rq_pos(req),
 			       (unsigned)blk_rq_sectors(req), status);
 		}
 
-		if (brq.stop.error) {
+		if (brq->stop.error) {
 			printk(KERN_ERR "%s: error %d sending stop command, "
 			       "response %#x, card status %#x\n",
-			       req->rq_disk->disk_name, brq.stop.error,
-			       brq.stop.resp[0], status);
+			       req->rq_disk->disk_name, brq->stop.error,
+			       brq->stop.resp[0], status);
 		}
 
 #ifdef _MMC_SAFE_ACCESS_
-		if (brq.cmd.error || brq.data.error || brq.stop.error) {
+		if (brq->cmd.error || brq->data.error || brq->stop.error) {
 			if (card->type == MMC_TYPE_SD) {
 				if (mmc_is_available)
 					status = get_card_status(card,
@@ -622,7 +661,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		if (wait_for_ready_state(card, req))
 			goto cmd_err;
 
-		if (brq.cmd.error || brq.stop.error || brq.data.error) {
+		if (brq->cmd.error || brq->stop.error || brq->data.error) {
 			if (rq_data_dir(req) == READ) {
 				/*
 				 * After an error, we redo I/O one sector at a
@@ -631,7 +670,7 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 				 */
 				spin_lock_irq(&md->lock);
 				ret = __blk_end_request(req,
-					-EIO, brq.data.blksz);
+					-EIO, brq->data.blksz);
 				spin_unlock_irq(&md->lock);
 				continue;
 			}
@@ -642,19 +681,16 @@ static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
 		 * A block was successfully transferred.
 		 */
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	} while (ret);
 
-	mmc_release_host(card->host);
-
 	return 1;
 
 cmd_sdremove:
 	spin_lock_irq(&md->lock);
 	__blk_end_request_all(req, -EIO);
 	spin_unlock_irq(&md->lock);
-	mmc_release_host(card->host);
 	return 0;
 
  cmd_err:
@@ -677,12 +713,10 @@ cmd_sdremove:
 		}
 	} else {
 		spin_lock_irq(&md->lock);
-		ret = __blk_end_request(req, 0, brq.data.bytes_xfered);
+		ret = __blk_end_request(req, 0, brq->data.bytes_xfered);
 		spin_unlock_irq(&md->lock);
 	}
 
-	mmc_release_host(card->host);
-
 	spin_lock_irq(&md->lock);
 	while (ret)
 		ret = __blk_end_request(req, -EIO, blk_rq_cur_bytes(req));
@@ -691,6 +725,102 @@ cmd_sdremove:
 	return 0;
 }
 
+/*
+ * Start @rqc and complete the request started before it.  The new
+ * request is prepared, and its DMA mapped by the host, while the
+ * previous one is still on the bus.
+ */
+static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_async_req *areq = NULL;
+	struct mmc_queue_req *mq_rq;
+	int ret, err;
+
+	if (!rqc && !mq->mqrq_prev->req)
+		return 0;
+
+	if (rqc) {
+		mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
+		areq = &mq->mqrq_cur->mmc_active;
+	}
+
+	areq = mmc_start_req(card->host, areq, &err);
+	if (!areq)
+		return 1;
+
+	mq_rq = container_of(areq, struct mmc_queue_req, mmc_active);
+	if (!err) {
+		struct request *req;
+
+		mmc_queue_bounce_post(mq_rq);
+
+		if (rq_data_dir(mq_rq->req) == WRITE) {
+			mq->pack_stats.writes++;
+			mq->pack_stats.reqs += mq_rq->packed_num;
+			if (mq_rq->packed_num > 1)
+				mq->pack_stats.packed++;
+			if (mq_rq->packed_num > mq->pack_stats.max)
+				mq->pack_stats.max = mq_rq->packed_num;
+		}
+
+		spin_lock_irq(&md->lock);
+		while (!list_empty(&mq_rq->packed_list)) {
+			req = list_first_entry(&mq_rq->packed_list,
+					       struct request, queuelist);
+			list_del_init(&req->queuelist);
+			__blk_end_request_all(req, 0);
+		}
+		ret = __blk_end_request(mq_rq->req, 0,
+					blk_rq_bytes(mq_rq->req));
+		spin_unlock_irq(&md->lock);
+		WARN_ON(ret);
+		return 1;
+	}
+
+	/*
+	 * The previous request failed and @rqc was not started: the host
+	 * is idle until the error has been dealt with.  A packed transfer
+	 * gives no clue as to which of its requests failed, they are put
+	 * back on the queue and the first one is retried on its own.
+	 */
+	if (mq_rq->packed_num > 1) {
+		mmc_queue_unpack(mq, mq_rq);
+		ret = mmc_blk_issue_rw_sync(mq, mq_rq, false);
+	} else
+		ret = mmc_blk_issue_rw_sync(mq, mq_rq, true);
+	if (rqc)
+		mmc_start_req(card->host, &mq->mqrq_cur->mmc_active, NULL);
+
+	return ret;
+}
+
+static int mmc_blk_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	int ret;
+
+	/* The host stays claimed while requests follow each other */
+	if (req && !mq->mqrq_prev->req) {
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		if (mmc_bus_needs_resume(card->host)) {
+			mmc_resume_bus(card->host);
+			mmc_blk_set_blksize(md, card);
+		}
+#endif
+		mmc_claim_host(card->host);
+	}
+
+	ret = mmc_blk_issue_rw_rq(mq, req);
+
+	if (!req)
+		mmc_release_host(card->host);
+
+	return ret;
+}
+
 static inline int mmc_blk_readonly(struct mmc_card *card)
 {
 	return mmc_card_readonly(card) ||
@@ -734,6 +864,7 @@ static struct mmc_blk_data *mmc_blk_alloc(struct mmc_card *card)
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
+	md->queue.max_packed = packed_writes ? packed_writes : 1;
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
@@ -783,6 +914,82 @@ out:
 	return ERR_PTR(ret);
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int mmc_blk_packing_show(struct seq_file *s, void *v)
+{
+	struct mmc_blk_data *md = s->private;
+	struct mmc_queue *mq = &md->queue;
+
+	seq_printf(s, "max_packed:\t%u\n", mq->max_packed);
+	seq_printf(s, "writes:\t\t%lu\n", mq->pack_stats.writes);
+	seq_printf(s, "requests:\t%lu\n", mq->pack_stats.reqs);
+	seq_printf(s, "packed:\t\t%lu\n", mq->pack_stats.packed);
+	seq_printf(s, "max:\t\t%u\n", mq->pack_stats.max);
+
+	return 0;
+}
+
+static int mmc_blk_packing_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_blk_packing_show, inode->i_private);
+}
+
+static ssize_t mmc_blk_packing_write(struct file *file,
+				     const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct mmc_blk_data *md = s->private;
+
+	memset(&md->queue.pack_stats, 0, sizeof(md->queue.pack_stats));
+
+	return count;
+}
+
+static const struct file_operations mmc_blk_packing_fops = {
+	.open		= mmc_blk_packing_open,
+	.read		= seq_read,
+	.write		= mmc_blk_packing_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/*
+ * The card's debugfs directory is created after the driver is bound and
+ * removed before it is unbound, so the disk gets a directory of its own.
+ */
+static void mmc_blk_add_debugfs(struct mmc_blk_data *md)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir(md->disk->disk_name, NULL);
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	if (!debugfs_create_file("packing", S_IRUSR | S_IWUSR, root, md,
+				 &mmc_blk_packing_fops)) {
+		debugfs_remove(root);
+		return;
+	}
+
+	md->debugfs_root = root;
+}
+
+static void mmc_blk_remove_debugfs(struct mmc_blk_data *md)
+{
+	debugfs_remove_recursive(md->debugfs_root);
+	md->debugfs_root = NULL;
+}
+#else
+static inline void mmc_blk_add_debugfs(struct mmc_blk_data *md)
+{
+}
+
+static inline void mmc_blk_remove_debugfs(struct mmc_blk_data *md)
+{
+}
+#endif
+
 static int mmc_blk_probe(struct mmc_card *card)
 {
 	struct mmc_blk_data *md;
@@ -815,6 +1022,7 @@ static int mmc_blk_probe(struct mmc_card *card)
 	mmc_set_bus_resume_policy(card->host, 1);
 #endif
 	add_disk(md->disk);
+	mmc_blk_add_debugfs(md);
 	return 0;
 
 out:
@@ -829,6 +1037,8 @@ static void mmc_blk_remove(struct mmc_card *card)
 	struct mmc_blk_data *md = mmc_get_drvdata(card);
 
 	if (md) {
+		mmc_blk_remove_debugfs(md);
+
 		/* Stop new requests from getting into the queue */
 		del_gendisk(md->disk);
 
@@ -179,6 +179,47 @@ static void dump_mmc_ios(struct mmc_host *host)
 	pr_info("timing spec:\t%u (%s)\n", ios->timing, str);
 }
 
+/* Upper bounds, in us, of the mmc_req_stats gap buckets */
+static const u32 mmc_req_gap_us[MMC_REQ_GAP_BUCKETS - 1] = {
+	50, 100, 500, 1000, 5000,
+};
+
+/*
+ * Account the time the bus stayed idle before a data request.  Long gaps
+ * are mostly an empty queue rather than request set up, they only land
+ * in the last bucket.  The statistics are not locked, only one request
+ * can be active on a host.
+ */
+static void mmc_req_stats_start(struct mmc_host *host)
+{
+	struct mmc_req_stats *st = &host->req_stats;
+	ktime_t now = ktime_get();
+	u32 gap;
+	int i;
+
+	if (st->last_done.tv64) {
+		gap = ktime_to_us(ktime_sub(now, st->last_done));
+		for (i = 0; i < MMC_REQ_GAP_BUCKETS - 1; i++)
+			if (gap < mmc_req_gap_us[i])
+				break;
+		st->gaps[i]++;
+	}
+	st->start = now;
+}
+
+static void mmc_req_stats_done(struct mmc_host *host)
+{
+	struct mmc_req_stats *st = &host->req_stats;
+	ktime_t now = ktime_get();
+	u32 lat = ktime_to_us(ktime_sub(now, st->start));
+
+	st->reqs++;
+	st->busy_us += lat;
+	if (lat > st->max_us)
+		st->max_us = lat;
+	st->last_done = now;
+}
+
 /**
  *	mmc_request_done - finish processing an MMC request
  *	@host: MMC host which completed request
@@ -226,6 +267,9 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 				mrq->stop->resp[2], mrq->stop->resp[3]);
 		}
 
+		if (mrq->data)
+			mmc_req_stats_done(host);
+
 		if (mrq->done)
 			mrq->done(mrq);
 	}
@@ -287,6 +331,7 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 			mrq->stop->error = 0;
 			mrq->stop->mrq = mrq;
 		}
+		mmc_req_stats_start(host);
 	}
 	host->ops->request(host, mrq);
 }
@@ -296,26 +341,21 @@ static void mmc_wait_done(struct mmc_request *mrq)
 	complete(mrq->done_data);
 }
 
-/**
- *	mmc_wait_for_req - start a request and wait for completion
- *	@host: MMC host to start command
- *	@mrq: MMC request to start
- *
- *	Start a new MMC custom command request for a host, and wait
- *	for the command to complete. Does not attempt to parse the
- *	response.
- */
-void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
+static void __mmc_start_req(struct mmc_host *host, struct mmc_request *mrq,
+			    struct completion *complete)
 {
-	int ret;
-	DECLARE_COMPLETION_ONSTACK(complete);
-
-	mrq->done_data = &complete;
+	mrq->done_data = complete;
 	mrq->done = mmc_wait_done;
 
 	mmc_start_request(host, mrq);
+}
 
-	if (!wait_for_completion_timeout(&complete,
+static void mmc_wait_for_req_done(struct mmc_host *host,
+				  struct mmc_request *mrq)
+{
+	int ret;
+
+	if (!wait_for_completion_timeout(mrq->done_data,
 		msecs_to_jiffies(10000))) {
 		host->ops->dump_regs(host);
 		dump_mmc_ios(host);
@@ -341,7 +381,113 @@ void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
 	}
 }
 
+/**
+ *	mmc_pre_req - Prepare for a new request
+ *	@host: MMC host to prepare command
+ *	@mrq: MMC request to prepare for
+ *	@is_first_req: true if there is no previous started request
+ *                     that may run in parallel to this call, otherwise false
+ *
+ *	mmc_pre_req() is called in prior to mmc_start_req() to let
+ *	host prepare for the new request. Preparation of a request may be
+ *	performed while another request is running on the host.
+ */
+static void mmc_pre_req(struct mmc_host *host, struct mmc_request *mrq,
+		 bool is_first_req)
+{
+	if (host->ops->pre_req) {
+		host->ops->pre_req(host, mrq, is_first_req);
+		host->req_stats.prepared++;
+	}
+}
+
+/**
+ *	mmc_post_req - Post process a completed request
+ *	@host: MMC host to post process command
+ *	@mrq: MMC request to post process for
+ *	@err: Error, if non zero, clean up any resources made in pre_req
+ *
+ *	Let the host post process a completed request. Post processing of
+ *	a request may be performed while another request is running.
+ */
+static void mmc_post_req(struct mmc_host *host, struct mmc_request *mrq,
+			 int err)
+{
+	if (host->ops->post_req)
+		host->ops->post_req(host, mrq, err);
+}
+
+/**
+ *	mmc_start_req - start a non-blocking request
+ *	@host: MMC host to start command
+ *	@areq: async request to start
+ *	@error: out parameter returns 0 for success, otherwise non zero
+ *
+ *	Start a new MMC custom command request for a host. If there is
+ *	an ongoing async request, wait for it to complete before the new
+ *	one is started. Does not wait for the new request to complete.
+ *
+ *	Returns the completed request, or NULL without waiting if there
+ *	was no ongoing request; NULL is not an error condition. When the
+ *	completed request fails @err_check, the new request is not
+ *	started and is left to the caller.
+ */
+struct mmc_async_req *mmc_start_req(struct mmc_host *host,
+				    struct mmc_async_req *areq, int *error)
+{
+	int err = 0;
+	struct mmc_async_req *data = host->areq;
+
+	/* Prepare a new request */
+	if (areq)
+		mmc_pre_req(host, areq->mrq, !host->areq);
+
+	if (host->areq) {
+		mmc_wait_for_req_done(host, host->areq->mrq);
+		err = host->areq->err_check(host->card, host->areq);
+		if (err) {
+			/* The new request is not started, undo pre_req */
+			mmc_post_req(host, host->areq->mrq, 0);
+			if (areq)
+				mmc_post_req(host, areq->mrq, -EINVAL);
+
+			host->areq = NULL;
+			goto out;
+		}
+	}
+
+	if (areq) {
+		init_completion(&areq->complete);
+		__mmc_start_req(host, areq->mrq, &areq->complete);
+	}
+
+	if (host->areq)
+		mmc_post_req(host, host->areq->mrq, 0);
+
+	host->areq = areq;
+ out:
+	if (error)
+		*error = err;
+	return data;
+}
+EXPORT_SYMBOL(mmc_start_req);
+
+/**
+ *	mmc_wait_for_req - start a request and wait for completion
+ *	@host: MMC host to start command
+ *	@mrq: MMC request to start
+ *
+ *	Start a new MMC custom command request for a host, and wait
+ *	for the command to complete. Does not attempt to parse the
+ *	response.
+ */
+void mmc_wait_for_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	DECLARE_COMPLETION_ONSTACK(complete);
 
+	__mmc_start_req(host, mrq, &complete);
+	mmc_wait_for_req_done(host, mrq);
+}
 EXPORT_SYMBOL(mmc_wait_for_req);
 
 /**
@@ -9,6 +9,7 @@
  */
 #include <linux/debugfs.h>
 #include <linux/fs.h>
+#include <linux/math64.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
@@ -134,6 +135,50 @@ static const struct file_operations mmc_ios_fops = {
 	.release	= single_release,
 };
 
+static int mmc_req_stats_show(struct seq_file *s, void *data)
+{
+	struct mmc_host *host = s->private;
+	struct mmc_req_stats *st = &host->req_stats;
+	static const char *gap_names[MMC_REQ_GAP_BUCKETS] = {
+		"<50us", "<100us", "<500us", "<1ms", "<5ms", ">=5ms",
+	};
+	int i;
+
+	seq_printf(s, "requests:\t%lu\n", st->reqs);
+	seq_printf(s, "prepared:\t%lu\n", st->prepared);
+	seq_printf(s, "avg latency:\t%llu us\n",
+		   st->reqs ? div_u64(st->busy_us, st->reqs) : 0);
+	seq_printf(s, "max latency:\t%u us\n", st->max_us);
+	seq_printf(s, "idle gaps:\n");
+	for (i = 0; i < MMC_REQ_GAP_BUCKETS; i++)
+		seq_printf(s, "  %-8s%lu\n", gap_names[i], st->gaps[i]);
+
+	return 0;
+}
+
+static int mmc_req_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmc_req_stats_show, inode->i_private);
+}
+
+static ssize_t mmc_req_stats_write(struct file *file,
+				   const char __user *ubuf,
+				   size_t count, loff_t *ppos)
+{
+	struct mmc_host *host = ((struct seq_file *)file->private_data)->private;
+
+	memset(&host->req_stats, 0, sizeof(host->req_stats));
+	return count;
+}
+
+static const struct file_operations mmc_req_stats_fops = {
+	.open		= mmc_req_stats_open,
+	.read		= seq_read,
+	.write		= mmc_req_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 void mmc_add_host_debugfs(struct mmc_host *host)
 {
 	struct dentry *root;
@@ -152,6 +197,10 @@ void mmc_add_host_debugfs(struct mmc_host *host)
 	if (!debugfs_create_file("ios", S_IRUSR, root, host, &mmc_ios_fops))
 		goto err_ios;
 
+	if (!debugfs_create_file("req_stats", S_IRUSR | S_IWUSR, root, host,
+				 &mmc_req_stats_fops))
+		goto err_ios;
+
 	return;
 
 err_ios:
@@ -586,16 +586,26 @@ static inline void mmci_disable_dma(struct mmci_host *host)
 		dma_release_channel(host->dma_rx_channel);
 	if (host->dma_tx_channel)
 		dma_release_channel(host->dma_tx_channel);
+	host->next_data.dma_chan = NULL;
+	host->next_data.dma_desc = NULL;
 	host->dma_enable = false;
 }
 
-static void mmci_dma_data_end(struct mmci_host *host)
+static void mmci_dma_unmap(struct mmci_host *host, struct mmc_data *data)
 {
-	struct mmc_data *data = host->data;
-
 	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
 		     (data->flags & MMC_DATA_WRITE)
 		     ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+	data->host_cookie = 0;
+}
+
+/* Requests prepared by mmci_pre_request() are unmapped in post_request */
+static void mmci_dma_data_end(struct mmci_host *host)
+{
+	struct mmc_data *data = host->data;
+
+	if (!data->host_cookie)
+		mmci_dma_unmap(host, data);
 	host->dma_on_current_xfer = false;
 }
 
@@ -609,9 +619,8 @@ static void mmci_dma_terminate(struct mmci_host *host)
 		chan = host->dma_rx_channel;
 	else
 		chan = host->dma_tx_channel;
-	dma_unmap_sg(mmc_dev(host->mmc), data->sg, data->sg_len,
-		     (data->flags & MMC_DATA_WRITE)
-		     ? DMA_TO_DEVICE : DMA_FROM_DEVICE);
+	if (!data->host_cookie)
+		mmci_dma_unmap(host, data);
 	chan->device->device_control(chan, DMA_TERMINATE_ALL, 0);
 	host->dma_on_current_xfer = false;
 }
@@ -656,7 +665,13 @@ static void mmci_dma_callback(void *arg)
 	spin_unlock_irqrestore(&host->lock, flags);
 }
 
-static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
+/*
+ * Map the data and prepare its DMA descriptor. This does not touch the
+ * hardware, so it may run while another transfer is active.
+ */
+static int mmci_dma_prep_data(struct mmci_host *host, struct mmc_data *data,
+			      struct dma_chan **dma_chan,
+			      struct dma_async_tx_descriptor **dma_desc)
 {
 	struct variant_data *variant = host->variant;
 	struct dma_slave_config conf = {
@@ -667,7 +682,6 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 		.src_maxburst = variant->fifohalfsize >> 2, /* # of words */
 		.dst_maxburst = variant->fifohalfsize >> 2, /* # of words */
 	};
-	struct mmc_data *data = host->data;
 	struct dma_chan *chan;
 	struct dma_device *device;
 	struct dma_async_tx_descriptor *desc;
@@ -675,8 +689,6 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 	int maxburst_mult = 0;
 	struct scatterlist *sg;
 	int nr_sg, i;
-	dma_cookie_t cookie;
-	unsigned int irqmask0;
 
 	if (data->flags & MMC_DATA_READ) {
 		conf.direction = DMA_FROM_DEVICE;
@@ -691,7 +703,7 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 		return -EINVAL;
 
 	/* If less than or equal to the fifo size, don't bother with DMA */
-	if (host->size <= variant->fifosize)
+	if (data->blksz * data->blocks <= variant->fifosize)
 		return -EINVAL;
 
 	/*
@@ -740,8 +752,43 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 	desc = device->device_prep_slave_sg(chan, data->sg, nr_sg,
 					    conf.direction,
 					    DMA_CTRL_ACK | DMA_PREP_INTERRUPT);
-	if (!desc)
-		goto unmap_exit;
+	if (!desc) {
+		dma_unmap_sg(device->dev, data->sg, data->sg_len,
+			     conf.direction);
+		return -ENOMEM;
+	}
+
+	*dma_chan = chan;
+	*dma_desc = desc;
+	return 0;
+}
+
+static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
+{
+	struct variant_data *variant = host->variant;
+	struct mmc_data *data = host->data;
+	struct mmci_host_next *next = &host->next_data;
+	struct dma_chan *chan;
+	struct dma_async_tx_descriptor *desc;
+	dma_cookie_t cookie;
+	unsigned int irqmask0;
+	int ret;
+
+	if (data->host_cookie && data->host_cookie == next->cookie &&
+	    next->dma_desc) {
+		/* Mapped and prepared by mmci_pre_request() */
+		chan = next->dma_chan;
+		desc = next->dma_desc;
+		next->dma_chan = NULL;
+		next->dma_desc = NULL;
+	} else {
+		/* The channels were released since it was prepared */
+		if (data->host_cookie)
+			mmci_dma_unmap(host, data);
+		ret = mmci_dma_prep_data(host, data, &chan, &desc);
+		if (ret)
+			return ret;
+	}
 
 	/* Setup dma callback function. */
 	desc->callback = mmci_dma_callback;
@@ -758,7 +805,7 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 		goto unmap_exit;
 
 	host->dma_on_current_xfer = true;
-	device->device_issue_pending(chan);
+	chan->device->device_issue_pending(chan);
 
 	datactrl |= variant->dmareg_enable | MCI_DPSM_DMAENABLE;
 
@@ -777,10 +824,53 @@ static int mmci_dma_start_data(struct mmci_host *host, unsigned int datactrl)
 	return 0;
 
 unmap_exit:
-	device->device_control(chan, DMA_TERMINATE_ALL, 0);
-	dma_unmap_sg(device->dev, data->sg, data->sg_len, conf.direction);
+	chan->device->device_control(chan, DMA_TERMINATE_ALL, 0);
+	/* Falling back to PIO, the data must not stay mapped */
+	mmci_dma_unmap(host, data);
 	return -ENOMEM;
 }
+
+static void mmci_pre_request(struct mmc_host *mmc, struct mmc_request *mrq,
+			     bool is_first_req)
+{
+	struct mmci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct mmci_host_next *next = &host->next_data;
+
+	if (!data || !host->dma_enable)
+		return;
+
+	BUG_ON(data->host_cookie);
+
+	if (mmci_dma_prep_data(host, data, &next->dma_chan, &next->dma_desc))
+		return;
+
+	/* Never zero, that is an unprepared request */
+	next->cookie = next->cookie < 0 ? 1 : next->cookie + 1;
+	data->host_cookie = next->cookie;
+}
+
+static void mmci_post_request(struct mmc_host *mmc, struct mmc_request *mrq,
+			      int err)
+{
+	struct mmci_host *host = mmc_priv(mmc);
+	struct mmc_data *data = mrq->data;
+	struct mmci_host_next *next = &host->next_data;
+	struct dma_chan *chan;
+
+	if (!data || !data->host_cookie)
+		return;
+
+	/* Not started: drop the descriptor prepared for it */
+	if (err && data->host_cookie == next->cookie && next->dma_chan) {
+		chan = next->dma_chan;
+		chan->device->device_control(chan, DMA_TERMINATE_ALL, 0);
+		next->dma_chan = NULL;
+		next->dma_desc = NULL;
+	}
+
+	mmci_dma_unmap(host, data);
+}
 #else
 /* Blank functions if the DMA engine is not available */
 static inline void mmci_setup_dma(struct mmci_host *host)
@@ -791,6 +881,11 @@ static inline void mmci_disable_dma(struct mmci_host *host)
 {
 }
 
+static inline void mmci_dma_unmap(struct mmci_host *host,
+				  struct mmc_data *data)
+{
+}
+
 static inline void mmci_dma_data_end(struct mmci_host *host)
 {
 }
@@ -804,6 +899,9 @@ static inline int mmci_dma_start_data(struct mmci_host *host,
 {
 	return -ENOSYS;
 }
+
+#define mmci_pre_request NULL
+#define mmci_post_request NULL
 #endif
 
 static void mmci_dataend_timeout(struct work_struct *work)
@@ -937,6 +1035,10 @@ static void mmci_start_data(struct mmci_host *host, struct mmc_data *data)
 			return;
 	}
 
+	/* Prepared for DMA, but DMA has since been disabled */
+	if (data->host_cookie)
+		mmci_dma_unmap(host, data);
+
 	/* IRQ mode, map the SG list for CPU reading/writing */
 	mmci_init_sg(host, data);
 
@@ -1824,6 +1926,8 @@ static void mmci_abort_request(struct mmc_host *mmc)
 
 static const struct mmc_host_ops mmci_ops = {
 	.request	= mmci_request,
+	.pre_req	= mmci_pre_request,
+	.post_req	= mmci_post_request,
 	.set_ios	= mmci_set_ios,
 	.get_ro		= mmci_get_ro,
 	.get_cd		= mmci_get_cd,
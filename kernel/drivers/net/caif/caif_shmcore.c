@@ -286,6 +286,14 @@ static void shm_rx_work_func(struct work_struct *rx_work)
 					list);
 		list_del_init(&pbuf->list);
 
+		/*
+		 * The buffer is off the list now and nobody else touches it
+		 * until it is put on rx_pend_list, so unpack the frames
+		 * without the lock; netif_rx_ni() may also run softirqs,
+		 * which must not happen with interrupts disabled.
+		 */
+		spin_unlock_irqrestore(&pshm_drv->lock, flags);
+
 		/* Retrieve pointer to start of the packet descriptor area. */
 		pck_desc = (struct shm_pck_desc *) pbuf->desc_vptr;
 
@@ -336,7 +344,12 @@ static void shm_rx_work_func(struct work_struct *rx_work)
 			/* Get a suitable CAIF packet and copy in data. */
 			skb = netdev_alloc_skb(pshm_drv->pshm_dev->pshm_netdev,
 							frm_pck_len + 1);
-			BUG_ON(skb == NULL);
+			if (unlikely(skb == NULL)) {
+				++pshm_drv->pshm_dev->pshm_netdev->stats.
+								rx_dropped;
+				pck_desc++;
+				continue;
+			}
 
 			p = skb_put(skb, frm_pck_len);
 			memcpy(p, pbuf->desc_vptr + frm_pck_ofs, frm_pck_len);
@@ -360,16 +373,19 @@ static void shm_rx_work_func(struct work_struct *rx_work)
 			pck_desc++;
 		}
 
+		spin_lock_irqsave(&pshm_drv->lock, flags);
 		list_add_tail(&pbuf->list, &pshm_drv->rx_pend_list);
-
 		spin_unlock_irqrestore(&pshm_drv->lock, flags);
 
+		/*
+		 * Hand the emptied buffer back to the modem right away
+		 * instead of after the whole backlog has been unpacked.
+		 */
+		if (!work_pending(&pshm_drv->shm_tx_work))
+			queue_work(pshm_drv->pshm_tx_workqueue,
+					&pshm_drv->shm_tx_work);
 	}
 
-	/* Schedule the work queue. if required */
-	if (!work_pending(&pshm_drv->shm_tx_work))
-		queue_work(pshm_drv->pshm_tx_workqueue, &pshm_drv->shm_tx_work);
-
 }
 
 static void shm_tx_work_func(struct work_struct *tx_work)
@@ -34,11 +34,31 @@
 
 #define BULK_BUFFER_SIZE           4096
 
-/* number of tx requests to allocate */
+/* default number of tx requests to allocate */
 #define TX_REQ_MAX 4
 
+/* upper bound for the number of requests in flight per direction */
+#define ADB_REQ_MAX 32
+
 static const char shortname[] = "android_adb";
 
+/*
+ * Number of OUT requests kept queued on the endpoint.  With a single
+ * request each read() is issued with the length userspace asked for,
+ * rounded up to whole packets, so transfers are framed by the reader just
+ * like before.  With more
+ * than one the requests are queued with the full buffer size ahead of
+ * the reader, which requires the host to terminate each transfer with a
+ * short or zero-length packet.
+ */
+static unsigned int rx_reqs = 1;
+module_param(rx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_reqs, "Number of in-flight OUT requests (1-32)");
+
+static unsigned int tx_reqs = TX_REQ_MAX;
+module_param(tx_reqs, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_reqs, "Number of in-flight IN requests (1-32)");
+
 struct adb_dev {
 	struct usb_function function;
 	struct usb_composite_dev *cdev;
@@ -55,11 +75,29 @@ struct adb_dev {
 	atomic_t open_excl;
 
 	struct list_head tx_idle;
+	struct list_head rx_idle;
+	struct list_head rx_queued;
+	struct list_head rx_done;
+
+	/* partially consumed OUT request and read offset into it */
+	struct usb_request *rx_cur;
+	unsigned rx_offset;
+	/* set on reconnect, rx_cur holds data from the previous session */
+	int rx_stale;
+
+	unsigned rx_count;
+	unsigned tx_count;
 
 	wait_queue_head_t read_wq;
 	wait_queue_head_t write_wq;
-	struct usb_request *rx_req;
-	int rx_done;
+
+	/* throughput counters, reported through the "stats" attribute */
+	u64 rx_bytes;
+	u64 tx_bytes;
+	unsigned long rx_completed;
+	unsigned long tx_completed;
+	unsigned long rx_zlp;
+	unsigned tx_inflight_max;
 };
 
 static struct usb_interface_descriptor adb_interface_desc = {
@@ -198,11 +236,18 @@ struct usb_request *req_get(struct adb_dev *dev, struct list_head *head)
 static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
 
 	if (req->status != 0)
 		dev->error = 1;
 
-	req_put(dev, &dev->tx_idle, req);
+	spin_lock_irqsave(&dev->lock, flags);
+	if (req->status == 0) {
+		dev->tx_bytes += req->actual;
+		dev->tx_completed++;
+	}
+	list_add_tail(&req->list, &dev->tx_idle);
+	spin_unlock_irqrestore(&dev->lock, flags);
 
 	wake_up(&dev->write_wq);
 }
@@ -210,14 +255,107 @@ static void adb_complete_in(struct usb_ep *ep, struct usb_request *req)
 static void adb_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	spin_lock_irqsave(&dev->lock, flags);
+	if (req->status != 0) {
 		dev->error = 1;
+		list_move_tail(&req->list, &dev->rx_idle);
+	} else if (req->actual == 0) {
+		/* zero-length packet, nothing for the reader */
+		dev->rx_zlp++;
+		list_move_tail(&req->list, &dev->rx_idle);
+	} else {
+		dev->rx_bytes += req->actual;
+		dev->rx_completed++;
+		list_move_tail(&req->list, &dev->rx_done);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
 
 	wake_up(&dev->read_wq);
 }
 
+/*
+ * Queue every idle OUT request.  In single request mode the request is
+ * sized to the caller's read so that transfers keep their framing.  It is
+ * still rounded up to whole packets: a request shorter than the packet it
+ * receives overflows and loses the data, and it may be left queued for a
+ * later read of another size, after a non-blocking read for instance.
+ */
+static int adb_rx_submit(struct adb_dev *dev, size_t count)
+{
+	struct usb_request *req;
+	unsigned long flags;
+	int ret;
+
+	while ((req = req_get(dev, &dev->rx_idle))) {
+		req->length = (dev->rx_count == 1) ?
+			roundup(count, dev->ep_out->maxpacket) :
+			BULK_BUFFER_SIZE;
+		/* the completion may run before usb_ep_queue() returns */
+		req_put(dev, &dev->rx_queued, req);
+		ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
+		if (ret < 0) {
+			DBG(dev->cdev, "adb_read: failed to queue req %p (%d)\n",
+					req, ret);
+			spin_lock_irqsave(&dev->lock, flags);
+			list_move_tail(&req->list, &dev->rx_idle);
+			spin_unlock_irqrestore(&dev->lock, flags);
+			dev->error = 1;
+			return ret;
+		}
+		DBG(dev->cdev, "rx %p queue\n", req);
+	}
+	return 0;
+}
+
+/* take back every OUT request still owned by the controller */
+static void adb_rx_cancel(struct adb_dev *dev)
+{
+	struct usb_request *reqs[ADB_REQ_MAX];
+	struct usb_request *req;
+	unsigned long flags;
+	int i, n = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	list_for_each_entry(req, &dev->rx_queued, list)
+		reqs[n++] = req;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	for (i = 0; i < n; i++)
+		usb_ep_dequeue(dev->ep_out, reqs[i]);
+}
+
+/*
+ * Give back a request left over from before the last reconnect.  Only the
+ * reader, holding read_excl, may release rx_cur.
+ */
+static void adb_rx_drop_stale(struct adb_dev *dev)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->rx_stale) {
+		dev->rx_stale = 0;
+		if (dev->rx_cur) {
+			list_add_tail(&dev->rx_cur->list, &dev->rx_idle);
+			dev->rx_cur = NULL;
+		}
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+/* number of IN requests currently owned by the controller */
+static unsigned adb_tx_inflight(struct adb_dev *dev)
+{
+	struct list_head *pos;
+	unsigned idle = 0;
+
+	list_for_each(pos, &dev->tx_idle)
+		idle++;
+	return dev->tx_count - idle;
+}
+
 static int __init create_bulk_endpoints(struct adb_dev *dev,
 				struct usb_endpoint_descriptor *in_desc,
 				struct usb_endpoint_descriptor *out_desc)
@@ -248,13 +386,18 @@ static int __init create_bulk_endpoints(struct adb_dev *dev,
 	dev->ep_out = ep;
 
 	/* now allocate requests for our endpoints */
-	req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
-	if (!req)
-		goto fail;
-	req->complete = adb_complete_out;
-	dev->rx_req = req;
+	dev->rx_count = clamp_t(unsigned, rx_reqs, 1, ADB_REQ_MAX);
+	dev->tx_count = clamp_t(unsigned, tx_reqs, 1, ADB_REQ_MAX);
+
+	for (i = 0; i < dev->rx_count; i++) {
+		req = adb_request_new(dev->ep_out, BULK_BUFFER_SIZE);
+		if (!req)
+			goto fail;
+		req->complete = adb_complete_out;
+		req_put(dev, &dev->rx_idle, req);
+	}
 
-	for (i = 0; i < TX_REQ_MAX; i++) {
+	for (i = 0; i < dev->tx_count; i++) {
 		req = adb_request_new(dev->ep_in, BULK_BUFFER_SIZE);
 		if (!req)
 			goto fail;
@@ -288,6 +431,10 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 
 	/* we will block until we're online */
 	while (!(dev->online || dev->error)) {
+		if (fp->f_flags & O_NONBLOCK) {
+			r = -EAGAIN;
+			goto done;
+		}
 		DBG(cdev, "adb_read: waiting for online state\n");
 		ret = wait_event_interruptible(dev->read_wq,
 				(dev->online || dev->error));
@@ -296,45 +443,72 @@ static ssize_t adb_read(struct file *fp, char __user *buf,
 			return ret;
 		}
 	}
-	if (dev->error) {
-		r = -EIO;
-		goto done;
+
+	/* a previous read may have left part of a request unconsumed */
+	adb_rx_drop_stale(dev);
+	while (!(req = dev->rx_cur)) {
+		if (dev->error) {
+			r = -EIO;
+			goto done;
+		}
+
+		/* queue our requests, zero-length packets are thrown back */
+		if (adb_rx_submit(dev, count) < 0) {
+			r = -EIO;
+			goto done;
+		}
+
+		req = req_get(dev, &dev->rx_done);
+		if (req) {
+			dev->rx_cur = req;
+			dev->rx_offset = 0;
+			break;
+		}
+
+		if (fp->f_flags & O_NONBLOCK) {
+			r = -EAGAIN;
+			goto done;
+		}
+
+		/* wait for a request to complete */
+		ret = wait_event_interruptible(dev->read_wq,
+				(!list_empty(&dev->rx_done) ||
+				 !list_empty(&dev->rx_idle) || dev->error));
+		if (ret < 0) {
+			r = ret;
+			/*
+			 * A lone request was sized for this read, so it
+			 * can not be left behind for the next one.
+			 */
+			if (dev->rx_count == 1) {
+				dev->error = 1;
+				adb_rx_cancel(dev);
+			}
+			goto done;
+		}
 	}
 
-requeue_req:
-	/* queue a request */
-	req = dev->rx_req;
-	req->length = count;
-	dev->rx_done = 0;
-	ret = usb_ep_queue(dev->ep_out, req, GFP_ATOMIC);
-	if (ret < 0) {
-		DBG(cdev, "adb_read: failed to queue req %p (%d)\n", req, ret);
+	if (dev->error) {
 		r = -EIO;
-		dev->error = 1;
 		goto done;
-	} else {
-		DBG(cdev, "rx %p queue\n", req);
 	}
 
-	/* wait for a request to complete */
-	ret = wait_event_interruptible(dev->read_wq, dev->rx_done);
-	if (ret < 0) {
-		dev->error = 1;
-		r = ret;
-		usb_ep_dequeue(dev->ep_out, req);
+	DBG(cdev, "rx %p %d\n", req, req->actual);
+	xfer = min_t(unsigned, req->actual - dev->rx_offset, count);
+	if (copy_to_user(buf, req->buf + dev->rx_offset, xfer)) {
+		r = -EFAULT;
 		goto done;
 	}
-	if (!dev->error) {
-		/* If we got a 0-len packet, throw it back and try again. */
-		if (req->actual == 0)
-			goto requeue_req;
-
-		DBG(cdev, "rx %p %d\n", req, req->actual);
-		xfer = (req->actual < count) ? req->actual : count;
-		if (copy_to_user(buf, req->buf, xfer))
-			r = -EFAULT;
-	} else
-		r = -EIO;
+	r = xfer;
+
+	dev->rx_offset += xfer;
+	if (dev->rx_offset >= req->actual) {
+		dev->rx_cur = NULL;
+		req_put(dev, &dev->rx_idle, req);
+		/* keep the pipeline full while userspace handles the data */
+		if (dev->rx_count > 1)
+			adb_rx_submit(dev, count);
+	}
 
 done:
 	_unlock(&dev->read_excl);
@@ -348,6 +522,8 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 	struct adb_dev *dev = fp->private_data;
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req = 0;
+	unsigned long flags;
+	unsigned inflight;
 	int r = count, xfer;
 	int ret;
 
@@ -365,12 +541,21 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 
 		/* get an idle tx request to use */
 		req = 0;
-		ret = wait_event_interruptible(dev->write_wq,
-			((req = req_get(dev, &dev->tx_idle)) || dev->error));
-
-		if (ret < 0) {
-			r = ret;
-			break;
+		if (fp->f_flags & O_NONBLOCK) {
+			req = req_get(dev, &dev->tx_idle);
+			if (!req) {
+				/* report what was queued so far, if anything */
+				r = (r != count) ? r - count : -EAGAIN;
+				break;
+			}
+		} else {
+			ret = wait_event_interruptible(dev->write_wq,
+				((req = req_get(dev, &dev->tx_idle)) ||
+				 dev->error));
+			if (ret < 0) {
+				r = ret;
+				break;
+			}
 		}
 
 		if (req != 0) {
@@ -392,6 +577,12 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 				break;
 			}
 
+			spin_lock_irqsave(&dev->lock, flags);
+			inflight = adb_tx_inflight(dev);
+			if (inflight > dev->tx_inflight_max)
+				dev->tx_inflight_max = inflight;
+			spin_unlock_irqrestore(&dev->lock, flags);
+
 			buf += xfer;
 			count -= xfer;
 
@@ -408,6 +599,39 @@ static ssize_t adb_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+static unsigned int adb_poll(struct file *fp, poll_table *wait)
+{
+	struct adb_dev *dev = fp->private_data;
+	unsigned long flags;
+	unsigned int mask = 0;
+
+	poll_wait(fp, &dev->read_wq, wait);
+	poll_wait(fp, &dev->write_wq, wait);
+
+	/*
+	 * Make sure OUT requests are queued so that there is something to
+	 * wake us up.  A lone request is limited to one packet here, which
+	 * always completes and so keeps the reader's framing intact.
+	 */
+	if (dev->online && !dev->error && !_lock(&dev->read_excl)) {
+		adb_rx_drop_stale(dev);
+		if (!dev->rx_cur)
+			adb_rx_submit(dev, dev->ep_out->maxpacket);
+		_unlock(&dev->read_excl);
+	}
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->rx_cur || !list_empty(&dev->rx_done))
+		mask |= POLLIN | POLLRDNORM;
+	if (dev->online && !list_empty(&dev->tx_idle))
+		mask |= POLLOUT | POLLWRNORM;
+	if (dev->error)
+		mask |= POLLERR;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return mask;
+}
+
 static int adb_open(struct inode *ip, struct file *fp)
 {
 	printk(KERN_INFO "adb_open\n");
@@ -434,6 +658,7 @@ static struct file_operations adb_fops = {
 	.owner = THIS_MODULE,
 	.read = adb_read,
 	.write = adb_write,
+	.poll = adb_poll,
 	.open = adb_open,
 	.release = adb_release,
 };
@@ -444,6 +669,34 @@ static struct miscdevice adb_device = {
 	.fops = &adb_fops,
 };
 
+static ssize_t adb_stats_show(struct device *pdev,
+		struct device_attribute *attr, char *buf)
+{
+	struct adb_dev *dev = _adb_dev;
+	unsigned long flags;
+	u64 rx_bytes, tx_bytes;
+	unsigned long rx_completed, tx_completed, rx_zlp;
+	unsigned tx_inflight_max;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	rx_bytes = dev->rx_bytes;
+	tx_bytes = dev->tx_bytes;
+	rx_completed = dev->rx_completed;
+	tx_completed = dev->tx_completed;
+	rx_zlp = dev->rx_zlp;
+	tx_inflight_max = dev->tx_inflight_max;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return sprintf(buf, "rx_reqs %u\ntx_reqs %u\n"
+			"rx_bytes %llu\nrx_completed %lu\nrx_zlp %lu\n"
+			"tx_bytes %llu\ntx_completed %lu\ntx_inflight_max %u\n",
+			dev->rx_count, dev->tx_count,
+			rx_bytes, rx_completed, rx_zlp,
+			tx_bytes, tx_completed, tx_inflight_max);
+}
+
+static DEVICE_ATTR(stats, S_IRUGO, adb_stats_show, NULL);
+
 static int adb_enable_open(struct inode *ip, struct file *fp)
 {
 	if (atomic_inc_return(&adb_enable_excl) != 1) {
@@ -522,7 +775,14 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 
 	spin_lock_irq(&dev->lock);
 
-	adb_request_free(dev->rx_req, dev->ep_out);
+	if (dev->rx_cur) {
+		adb_request_free(dev->rx_cur, dev->ep_out);
+		dev->rx_cur = NULL;
+	}
+	while ((req = req_get(dev, &dev->rx_done)))
+		adb_request_free(req, dev->ep_out);
+	while ((req = req_get(dev, &dev->rx_idle)))
+		adb_request_free(req, dev->ep_out);
 	while ((req = req_get(dev, &dev->tx_idle)))
 		adb_request_free(req, dev->ep_in);
 
@@ -530,6 +790,7 @@ adb_function_unbind(struct usb_configuration *c, struct usb_function *f)
 	dev->error = 1;
 	spin_unlock_irq(&dev->lock);
 
+	device_remove_file(adb_device.this_device, &dev_attr_stats);
 	misc_deregister(&adb_device);
 	misc_deregister(&adb_enable_device);
 	kfree(_adb_dev);
@@ -565,6 +826,16 @@ static int adb_function_set_alt(struct usb_function *f,
 	}
 	dev->ep_out->driver_data = dev;
 
+	/*
+	 * Drop anything received before the last disconnect.  A reader may
+	 * still be copying out of rx_cur, so leave that one for it to give
+	 * back.
+	 */
+	spin_lock_irq(&dev->lock);
+	dev->rx_stale = 1;
+	list_splice_tail_init(&dev->rx_done, &dev->rx_idle);
+	spin_unlock_irq(&dev->lock);
+
 	dev->online = 1;
 
 	/* readers may be blocked waiting for us to go online */
@@ -585,6 +856,7 @@ static void adb_function_disable(struct usb_function *f)
 
 	/* readers may be blocked waiting for us to go online */
 	wake_up(&dev->read_wq);
+	wake_up(&dev->write_wq);
 
 	VDBG(cdev, "%s disabled\n", dev->function.name);
 }
@@ -610,6 +882,9 @@ static int adb_bind_config(struct usb_configuration *c)
 	atomic_set(&dev->write_excl, 0);
 
 	INIT_LIST_HEAD(&dev->tx_idle);
+	INIT_LIST_HEAD(&dev->rx_idle);
+	INIT_LIST_HEAD(&dev->rx_queued);
+	INIT_LIST_HEAD(&dev->rx_done);
 
 	dev->cdev = c->cdev;
 	dev->function.name = "adb";
@@ -629,18 +904,23 @@ static int adb_bind_config(struct usb_configuration *c)
 	ret = misc_register(&adb_device);
 	if (ret)
 		goto err1;
-	ret = misc_register(&adb_enable_device);
+	ret = device_create_file(adb_device.this_device, &dev_attr_stats);
 	if (ret)
 		goto err2;
+	ret = misc_register(&adb_enable_device);
+	if (ret)
+		goto err3;
 
 	ret = usb_add_function(c, &dev->function);
 	if (ret)
-		goto err3;
+		goto err4;
 
 	return 0;
 
-err3:
+err4:
 	misc_deregister(&adb_enable_device);
+err3:
+	device_remove_file(adb_device.this_device, &dev_attr_stats);
 err2:
 	misc_deregister(&adb_device);
 err1:
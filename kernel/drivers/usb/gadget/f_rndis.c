@@ -112,6 +112,21 @@
 	printk(KERN_INFO "[f_rndis] %s:%d "fmt, __func__, __LINE__, ##args)
 #endif
 
+/*
+ * Multi-packet transfers.  Device-to-host aggregation is bounded by the
+ * host's MaxTransferSize from REMOTE_NDIS_INITIALIZE_MSG; host-to-device
+ * aggregation is what we advertise in MaxPacketsPerTransfer.
+ */
+static unsigned int rndis_dl_max_pkt_per_xfer = 3;
+module_param(rndis_dl_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_dl_max_pkt_per_xfer,
+		"Maximum packets per device-to-host transfer");
+
+static unsigned int rndis_ul_max_pkt_per_xfer = 1;
+module_param(rndis_ul_max_pkt_per_xfer, uint, S_IRUGO);
+MODULE_PARM_DESC(rndis_ul_max_pkt_per_xfer,
+		"Maximum packets per host-to-device transfer");
+
 struct rndis_ep_descs {
 	struct usb_endpoint_descriptor	*in;
 	struct usb_endpoint_descriptor	*out;
@@ -689,6 +704,9 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 
 		rndis_set_param_dev(rndis->config, net,
 				&rndis->port.cdc_filter);
+		rndis_set_param_xfer(rndis->config,
+				rndis->port.ul_max_pkts_per_xfer,
+				&rndis->port.dl_max_xfer_size);
 	} else
 		goto fail;
 
@@ -1088,6 +1106,8 @@ rndis_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN])
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
+	rndis->port.dl_max_pkts_per_xfer = rndis_dl_max_pkt_per_xfer;
+	rndis->port.ul_max_pkts_per_xfer = rndis_ul_max_pkt_per_xfer;
 
 	rndis->port.func.name = "rndis";
 	rndis->port.func.strings = rndis_strings;
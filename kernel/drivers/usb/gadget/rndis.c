@@ -585,16 +585,22 @@ static int rndis_init_response (int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32 (RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32 (RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32 (RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32 (1);
+	resp->MaxPacketsPerTransfer = cpu_to_le32 (
+		max_t(u32, params->max_pkt_per_xfer, 1));
 	resp->MaxTransferSize = cpu_to_le32 (
-		  params->dev->mtu
+		  max_t(u32, params->max_pkt_per_xfer, 1)
+		* (params->dev->mtu
 		+ sizeof (struct ethhdr)
 		+ sizeof (struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32 (0);
 	resp->AFListOffset = cpu_to_le32 (0);
 	resp->AFListSize = cpu_to_le32 (0);
 
+	/* the host's limit bounds how many packets we may send at once */
+	if (params->dl_max_xfer_size)
+		*params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	params->resp_avail(params->v);
 	return 0;
 }
@@ -781,6 +787,8 @@ void rndis_uninit (int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params [configNr].state = RNDIS_UNINITIALIZED;
+	if (rndis_per_dev_params [configNr].dl_max_xfer_size)
+		*rndis_per_dev_params [configNr].dl_max_xfer_size = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -936,6 +944,18 @@ int rndis_set_param_dev(u8 configNr, struct net_device *dev, u16 *cdc_filter)
 	return 0;
 }
 
+int rndis_set_param_xfer (u8 configNr, u32 max_pkt_per_xfer,
+			  u32 *dl_max_xfer_size)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params [configNr].max_pkt_per_xfer = max_pkt_per_xfer;
+	rndis_per_dev_params [configNr].dl_max_xfer_size = dl_max_xfer_size;
+
+	return 0;
+}
+
 int rndis_set_param_vendor (u8 configNr, u32 vendorID, const char *vendorDescr)
 {
 	pr_debug("%s:\n", __func__);
@@ -1031,16 +1051,53 @@ int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32		*tmp = (void *) skb->data;
+	struct sk_buff	*skb2;
+	__le32		*tmp;
+	u32		msg_len;
+	int		first = 1;
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
+	/*
+	 * A transfer may hold several REMOTE_NDIS_PACKET_MSGs back to back
+	 * (up to MaxPacketsPerTransfer); all but the last are split off as
+	 * clones sharing the receive buffer.
+	 */
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		tmp = (void *) skb->data;
+
+		/* MessageType, MessageLength */
+		if (skb->len < sizeof(struct rndis_packet_msg_type)
+				|| cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+					!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			/* anything after the first message is padding */
+			return first ? -EINVAL : 0;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+		first = 0;
+
+		if (msg_len < sizeof(struct rndis_packet_msg_type)
+				|| msg_len >= skb->len)
+			break;
+
+		skb2 = skb_clone(skb, GFP_ATOMIC);
+		if (!skb2) {
+			dev_kfree_skb_any(skb);
+			return -ENOMEM;
+		}
+		skb_trim(skb2, msg_len);
+		skb_pull(skb, msg_len);
+
+		/* DataOffset, DataLength */
+		if (!skb_pull(skb2, get_unaligned_le32(tmp++) + 8)) {
+			dev_kfree_skb_any(skb2);
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
+		skb_trim(skb2, get_unaligned_le32(tmp++));
+
+		skb_queue_tail(list, skb2);
 	}
-	tmp++;
 
 	/* DataOffset, DataLength */
 	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
@@ -234,6 +234,10 @@ typedef struct rndis_params
 	u16			*filter;
 	struct net_device	*dev;
 
+	/* multi-packet transfers: what we accept, and what the host does */
+	u32			max_pkt_per_xfer;
+	u32			*dl_max_xfer_size;
+
 	u32			vendorID;
 	const char		*vendorDescr;
 	void			(*resp_avail)(void *v);
@@ -250,6 +254,8 @@ int  rndis_set_param_dev (u8 configNr, struct net_device *dev,
 int  rndis_set_param_vendor (u8 configNr, u32 vendorID,
 			    const char *vendorDescr);
 int  rndis_set_param_medium (u8 configNr, u32 medium, u32 speed);
+int  rndis_set_param_xfer (u8 configNr, u32 max_pkt_per_xfer,
+			  u32 *dl_max_xfer_size);
 void rndis_add_hdr (struct sk_buff *skb);
 int rndis_rm_hdr(struct gether *port, struct sk_buff *skb,
 			struct sk_buff_head *list);
@@ -84,6 +84,32 @@ struct eth_dev {
 
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* multi-packet transfers, see eth_xmit_multi() */
+	unsigned		dl_max_pkts;
+	unsigned		ul_max_pkts;
+	unsigned		tx_req_bufsize;
+	struct usb_request	*tx_held_req;	/* partially filled */
+	unsigned		tx_held_pkts;
+
+	/* transfer batching statistics, reported by "ethtool -S" */
+	struct {
+		u64		tx_xfers;
+		u64		tx_xfer_pkts;
+		u64		tx_max_pkts;
+		u64		rx_xfers;
+		u64		rx_xfer_pkts;
+		u64		rx_max_pkts;
+	} batch;
+};
+
+static const char eth_batch_strings[][ETH_GSTRING_LEN] = {
+	"tx_xfers",
+	"tx_xfer_pkts",
+	"tx_max_pkts_per_xfer",
+	"rx_xfers",
+	"rx_xfer_pkts",
+	"rx_max_pkts_per_xfer",
 };
 
 /*-------------------------------------------------------------------------*/
@@ -103,6 +129,20 @@ MODULE_PARM_DESC(qmult, "queue length multiplier at high speed");
 #define qmult		1
 #endif
 
+/* a partially filled multi-packet transfer is held back (for more packets
+ * to be added) only while at least this many transfers are in flight; the
+ * completion of one of those sends it.
+ */
+static unsigned tx_hold_qlen = 1;
+module_param(tx_hold_qlen, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_hold_qlen,
+	"in-flight transfers needed to hold back a multi-packet transfer");
+
+static inline unsigned hold_qlen(void)
+{
+	return max(tx_hold_qlen, 1U);
+}
+
 /* for dual-speed hardware, use deeper queues at highspeed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -186,9 +226,41 @@ static void eth_get_drvinfo(struct net_device *net, struct ethtool_drvinfo *p)
  *   - ... probably more ethtool ops
  */
 
+static int eth_get_sset_count(struct net_device *net, int sset)
+{
+	switch (sset) {
+	case ETH_SS_STATS:
+		return ARRAY_SIZE(eth_batch_strings);
+	default:
+		return -EOPNOTSUPP;
+	}
+}
+
+static void eth_get_strings(struct net_device *net, u32 sset, u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, eth_batch_strings, sizeof eth_batch_strings);
+}
+
+static void eth_get_ethtool_stats(struct net_device *net,
+		struct ethtool_stats *stats, u64 *data)
+{
+	struct eth_dev	*dev = netdev_priv(net);
+
+	data[0] = dev->batch.tx_xfers;
+	data[1] = dev->batch.tx_xfer_pkts;
+	data[2] = dev->batch.tx_max_pkts;
+	data[3] = dev->batch.rx_xfers;
+	data[4] = dev->batch.rx_xfer_pkts;
+	data[5] = dev->batch.rx_max_pkts;
+}
+
 static const struct ethtool_ops ops = {
 	.get_drvinfo = eth_get_drvinfo,
 	.get_link = ethtool_op_get_link,
+	.get_sset_count = eth_get_sset_count,
+	.get_strings = eth_get_strings,
+	.get_ethtool_stats = eth_get_ethtool_stats,
 };
 
 static void defer_kevent(struct eth_dev *dev, int flag)
@@ -237,6 +309,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->ul_max_pkts > 1)
+		size *= dev->ul_max_pkts;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -282,6 +356,7 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	struct sk_buff	*skb = req->context, *skb2;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
+	unsigned	frames = 0;
 
 	switch (status) {
 
@@ -327,6 +402,7 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 			skb2->protocol = eth_type_trans(skb2, dev->net);
 			dev->net->stats.rx_packets++;
 			dev->net->stats.rx_bytes += skb2->len;
+			frames++;
 
 			/* no buffer copies needed, unless hardware can't
 			 * use skb buffers.
@@ -335,6 +411,11 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 next_frame:
 			skb2 = skb_dequeue(&dev->rx_frames);
 		}
+
+		dev->batch.rx_xfers++;
+		dev->batch.rx_xfer_pkts += frames;
+		if (frames > dev->batch.rx_max_pkts)
+			dev->batch.rx_max_pkts = frames;
 		break;
 
 	/* software-driven interface shutdown */
@@ -433,6 +514,47 @@ done:
 	return status;
 }
 
+/* give each tx request its own buffer, for packing several packets */
+static int alloc_tx_buffers(struct eth_dev *dev)
+{
+	struct usb_request	*req;
+	unsigned		size;
+
+	/* one spare byte for padding away from a maxpacket multiple */
+	size = dev->dl_max_pkts
+		* (dev->net->mtu + ETH_HLEN + dev->header_len) + 1;
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		req->buf = kmalloc(size, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+	}
+	dev->tx_req_bufsize = size;
+	spin_unlock(&dev->req_lock);
+	return 0;
+
+fail:
+	list_for_each_entry_continue_reverse(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+	DBG(dev, "can't alloc %u byte tx buffers\n", size);
+	return -ENOMEM;
+}
+
+/* drop a held multi-packet transfer, caller holds req_lock */
+static void tx_drop_held(struct eth_dev *dev)
+{
+	if (!dev->tx_held_req)
+		return;
+	dev->net->stats.tx_dropped += dev->tx_held_pkts;
+	list_add(&dev->tx_held_req->list, &dev->tx_reqs);
+	dev->tx_held_req = NULL;
+	dev->tx_held_pkts = 0;
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -469,11 +591,17 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_queue_multi(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, unsigned pkts);
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*held = NULL;
+	unsigned		held_pkts = 0;
 
+	/* multi-packet transfers carry no skb; they were counted when sent */
 	switch (req->status) {
 	default:
 		dev->net->stats.tx_errors++;
@@ -483,25 +611,160 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		if (skb)
+			dev->net->stats.tx_bytes += skb->len;
 	}
-	dev->net->stats.tx_packets++;
+	if (skb)
+		dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	atomic_dec(&dev->tx_qlen);
+	/* a held transfer goes out once enough of those ahead are done */
+	if (dev->tx_held_req && atomic_read(&dev->tx_qlen) < hold_qlen()) {
+		held = dev->tx_held_req;
+		held_pkts = dev->tx_held_pkts;
+		dev->tx_held_req = NULL;
+		dev->tx_held_pkts = 0;
+	}
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+	if (skb)
+		dev_kfree_skb_any(skb);
+
+	if (held)
+		tx_queue_multi(dev, ep, held, held_pkts);
 
-	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
 		netif_wake_queue(dev->net);
 }
 
+static void tx_queue_multi(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req, unsigned pkts)
+{
+	unsigned	length = req->length;
+	unsigned long	flags;
+	int		retval;
+
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->no_interrupt = 0;
+
+	/* same short packet rules as for single packet transfers; the
+	 * framing allows a trailing pad byte
+	 */
+	if (dev->zlp)
+		req->zero = 1;
+	else if ((req->length % in->maxpacket) == 0)
+		req->length++;
+
+	atomic_inc(&dev->tx_qlen);
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (retval) {
+		DBG(dev, "tx queue err %d\n", retval);
+		atomic_dec(&dev->tx_qlen);
+		dev->net->stats.tx_dropped += pkts;
+		spin_lock_irqsave(&dev->req_lock, flags);
+		if (list_empty(&dev->tx_reqs))
+			netif_start_queue(dev->net);
+		list_add(&req->list, &dev->tx_reqs);
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return;
+	}
+
+	dev->net->trans_start = jiffies;
+	dev->net->stats.tx_packets += pkts;
+	dev->net->stats.tx_bytes += length;
+	dev->batch.tx_xfers++;
+	dev->batch.tx_xfer_pkts += pkts;
+	if (pkts > dev->batch.tx_max_pkts)
+		dev->batch.tx_max_pkts = pkts;
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * Multi-packet transmit:  framed packets are copied back to back into the
+ * request's own buffer.  While earlier transfers are still in flight the
+ * request is held back so that following packets can join it; it is sent
+ * once full, or from tx_complete() when the queue drains.  A held request
+ * always has room for one more packet.
+ */
+static netdev_tx_t eth_xmit_multi(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in, unsigned xfer_max)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	unsigned long		flags;
+	unsigned		frame_max;
+	unsigned		pkts;
+	bool			hold;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!dev->tx_held_req && list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	if (dev->wrap) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (dev->port_usb)
+			skb = dev->wrap(dev->port_usb, skb);
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (!skb) {
+			net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+	}
+
+	frame_max = net->mtu + ETH_HLEN + dev->header_len;
+	if (xfer_max > dev->tx_req_bufsize - 1)
+		xfer_max = dev->tx_req_bufsize - 1;
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_held_req;
+	if (!req) {
+		if (unlikely(list_empty(&dev->tx_reqs))) {
+			spin_unlock_irqrestore(&dev->req_lock, flags);
+			dev_kfree_skb_any(skb);
+			net->stats.tx_dropped++;
+			return NETDEV_TX_OK;
+		}
+		req = container_of(dev->tx_reqs.next,
+				struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		dev->tx_held_pkts = 0;
+	}
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	pkts = ++dev->tx_held_pkts;
+
+	hold = pkts < dev->dl_max_pkts
+		&& req->length + frame_max <= xfer_max
+		&& atomic_read(&dev->tx_qlen) >= hold_qlen();
+	if (hold) {
+		dev->tx_held_req = req;
+	} else {
+		dev->tx_held_req = NULL;
+		dev->tx_held_pkts = 0;
+		/* temporarily stop TX queue when the freelist empties */
+		if (list_empty(&dev->tx_reqs))
+			netif_stop_queue(net);
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+
+	if (!hold)
+		tx_queue_multi(dev, in, req, pkts);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -512,14 +775,17 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	u32			xfer_max;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		xfer_max = dev->port_usb->dl_max_xfer_size;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
+		xfer_max = 0;
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
@@ -550,6 +816,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_req_bufsize)
+		return eth_xmit_multi(dev, skb, in, xfer_max);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -618,6 +887,11 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 
 	req->length = length;
 
+	dev->batch.tx_xfers++;
+	dev->batch.tx_xfer_pkts++;
+	if (!dev->batch.tx_max_pkts)
+		dev->batch.tx_max_pkts = 1;
+
 	/* throttle highspeed IRQ rate back slightly */
 	if (gadget_is_dualspeed(dev->gadget))
 		req->no_interrupt = (dev->gadget->speed == USB_SPEED_HIGH)
@@ -687,6 +961,10 @@ static int eth_stop(struct net_device *net)
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
 
+	spin_lock_irqsave(&dev->req_lock, flags);
+	tx_drop_held(dev);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
 		dev->net->stats.rx_errors, dev->net->stats.tx_errors
@@ -928,6 +1206,12 @@ struct net_device *gether_connect(struct gether *link)
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
 
+		/* multi-packet transfers only make sense with framing */
+		dev->dl_max_pkts = link->wrap ? link->dl_max_pkts_per_xfer : 0;
+		dev->ul_max_pkts = link->unwrap ? link->ul_max_pkts_per_xfer : 0;
+		if (dev->dl_max_pkts > 1 && alloc_tx_buffers(dev) < 0)
+			dev->dl_max_pkts = 0;
+
 		spin_lock(&dev->lock);
 		dev->port_usb = link;
 		link->ioport = dev;
@@ -988,15 +1272,19 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	tx_drop_held(dev);
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_req_bufsize)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_req_bufsize = 0;
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in = NULL;
@@ -1017,6 +1305,8 @@ void gether_disconnect(struct gether *link)
 	link->out = NULL;
 
 	/* finish forgetting about this USB link episode */
+	dev->dl_max_pkts = 0;
+	dev->ul_max_pkts = 0;
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
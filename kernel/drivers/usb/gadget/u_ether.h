@@ -62,6 +62,14 @@ struct gether {
 
 	/* hooks for added framing, as needed for RNDIS and EEM. */
 	u32				header_len;
+
+	/* framing that packs several packets per transfer, as RNDIS can;
+	 * zero or one means one packet per transfer.  dl_max_xfer_size is
+	 * the host's limit on device-to-host transfers, if it told us.
+	 */
+	u32				dl_max_pkts_per_xfer;
+	u32				ul_max_pkts_per_xfer;
+	u32				dl_max_xfer_size;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
@@ -883,6 +883,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
 #define EXT4_MOUNT_I_VERSION            0x2000000 /* i_version support */
+#define EXT4_MOUNT_FAST_FSYNC		0x4000000 /* fsync skips timestamps */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1016,6 +1017,9 @@ struct ext4_super_block {
 #define EXT4_MF_MNTDIR_SAMPLED	0x0001
 #define EXT4_MF_FS_ABORTED	0x0002	/* Fatal error detected */
 
+/* fsync latency buckets: < 1ms, then powers of two up to >= 256ms */
+#define EXT4_FSYNC_HIST_BUCKETS	10
+
 /*
  * fourth extended-fs super-block data in memory
  */
@@ -1145,6 +1149,21 @@ struct ext4_sb_info {
 
 	/* workqueue for dio unwritten */
 	struct workqueue_struct *dio_unwritten_wq;
+
+	/* freed extents waiting to be discarded, see mballoc.c */
+	spinlock_t s_discard_lock;
+	struct rb_root s_discard_root;
+	unsigned long s_discard_pending;	/* in blocks */
+	struct delayed_work s_discard_work;
+	unsigned long s_discard_last_ios;
+	unsigned int s_discard_idle_ms;
+	/* discard statistics */
+	u64 s_discard_bytes;
+	u64 s_discard_ns;
+
+	/* fsync latency histograms, see fsync.c */
+	spinlock_t s_fsync_lock;
+	unsigned int s_fsync_hist[2][EXT4_FSYNC_HIST_BUCKETS];
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1522,6 +1541,7 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 
 /* fsync.c */
 extern int ext4_sync_file(struct file *, int);
+extern const struct file_operations ext4_fsync_latency_fops;
 
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
@@ -1560,6 +1580,7 @@ extern int ext4_mb_add_groupinfo(struct super_block *sb,
 extern int ext4_mb_get_buddy_cache_lock(struct super_block *, ext4_group_t);
 extern void ext4_mb_put_buddy_cache_lock(struct super_block *,
 						ext4_group_t, int);
+extern int ext4_trim_fs(struct super_block *, struct fstrim_range *);
 /* inode.c */
 struct buffer_head *ext4_getblk(handle_t *, struct inode *,
 						ext4_lblk_t, int, int *);
@@ -28,6 +28,11 @@
 #include <linux/writeback.h>
 #include <linux/jbd2.h>
 #include <linux/blkdev.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
 
 #include "ext4.h"
 #include "ext4_jbd2.h"
@@ -57,6 +62,26 @@ static void ext4_sync_parent(struct inode *inode)
 	}
 }
 
+/*
+ * Account an fsync in the latency histogram of its filesystem, split by
+ * whether it had to wait for a journal commit
+ */
+static void ext4_fsync_account(struct super_block *sb, ktime_t start,
+			       int commit)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = 0;
+
+	if (us >= USEC_PER_MSEC)
+		bucket = min(ilog2((u32)div_u64(us, USEC_PER_MSEC)) + 1,
+			     EXT4_FSYNC_HIST_BUCKETS - 1);
+
+	spin_lock(&sbi->s_fsync_lock);
+	sbi->s_fsync_hist[commit][bucket]++;
+	spin_unlock(&sbi->s_fsync_lock);
+}
+
 /*
  * akpm: A new design for ext4_sync_file().
  *
@@ -76,7 +101,8 @@ int ext4_sync_file(struct file *file, int datasync)
 	struct inode *inode = file->f_mapping->host;
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	journal_t *journal = EXT4_SB(inode->i_sb)->s_journal;
-	int ret;
+	ktime_t start = ktime_get();
+	int ret, commit = 0;
 	tid_t commit_tid;
 
 	J_ASSERT(ext4_journal_current_handle() == NULL);
@@ -94,7 +120,7 @@ int ext4_sync_file(struct file *file, int datasync)
 		ret = generic_file_fsync(file, datasync);
 		if (!ret && !list_empty(&inode->i_dentry))
 			ext4_sync_parent(inode);
-		return ret;
+		goto out;
 	}
 
 	/*
@@ -111,11 +137,15 @@ int ext4_sync_file(struct file *file, int datasync)
 	 *  (they were dirtied by commit).  But that's OK - the blocks are
 	 *  safe in-journal, which is all fsync() needs to ensure.
 	 */
-	if (ext4_should_journal_data(inode))
-		return ext4_force_commit(inode->i_sb);
+	if (ext4_should_journal_data(inode)) {
+		ret = ext4_force_commit(inode->i_sb);
+		commit = 1;
+		goto out;
+	}
 
 	commit_tid = datasync ? ei->i_datasync_tid : ei->i_sync_tid;
 	if (jbd2_log_start_commit(journal, commit_tid)) {
+		commit = 1;
 		/*
 		 * When the journal is on a different device than the
 		 * fs data disk, we need to issue the barrier in
@@ -133,5 +163,62 @@ int ext4_sync_file(struct file *file, int datasync)
 	} else if (journal->j_flags & JBD2_BARRIER)
 		blkdev_issue_flush(inode->i_sb->s_bdev, GFP_KERNEL, NULL,
 			BLKDEV_IFL_WAIT);
+out:
+	ext4_fsync_account(inode->i_sb, start, commit);
 	return ret;
 }
+
+static int ext4_fsync_latency_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int hist[2][EXT4_FSYNC_HIST_BUCKETS];
+	int i;
+
+	spin_lock(&sbi->s_fsync_lock);
+	memcpy(hist, sbi->s_fsync_hist, sizeof(hist));
+	spin_unlock(&sbi->s_fsync_lock);
+
+	seq_printf(seq, "%-8s %10s %10s\n", "ms", "commit", "no_commit");
+	for (i = 0; i < EXT4_FSYNC_HIST_BUCKETS; i++) {
+		char range[16];
+
+		if (i == EXT4_FSYNC_HIST_BUCKETS - 1)
+			snprintf(range, sizeof(range), ">=%u", 1 << (i - 1));
+		else
+			snprintf(range, sizeof(range), "<%u", 1 << i);
+		seq_printf(seq, "%-8s %10u %10u\n", range, hist[1][i],
+			   hist[0][i]);
+	}
+
+	return 0;
+}
+
+static int ext4_fsync_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_fsync_latency_show, PDE(inode)->data);
+}
+
+/* Any write clears the histograms */
+static ssize_t ext4_fsync_latency_write(struct file *file,
+					const char __user *buf,
+					size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct ext4_sb_info *sbi = EXT4_SB((struct super_block *)seq->private);
+
+	spin_lock(&sbi->s_fsync_lock);
+	memset(sbi->s_fsync_hist, 0, sizeof(sbi->s_fsync_hist));
+	spin_unlock(&sbi->s_fsync_lock);
+
+	return count;
+}
+
+const struct file_operations ext4_fsync_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_fsync_latency_open,
+	.read		= seq_read,
+	.write		= ext4_fsync_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
@@ -5246,13 +5246,19 @@ static int ext4_do_update_inode(handle_t *handle,
 	struct ext4_inode *raw_inode = ext4_raw_inode(iloc);
 	struct ext4_inode_info *ei = EXT4_I(inode);
 	struct buffer_head *bh = iloc->bh;
-	int err = 0, rc, block;
+	struct ext4_inode old;
+	int fast_fsync = test_opt(inode->i_sb, FAST_FSYNC) &&
+			 S_ISREG(inode->i_mode);
+	int err = 0, rc, block, need_datasync = 0;
 
 	/* For fields not not tracking in the in-memory inode,
 	 * initialise them to zero for new inodes. */
 	if (ext4_test_inode_state(inode, EXT4_STATE_NEW))
 		memset(raw_inode, 0, EXT4_SB(inode->i_sb)->s_inode_size);
 
+	if (fast_fsync)
+		memcpy(&old, raw_inode, EXT4_GOOD_OLD_INODE_SIZE);
+
 	ext4_get_inode_flags(ei);
 	raw_inode->i_mode = cpu_to_le16(inode->i_mode);
 	if (!(test_opt(inode->i_sb, NO_UID32))) {
@@ -5295,7 +5301,10 @@ static int ext4_do_update_inode(handle_t *handle,
 		raw_inode->i_file_acl_high =
 			cpu_to_le16(ei->i_file_acl >> 32);
 	raw_inode->i_file_acl_lo = cpu_to_le32(ei->i_file_acl);
-	ext4_isize_set(raw_inode, ei->i_disksize);
+	if (ext4_isize(raw_inode) != ei->i_disksize) {
+		ext4_isize_set(raw_inode, ei->i_disksize);
+		need_datasync = 1;
+	}
 	if (ei->i_disksize > 0x7fffffffULL) {
 		struct super_block *sb = inode->i_sb;
 		if (!EXT4_HAS_RO_COMPAT_FEATURE(sb,
@@ -5348,7 +5357,21 @@ static int ext4_do_update_inode(handle_t *handle,
 		err = rc;
 	ext4_clear_inode_state(inode, EXT4_STATE_NEW);
 
-	ext4_update_inode_fsync_trans(handle, inode, 0);
+	/*
+	 * With fast_fsync, fsync() on a regular file does not wait for a
+	 * transaction which only updated the timestamps of the inode: they
+	 * reach the disk with the next periodic commit.  Directories always
+	 * commit, and xattr changes record their own transaction.
+	 */
+	if (fast_fsync) {
+		old.i_atime = raw_inode->i_atime;
+		old.i_ctime = raw_inode->i_ctime;
+		old.i_mtime = raw_inode->i_mtime;
+		old.i_disk_version = raw_inode->i_disk_version;
+		if (!memcmp(&old, raw_inode, EXT4_GOOD_OLD_INODE_SIZE))
+			goto out_brelse;
+	}
+	ext4_update_inode_fsync_trans(handle, inode, need_datasync);
 out_brelse:
 	brelse(bh);
 	ext4_std_error(inode->i_sb, err);
@@ -338,11 +338,15 @@
 static struct kmem_cache *ext4_pspace_cachep;
 static struct kmem_cache *ext4_ac_cachep;
 static struct kmem_cache *ext4_free_ext_cachep;
+static struct kmem_cache *ext4_discard_cachep;
+static struct workqueue_struct *ext4_discard_wq;
 static void ext4_mb_generate_from_pa(struct super_block *sb, void *bitmap,
 					ext4_group_t group);
 static void ext4_mb_generate_from_freelist(struct super_block *sb, void *bitmap,
 						ext4_group_t group);
 static void release_blocks_on_commit(journal_t *journal, transaction_t *txn);
+static void ext4_discard_work(struct work_struct *work);
+static void ext4_discard_drop(struct ext4_sb_info *sbi);
 
 static inline void *mb_correct_addr_and_bit(int *bit, void *addr)
 {
@@ -2476,6 +2480,11 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
 
+	spin_lock_init(&sbi->s_discard_lock);
+	sbi->s_discard_root = RB_ROOT;
+	INIT_DELAYED_WORK(&sbi->s_discard_work, ext4_discard_work);
+	sbi->s_discard_idle_ms = MB_DEFAULT_DISCARD_IDLE_MS;
+
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
 	return 0;
@@ -2507,6 +2516,9 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_group_info *grinfo;
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 
+	cancel_delayed_work_sync(&sbi->s_discard_work);
+	ext4_discard_drop(sbi);
+
 	if (sbi->s_group_info) {
 		for (i = 0; i < ngroups; i++) {
 			grinfo = ext4_get_group_info(sb, i);
@@ -2560,6 +2572,325 @@ int ext4_mb_release(struct super_block *sb)
 	return 0;
 }
 
+/*
+ * Batched discard
+ *
+ * With -o discard the blocks freed by a transaction are not discarded in
+ * the commit callback, where every discard would hold up the commit and
+ * the writes queued behind it, but recorded in s_discard_root, in which
+ * adjacent extents are merged.  s_discard_work hands them to the device
+ * in large requests once it has seen no I/O for s_discard_idle_ms.
+ *
+ * A recorded extent may have been reallocated by then: only the blocks
+ * still free in the buddy bitmap are discarded, and they are marked in
+ * use while the discard is in flight.  FITRIM (ext4_trim_fs()) discards
+ * every free extent of a range the same way.
+ */
+struct ext4_discard_extent {
+	struct rb_node	node;
+	ext4_fsblk_t	start;
+	ext4_fsblk_t	count;
+};
+
+static int ext4_issue_discard(struct super_block *sb, ext4_group_t group,
+			      ext4_grpblk_t start, ext4_grpblk_t count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_fsblk_t block = ext4_group_first_block_no(sb, group) + start;
+	ktime_t t0 = ktime_get();
+	int ret;
+
+	trace_ext4_discard_blocks(sb, (unsigned long long)block, count);
+	ret = sb_issue_discard(sb, block, count);
+	if (ret)
+		return ret;
+
+	spin_lock(&sbi->s_discard_lock);
+	sbi->s_discard_bytes += (u64)count << sb->s_blocksize_bits;
+	sbi->s_discard_ns += ktime_to_ns(ktime_sub(ktime_get(), t0));
+	spin_unlock(&sbi->s_discard_lock);
+	return 0;
+}
+
+/*
+ * Discard the free extents of at least @minblocks blocks between @start
+ * and @end in @group.  The number of blocks discarded is added to
+ * @trimmed.
+ */
+static int ext4_trim_group(struct super_block *sb, ext4_group_t group,
+			   ext4_grpblk_t start, ext4_grpblk_t end,
+			   ext4_grpblk_t minblocks, ext4_fsblk_t *trimmed)
+{
+	struct ext4_buddy e4b;
+	struct ext4_free_extent ex;
+	ext4_grpblk_t next;
+	int ret;
+
+	ret = ext4_mb_load_buddy(sb, group, &e4b);
+	if (ret)
+		return ret;
+
+	ext4_lock_group(sb, group);
+	while (start < end && e4b.bd_info->bb_free >= minblocks) {
+		start = mb_find_next_zero_bit(e4b.bd_bitmap, end, start);
+		if (start >= end)
+			break;
+		next = mb_find_next_bit(e4b.bd_bitmap, end, start);
+
+		if (next - start >= minblocks) {
+			ex.fe_group = group;
+			ex.fe_start = start;
+			ex.fe_len = next - start;
+			/* nobody may allocate them while they are discarded */
+			mb_mark_used(&e4b, &ex);
+			ext4_unlock_group(sb, group);
+
+			ret = ext4_issue_discard(sb, group, start, next - start);
+
+			ext4_lock_group(sb, group);
+			mb_free_blocks(NULL, &e4b, start, next - start);
+			if (ret)
+				break;
+			*trimmed += next - start;
+		}
+		start = next;
+
+		if (fatal_signal_pending(current)) {
+			ret = -ERESTARTSYS;
+			break;
+		}
+		if (need_resched()) {
+			ext4_unlock_group(sb, group);
+			cond_resched();
+			ext4_lock_group(sb, group);
+		}
+	}
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(&e4b);
+
+	return ret;
+}
+
+/*
+ * Discard the free extents of at least @minblocks blocks in the @count
+ * blocks starting at @start.
+ */
+static int ext4_trim_range(struct super_block *sb, ext4_fsblk_t start,
+			   ext4_fsblk_t count, ext4_grpblk_t minblocks,
+			   ext4_fsblk_t *trimmed)
+{
+	ext4_fsblk_t end = start + count;
+	ext4_group_t group;
+	ext4_grpblk_t first, last;
+	int ret = 0;
+
+	if (start < le32_to_cpu(EXT4_SB(sb)->s_es->s_first_data_block))
+		start = le32_to_cpu(EXT4_SB(sb)->s_es->s_first_data_block);
+	if (end > ext4_blocks_count(EXT4_SB(sb)->s_es))
+		end = ext4_blocks_count(EXT4_SB(sb)->s_es);
+
+	while (start < end && !ret) {
+		ext4_get_group_no_and_offset(sb, start, &group, &first);
+		last = EXT4_BLOCKS_PER_GROUP(sb);
+		if (end - start < last - first)
+			last = first + (end - start);
+
+		ret = ext4_trim_group(sb, group, first, last, minblocks,
+				      trimmed);
+		start += last - first;
+	}
+
+	return ret;
+}
+
+/* Called with s_discard_lock held */
+static void ext4_discard_merge(struct ext4_sb_info *sbi,
+			       struct ext4_discard_extent *de)
+{
+	struct ext4_discard_extent *n;
+	struct rb_node *node;
+
+	while ((node = rb_prev(&de->node))) {
+		n = rb_entry(node, struct ext4_discard_extent, node);
+		if (n->start + n->count < de->start)
+			break;
+		sbi->s_discard_pending -= n->count + de->count;
+		de->count = max(n->start + n->count, de->start + de->count) -
+			    n->start;
+		de->start = n->start;
+		sbi->s_discard_pending += de->count;
+		rb_erase(node, &sbi->s_discard_root);
+		kmem_cache_free(ext4_discard_cachep, n);
+	}
+
+	while ((node = rb_next(&de->node))) {
+		n = rb_entry(node, struct ext4_discard_extent, node);
+		if (de->start + de->count < n->start)
+			break;
+		sbi->s_discard_pending -= n->count + de->count;
+		de->count = max(n->start + n->count, de->start + de->count) -
+			    de->start;
+		sbi->s_discard_pending += de->count;
+		rb_erase(node, &sbi->s_discard_root);
+		kmem_cache_free(ext4_discard_cachep, n);
+	}
+}
+
+static void ext4_discard_queue(struct super_block *sb, ext4_fsblk_t start,
+			       ext4_fsblk_t count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct rb_node **p = &sbi->s_discard_root.rb_node, *parent = NULL;
+	struct ext4_discard_extent *de, *new;
+
+	/* a discard is only a hint, it is fine to forget one */
+	new = kmem_cache_alloc(ext4_discard_cachep, GFP_NOFS);
+	if (!new)
+		return;
+
+	spin_lock(&sbi->s_discard_lock);
+	while (*p) {
+		parent = *p;
+		de = rb_entry(parent, struct ext4_discard_extent, node);
+		if (start + count < de->start) {
+			p = &parent->rb_left;
+		} else if (start > de->start + de->count) {
+			p = &parent->rb_right;
+		} else {
+			/* adjacent or overlapping, extend the extent */
+			sbi->s_discard_pending -= de->count;
+			de->count = max(start + count, de->start + de->count) -
+				    min(start, de->start);
+			de->start = min(start, de->start);
+			sbi->s_discard_pending += de->count;
+			ext4_discard_merge(sbi, de);
+			spin_unlock(&sbi->s_discard_lock);
+			kmem_cache_free(ext4_discard_cachep, new);
+			return;
+		}
+	}
+
+	new->start = start;
+	new->count = count;
+	rb_link_node(&new->node, parent, p);
+	rb_insert_color(&new->node, &sbi->s_discard_root);
+	sbi->s_discard_pending += count;
+	spin_unlock(&sbi->s_discard_lock);
+}
+
+static void ext4_discard_drop(struct ext4_sb_info *sbi)
+{
+	struct ext4_discard_extent *de;
+	struct rb_node *node;
+
+	spin_lock(&sbi->s_discard_lock);
+	while ((node = rb_first(&sbi->s_discard_root))) {
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		rb_erase(node, &sbi->s_discard_root);
+		kmem_cache_free(ext4_discard_cachep, de);
+	}
+	sbi->s_discard_pending = 0;
+	spin_unlock(&sbi->s_discard_lock);
+}
+
+/*
+ * The whole disk, not only this partition, must have been idle since
+ * the previous call
+ */
+static int ext4_discard_idle(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct hd_struct *part = &sb->s_bdev->bd_disk->part0;
+	unsigned long ios;
+	int idle;
+
+	ios = part_stat_read(part, ios[READ]) +
+	      part_stat_read(part, ios[WRITE]);
+	idle = ios == sbi->s_discard_last_ios && !part_in_flight(part);
+	sbi->s_discard_last_ios = ios;
+
+	return idle;
+}
+
+static void ext4_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+						struct ext4_sb_info,
+						s_discard_work);
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+	struct ext4_discard_extent *de;
+	struct rb_node *node;
+	ext4_fsblk_t trimmed = 0;
+	int ret;
+
+	if (!test_opt(sb, DISCARD)) {
+		ext4_discard_drop(sbi);
+		return;
+	}
+
+	if (!ext4_discard_idle(sb))
+		goto busy;
+
+	spin_lock(&sbi->s_discard_lock);
+	while ((node = rb_first(&sbi->s_discard_root))) {
+		de = rb_entry(node, struct ext4_discard_extent, node);
+		rb_erase(node, &sbi->s_discard_root);
+		sbi->s_discard_pending -= de->count;
+		spin_unlock(&sbi->s_discard_lock);
+
+		ret = ext4_trim_range(sb, de->start, de->count, 1, &trimmed);
+		kmem_cache_free(ext4_discard_cachep, de);
+		if (ret == -EOPNOTSUPP) {
+			ext4_warning(sb, "discard not supported, disabling");
+			clear_opt(sbi->s_mount_opt, DISCARD);
+			ext4_discard_drop(sbi);
+			return;
+		}
+
+		/* someone else wants the device, wait for it to settle */
+		if (part_in_flight(&sb->s_bdev->bd_disk->part0))
+			goto busy;
+
+		spin_lock(&sbi->s_discard_lock);
+	}
+	spin_unlock(&sbi->s_discard_lock);
+
+	/* do not count the discards as activity */
+	ext4_discard_idle(sb);
+	return;
+
+busy:
+	if (sbi->s_discard_pending)
+		queue_delayed_work(ext4_discard_wq, &sbi->s_discard_work,
+				   msecs_to_jiffies(sbi->s_discard_idle_ms));
+}
+
+/**
+ * ext4_trim_fs() -- discard the free space of a filesystem range
+ * @sb:		superblock of the filesystem
+ * @range:	range in bytes, and minimum length of the extents to discard
+ *
+ * On return @range->len holds the number of bytes discarded.
+ */
+int ext4_trim_fs(struct super_block *sb, struct fstrim_range *range)
+{
+	ext4_fsblk_t start, len, trimmed = 0;
+	ext4_grpblk_t minlen;
+	int ret;
+
+	start = range->start >> sb->s_blocksize_bits;
+	len = range->len >> sb->s_blocksize_bits;
+	if (range->minlen >> sb->s_blocksize_bits > EXT4_BLOCKS_PER_GROUP(sb))
+		return -EINVAL;
+	minlen = max_t(ext4_grpblk_t, 1,
+		       range->minlen >> sb->s_blocksize_bits);
+
+	ret = ext4_trim_range(sb, start, len, minlen, &trimmed);
+	range->len = (u64)trimmed << sb->s_blocksize_bits;
+
+	return ret;
+}
+
 /*
  * This function is called by the jbd2 layer once the commit has finished,
  * so we know we can free the blocks that were released with that commit.
@@ -2579,23 +2910,6 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 		mb_debug(1, "gonna free %u blocks in group %u (0x%p):",
 			 entry->count, entry->group, entry);
 
-		if (test_opt(sb, DISCARD)) {
-			int ret;
-			ext4_fsblk_t discard_block;
-
-			discard_block = entry->start_blk +
-				ext4_group_first_block_no(sb, entry->group);
-			trace_ext4_discard_blocks(sb,
-					(unsigned long long)discard_block,
-					entry->count);
-			ret = sb_issue_discard(sb, discard_block, entry->count);
-			if (ret == EOPNOTSUPP) {
-				ext4_warning(sb,
-					"discard not supported, disabling");
-				clear_opt(EXT4_SB(sb)->s_mount_opt, DISCARD);
-			}
-		}
-
 		err = ext4_mb_load_buddy(sb, entry->group, &e4b);
 		/* we expect to find existing buddy because it's pinned */
 		BUG_ON(err != 0);
@@ -2617,10 +2931,21 @@ static void release_blocks_on_commit(journal_t *journal, transaction_t *txn)
 			page_cache_release(e4b.bd_bitmap_page);
 		}
 		ext4_unlock_group(sb, entry->group);
+
+		if (test_opt(sb, DISCARD))
+			ext4_discard_queue(sb, entry->start_blk +
+				ext4_group_first_block_no(sb, entry->group),
+				entry->count);
+
 		kmem_cache_free(ext4_free_ext_cachep, entry);
 		ext4_mb_unload_buddy(&e4b);
 	}
 
+	if (count2 && test_opt(sb, DISCARD))
+		queue_delayed_work(ext4_discard_wq,
+				   &EXT4_SB(sb)->s_discard_work,
+				   msecs_to_jiffies(EXT4_SB(sb)->s_discard_idle_ms));
+
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
@@ -2685,8 +3010,28 @@ int __init init_ext4_mballoc(void)
 		kmem_cache_destroy(ext4_ac_cachep);
 		return -ENOMEM;
 	}
+
+	ext4_discard_cachep =
+		kmem_cache_create("ext4_discard_extents",
+				     sizeof(struct ext4_discard_extent),
+				     0, SLAB_RECLAIM_ACCOUNT, NULL);
+	if (ext4_discard_cachep == NULL)
+		goto err_free_ext;
+
+	ext4_discard_wq = create_singlethread_workqueue("ext4-discard");
+	if (ext4_discard_wq == NULL)
+		goto err_discard;
+
 	ext4_create_debugfs_entry();
 	return 0;
+
+err_discard:
+	kmem_cache_destroy(ext4_discard_cachep);
+err_free_ext:
+	kmem_cache_destroy(ext4_pspace_cachep);
+	kmem_cache_destroy(ext4_ac_cachep);
+	kmem_cache_destroy(ext4_free_ext_cachep);
+	return -ENOMEM;
 }
 
 void exit_ext4_mballoc(void)
@@ -2699,6 +3044,8 @@ void exit_ext4_mballoc(void)
 	kmem_cache_destroy(ext4_pspace_cachep);
 	kmem_cache_destroy(ext4_ac_cachep);
 	kmem_cache_destroy(ext4_free_ext_cachep);
+	destroy_workqueue(ext4_discard_wq);
+	kmem_cache_destroy(ext4_discard_cachep);
 	ext4_remove_debugfs_entry();
 }
 
@@ -94,6 +94,13 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with -o discard, freed blocks are discarded once the disk has
+ * been idle for that long
+ */
+#define MB_DEFAULT_DISCARD_IDLE_MS	2000
+#define MB_MIN_DISCARD_IDLE_MS		100
+
 
 struct ext4_free_data {
 	/* this links the free block information from group_info */
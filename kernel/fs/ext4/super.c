@@ -675,6 +675,7 @@ static void ext4_put_super(struct super_block *sb)
 		ext4_commit_super(sb, 1);
 	}
 	if (sbi->s_proc) {
+		remove_proc_entry("fsync_latency", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 	kobject_del(&sbi->s_kobj);
@@ -980,6 +981,9 @@ static int ext4_show_options(struct seq_file *seq, struct vfsmount *vfs)
 	if (test_opt(sb, DISCARD))
 		seq_puts(seq, ",discard");
 
+	if (test_opt(sb, FAST_FSYNC))
+		seq_puts(seq, ",fast_fsync");
+
 	if (test_opt(sb, NOLOAD))
 		seq_puts(seq, ",norecovery");
 
@@ -1160,7 +1164,7 @@ enum {
 	Opt_block_validity, Opt_noblock_validity,
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
-	Opt_discard, Opt_nodiscard,
+	Opt_discard, Opt_nodiscard, Opt_fast_fsync, Opt_nofast_fsync,
 };
 
 static const match_table_t tokens = {
@@ -1231,6 +1235,8 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_fast_fsync, "fast_fsync"},
+	{Opt_nofast_fsync, "nofast_fsync"},
 	{Opt_err, NULL},
 };
 
@@ -1693,6 +1699,12 @@ set_qf_format:
 		case Opt_nodiscard:
 			clear_opt(sbi->s_mount_opt, DISCARD);
 			break;
+		case Opt_fast_fsync:
+			set_opt(sbi->s_mount_opt, FAST_FSYNC);
+			break;
+		case Opt_nofast_fsync:
+			clear_opt(sbi->s_mount_opt, FAST_FSYNC);
+			break;
 		case Opt_dioread_nolock:
 			set_opt(sbi->s_mount_opt, DIOREAD_NOLOCK);
 			break;
@@ -2265,6 +2277,38 @@ static ssize_t lifetime_write_kbytes_show(struct ext4_attr *a,
 			  EXT4_SB(sb)->s_sectors_written_start) >> 1)));
 }
 
+static ssize_t discard_kbytes_show(struct ext4_attr *a,
+				   struct ext4_sb_info *sbi, char *buf)
+{
+	u64 bytes;
+
+	spin_lock(&sbi->s_discard_lock);
+	bytes = sbi->s_discard_bytes;
+	spin_unlock(&sbi->s_discard_lock);
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)(bytes >> 10));
+}
+
+static ssize_t discard_time_ms_show(struct ext4_attr *a,
+				    struct ext4_sb_info *sbi, char *buf)
+{
+	u64 ns;
+
+	spin_lock(&sbi->s_discard_lock);
+	ns = sbi->s_discard_ns;
+	spin_unlock(&sbi->s_discard_lock);
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)div_u64(ns, NSEC_PER_MSEC));
+}
+
+static ssize_t discard_pending_blocks_show(struct ext4_attr *a,
+					   struct ext4_sb_info *sbi, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%lu\n", sbi->s_discard_pending);
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2281,6 +2325,23 @@ static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 	return count;
 }
 
+static ssize_t discard_idle_ms_store(struct ext4_attr *a,
+				     struct ext4_sb_info *sbi,
+				     const char *buf, size_t count)
+{
+	unsigned long t;
+
+	if (parse_strtoul(buf, 0xffffffff, &t))
+		return -EINVAL;
+
+	/* the discard work requeues itself after this delay */
+	if (t < MB_MIN_DISCARD_IDLE_MS)
+		return -EINVAL;
+
+	sbi->s_discard_idle_ms = t;
+	return count;
+}
+
 static ssize_t sbi_ui_show(struct ext4_attr *a,
 			   struct ext4_sb_info *sbi, char *buf)
 {
@@ -2321,6 +2382,9 @@ static struct ext4_attr ext4_attr_##name = __ATTR(name, mode, show, store)
 EXT4_RO_ATTR(delayed_allocation_blocks);
 EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
+EXT4_RO_ATTR(discard_kbytes);
+EXT4_RO_ATTR(discard_time_ms);
+EXT4_RO_ATTR(discard_pending_blocks);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
 EXT4_RW_ATTR_SBI_UI(inode_goal, s_inode_goal);
@@ -2331,6 +2395,8 @@ EXT4_RW_ATTR_SBI_UI(mb_order2_req, s_mb_order2_reqs);
 EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
+EXT4_ATTR_OFFSET(discard_idle_ms, 0644, sbi_ui_show,
+		 discard_idle_ms_store, s_discard_idle_ms);
 
 static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(delayed_allocation_blocks),
@@ -2345,6 +2411,10 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_stream_req),
 	ATTR_LIST(mb_group_prealloc),
 	ATTR_LIST(max_writeback_mb_bump),
+	ATTR_LIST(discard_kbytes),
+	ATTR_LIST(discard_time_ms),
+	ATTR_LIST(discard_pending_blocks),
+	ATTR_LIST(discard_idle_ms),
 	NULL,
 };
 
@@ -2770,6 +2840,10 @@ static int ext4_fill_super(struct super_block *sb, void *data, int silent)
 	if (ext4_proc_root)
 		sbi->s_proc = proc_mkdir(sb->s_id, ext4_proc_root);
 #endif
+	spin_lock_init(&sbi->s_fsync_lock);
+	if (sbi->s_proc)
+		proc_create_data("fsync_latency", S_IRUGO | S_IWUSR,
+				 sbi->s_proc, &ext4_fsync_latency_fops, sb);
 
 	bgl_lock_init(sbi->s_blockgroup_lock);
 
@@ -3096,6 +3170,7 @@ failed_mount2:
 	kfree(sbi->s_group_desc);
 failed_mount:
 	if (sbi->s_proc) {
+		remove_proc_entry("fsync_latency", sbi->s_proc);
 		remove_proc_entry(sb->s_id, ext4_proc_root);
 	}
 #ifdef CONFIG_QUOTA
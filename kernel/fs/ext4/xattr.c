@@ -1051,6 +1051,7 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 		if (!value)
 			ext4_clear_inode_state(inode, EXT4_STATE_NO_EXPAND);
 		error = ext4_mark_iloc_dirty(handle, inode, &is.iloc);
+		ext4_update_inode_fsync_trans(handle, inode, 0);
 		/*
 		 * The bh is consumed by ext4_mark_iloc_dirty, even with
 		 * error != 0.
@@ -381,6 +381,9 @@ extern struct cpufreq_governor cpufreq_gov_lionheart;
 #elif defined(CPU_FREQ_DEFAULT_GOV_SMARTASS2)
 extern struct cpufreq_governor cpufreq_gov_smartass2;
 #define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_smartass2)
+#elif defined(CONFIG_CPU_FREQ_DEFAULT_GOV_ENERGYAWARE)
+extern struct cpufreq_governor cpufreq_gov_energyaware;
+#define CPUFREQ_DEFAULT_GOVERNOR	(&cpufreq_gov_energyaware)
 #endif
 
 
@@ -422,6 +425,72 @@ void cpufreq_frequency_table_get_attr(struct cpufreq_frequency_table *table,
 
 void cpufreq_frequency_table_put_attr(unsigned int cpu);
 
+/**
+ * struct cpufreq_power_entry - power drawn by a cpu at one frequency
+ * @frequency:	kHz, CPUFREQ_TABLE_END terminates the table
+ * @active:	power while running at @frequency, mW
+ * @idle:	power while idle (WFI) at @frequency, mW
+ *
+ * Optional energy model used by the energyaware governor.
+ */
+struct cpufreq_power_entry {
+	unsigned int frequency;
+	unsigned int active;
+	unsigned int idle;
+};
+
+void cpufreq_power_table_set(const struct cpufreq_power_entry *table);
+const struct cpufreq_power_entry *cpufreq_power_table_get(void);
+
+
+/*********************************************************************
+ *                       CPU LOAD TRACKING                           *
+ *********************************************************************/
+
+/* Fixed point of the load figures: CPU_LOAD_ONE is one fully busy cpu */
+#define CPU_LOAD_SHIFT		(10)
+#define CPU_LOAD_ONE		(1 << CPU_LOAD_SHIFT)
+
+/**
+ * struct cpu_load_sample - load of a cpu over one period
+ * @load:	fraction of the period the cpu had something to run
+ * @nr:		average number of runnable tasks, same fixed point
+ * @run_ns:	mean run time between two context switches
+ */
+struct cpu_load_sample {
+	unsigned int load;
+	unsigned int nr;
+	u64 run_ns;
+};
+
+struct cpu_load_window_cpu;
+
+/**
+ * struct cpu_load_window - per-cpu load history of one user
+ * @name:	reported in the cpu_load trace event
+ * @depth:	number of periods remembered for cpu_load_trend()
+ *
+ * A period ends each time the owner calls cpu_load_sample(); there is no
+ * timer behind a window, the owner's own sampling work drives it.  Calls
+ * on the same window and cpu must be serialized by the owner.
+ */
+struct cpu_load_window {
+	const char *name;
+	unsigned int depth;
+	struct cpu_load_window_cpu __percpu *cpu;
+};
+
+#ifdef CONFIG_CPU_FREQ_LOAD
+int cpu_load_window_init(struct cpu_load_window *win, const char *name,
+			 unsigned int depth);
+void cpu_load_window_exit(struct cpu_load_window *win);
+void cpu_load_window_reset(struct cpu_load_window *win, int cpu,
+			   unsigned int load);
+int cpu_load_sample(struct cpu_load_window *win, int cpu,
+		    struct cpu_load_sample *sample);
+unsigned int cpu_load_trend(struct cpu_load_window *win, int cpu);
+#endif
+
 
 /*********************************************************************
  *                     UNIFIED DEBUG HELPERS                         *
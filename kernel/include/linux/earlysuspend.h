@@ -29,6 +29,11 @@
  * the suspend handlers have already been called without a matching call to the
  * resume handlers, the suspend handler will be called directly from
  * register_early_suspend. This direct call can violate the normal level order.
+ *
+ * Handlers that set async are called in parallel with the other async
+ * handlers of the same level; all of them are done before any handler of
+ * the next level is called, so a handler depending on another one must
+ * use a higher level (lower for resume).
  */
 enum {
 	EARLY_SUSPEND_LEVEL_BLANK_SCREEN = 50,
@@ -41,6 +46,11 @@ struct early_suspend {
 	int level;
 	void (*suspend)(struct early_suspend *h);
 	void (*resume)(struct early_suspend *h);
+	bool async;
+	/* duration of the last calls, us */
+	u32 suspend_time;
+	u32 resume_time;
+	u32 resume_time_max;
 #endif
 };
 
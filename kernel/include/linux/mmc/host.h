@@ -18,6 +18,7 @@ extern int mmc_is_available;
 
 #include <linux/leds.h>
 #include <linux/sched.h>
+#include <linux/completion.h>
 
 #include <linux/mmc/core.h>
 #include <linux/mmc/pm.h>
@@ -94,6 +95,18 @@ struct mmc_host_ops {
 	 */
 	int (*enable)(struct mmc_host *host);
 	int (*disable)(struct mmc_host *host, int lazy);
+	/*
+	 * It is optional for the host to implement pre_req and post_req in
+	 * order to support double buffering of requests (prepare one
+	 * request while another request is active).
+	 * pre_req() must always be followed by a post_req().
+	 * To undo a call made to pre_req(), call post_req() with
+	 * a nonzero err condition.
+	 */
+	void	(*post_req)(struct mmc_host *host, struct mmc_request *req,
+			    int err);
+	void	(*pre_req)(struct mmc_host *host, struct mmc_request *req,
+			   bool is_first_req);
 	void	(*request)(struct mmc_host *host, struct mmc_request *req);
 	void    (*dump_regs)(struct mmc_host *host);
 	void    (*abort_request)(struct mmc_host *host);
@@ -130,6 +143,30 @@ struct mmc_host_ops {
 struct mmc_card;
 struct device;
 
+struct mmc_async_req {
+	/* active mmc request */
+	struct mmc_request	*mrq;
+	/*
+	 * Check error status of completed mmc request.
+	 * Returns 0 if success otherwise non zero.
+	 */
+	int (*err_check) (struct mmc_card *, struct mmc_async_req *);
+	struct completion	complete;
+};
+
+/* Idle time between two data requests, see mmc_req_stats_start() */
+#define MMC_REQ_GAP_BUCKETS	6
+
+struct mmc_req_stats {
+	unsigned long		reqs;		/* data requests completed */
+	unsigned long		prepared;	/* of which went through pre_req */
+	u64			busy_us;	/* sum of request latencies */
+	u32			max_us;		/* longest request */
+	unsigned long		gaps[MMC_REQ_GAP_BUCKETS];
+	ktime_t			start;		/* of the active request */
+	ktime_t			last_done;
+};
+
 struct mmc_host {
 	struct device		*parent;
 	struct device		class_dev;
@@ -243,6 +280,9 @@ struct mmc_host {
 
 	struct dentry		*debugfs_root;
 
+	struct mmc_async_req	*areq;		/* active async req */
+	struct mmc_req_stats	req_stats;
+
 #ifdef CONFIG_MMC_EMBEDDED_SDIO
 	struct {
 		struct sdio_cis			*cis;
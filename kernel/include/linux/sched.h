@@ -142,6 +142,19 @@ extern unsigned long nr_iowait(void);
 extern unsigned long nr_iowait_cpu(int cpu);
 extern unsigned long this_cpu_load(void);
 
+/*
+ * struct sched_cpu_load - cumulative runqueue statistics of a cpu,
+ * all times in ns of the runqueue clock.
+ */
+struct sched_cpu_load {
+	u64 time;
+	u64 nr_running_sum;	/* integral of nr_running over time */
+	u64 busy_sum;		/* time with at least one runnable task */
+	u64 nr_switches;
+};
+
+extern void sched_get_cpu_load(int cpu, struct sched_cpu_load *load);
+
 
 extern void calc_global_load(void);
 
@@ -18,6 +18,28 @@
 
 /* Contains definitions for resource tracking per uid. */
 
+#include <linux/types.h>
+
+/* Counters kept for each uid, in /proc/uid_stat_all record order. */
+enum {
+	UID_STAT_TCP_RCV,
+	UID_STAT_TCP_SND,
+	UID_STAT_TCP_RCV_PKT,
+	UID_STAT_TCP_SND_PKT,
+	UID_STAT_UDP_RCV,
+	UID_STAT_UDP_SND,
+	UID_STAT_UDP_RCV_PKT,
+	UID_STAT_UDP_SND_PKT,
+	UID_STAT_NR,
+};
+
+/* One record of /proc/uid_stat_all, in native byte order. */
+struct uid_stat_record {
+	__u32 uid;
+	__u32 reserved;
+	__u64 val[UID_STAT_NR];
+};
+
 #ifdef CONFIG_UID_STAT
 int uid_stat_tcp_snd(uid_t uid, int size);
 int uid_stat_tcp_rcv(uid_t uid, int size);
@@ -32,6 +32,24 @@ enum {
 	WAKE_LOCK_TYPE_COUNT
 };
 
+/* Hold time histogram: <1ms, then one bucket per factor of 4, >=4s */
+#define WAKE_LOCK_HIST_BUCKETS	8
+
+/* One record of /proc/wakelocks_bin, in native byte order, times in ns. */
+struct wake_lock_stat_record {
+	char	name[32];
+	__u32	count;
+	__u32	expire_count;
+	__u32	wakeup_count;
+	__u32	reserved;
+	__s64	active_time;
+	__s64	total_time;
+	__s64	prevent_suspend_time;
+	__s64	max_time;
+	__s64	last_time;
+	__u32	hist[WAKE_LOCK_HIST_BUCKETS];
+};
+
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
@@ -47,6 +65,7 @@ struct wake_lock {
 		ktime_t         prevent_suspend_time;
 		ktime_t         max_time;
 		ktime_t         last_time;
+		int             hist[WAKE_LOCK_HIST_BUCKETS];
 	} stat;
 #endif
 #endif
@@ -195,4 +195,17 @@ void *cfpkt_tonative(struct cfpkt *pkt);
  * @return Packet information
  */
 struct caif_payload_info *cfpkt_info(struct cfpkt *pkt);
+
+/*
+ * Counters of packet allocations and payload copies done by the packet
+ * layer itself, exported through debugfs by caif_dev.
+ */
+struct cfpkt_stats {
+	atomic_t alloc;
+	atomic_t copy;
+	atomic_t copy_bytes;
+	atomic_t linearize;
+	atomic_t cow;
+};
+extern struct cfpkt_stats cfpkt_stats;
 #endif				/* CFPKT_H_ */
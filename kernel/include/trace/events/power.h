@@ -67,6 +67,32 @@ TRACE_EVENT(power_end,
 
 );
 
+TRACE_EVENT(cpu_load,
+
+	TP_PROTO(const char *window, unsigned int cpu, unsigned int load,
+		 unsigned int nr),
+
+	TP_ARGS(window, cpu, load, nr),
+
+	TP_STRUCT__entry(
+		__string(	window,		window		)
+		__field(	u32,		cpu		)
+		__field(	u32,		load		)
+		__field(	u32,		nr		)
+	),
+
+	TP_fast_assign(
+		__assign_str(window, window);
+		__entry->cpu = cpu;
+		__entry->load = load;
+		__entry->nr = nr;
+	),
+
+	TP_printk("window=%s cpu=%lu load=%lu nr=%lu", __get_str(window),
+		  (unsigned long)__entry->cpu, (unsigned long)__entry->load,
+		  (unsigned long)__entry->nr)
+);
+
 #endif /* _TRACE_POWER_H */
 
 /* This part must be outside protection */
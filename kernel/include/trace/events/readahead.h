@@ -0,0 +1,47 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM readahead
+
+#if !defined(_TRACE_READAHEAD_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_READAHEAD_H
+
+#include <linux/fs.h>
+#include <linux/tracepoint.h>
+
+/*
+ * A page cache miss of a read() or a page fault, before read-ahead.
+ * Recorded over a boot or an application launch, the misses give the
+ * working set to prefetch, with readahead(2), on the next one.
+ */
+TRACE_EVENT(readahead_miss,
+
+	TP_PROTO(struct address_space *mapping, pgoff_t offset,
+		 unsigned long nr, int sequential),
+
+	TP_ARGS(mapping, offset, nr, sequential),
+
+	TP_STRUCT__entry(
+		__field(	dev_t,		dev		)
+		__field(	ino_t,		ino		)
+		__field(	pgoff_t,	offset		)
+		__field(	unsigned long,	nr		)
+		__field(	int,		sequential	)
+	),
+
+	TP_fast_assign(
+		__entry->dev		= mapping->host->i_sb->s_dev;
+		__entry->ino		= mapping->host->i_ino;
+		__entry->offset		= offset;
+		__entry->nr		= nr;
+		__entry->sequential	= sequential;
+	),
+
+	TP_printk("dev %d,%d ino %lu offset %lu nr %lu %s",
+		  MAJOR(__entry->dev), MINOR(__entry->dev),
+		  (unsigned long)__entry->ino, (unsigned long)__entry->offset,
+		  __entry->nr, __entry->sequential ? "sequential" : "random")
+);
+
+#endif /* _TRACE_READAHEAD_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
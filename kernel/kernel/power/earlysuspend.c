@@ -13,10 +13,13 @@
  *
  */
 
+#include <linux/async.h>
+#include <linux/debugfs.h>
 #include <linux/earlysuspend.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
 #include <linux/rtc.h>
+#include <linux/seq_file.h>
 #include <linux/wakelock.h>
 #include <linux/workqueue.h>
 
@@ -42,6 +45,8 @@ enum {
 	SUSPEND_REQUESTED_AND_SUSPENDED = SUSPEND_REQUESTED | SUSPENDED,
 };
 static int state;
+static LIST_HEAD(early_suspend_domain);
+static u32 late_resume_time;	/* us, last late_resume() */
 
 void register_early_suspend(struct early_suspend *handler)
 {
@@ -69,11 +74,67 @@ void unregister_early_suspend(struct early_suspend *handler)
 }
 EXPORT_SYMBOL(unregister_early_suspend);
 
+static void call_handler(struct early_suspend *h, bool resume)
+{
+	ktime_t start = ktime_get();
+
+	if (!resume) {
+		h->suspend(h);
+		h->suspend_time = ktime_us_delta(ktime_get(), start);
+		return;
+	}
+
+	h->resume(h);
+	if (in_atomic()) {
+		pr_err("%s: became atomic after executing %p(%p)\n",
+		       __func__, h->resume, h);
+		BUG();
+	}
+	h->resume_time = ktime_us_delta(ktime_get(), start);
+	if (h->resume_time > h->resume_time_max)
+		h->resume_time_max = h->resume_time;
+}
+
+static void async_suspend_handler(void *data, async_cookie_t cookie)
+{
+	call_handler(data, false);
+}
+
+static void async_resume_handler(void *data, async_cookie_t cookie)
+{
+	call_handler(data, true);
+}
+
+/*
+ * Call one handler, synchronously or not.  Async handlers of a level
+ * must be done before the handlers of another level are called.
+ */
+static void run_handler(struct early_suspend *pos, bool resume, int *level)
+{
+	if (pos->level != *level) {
+		async_synchronize_full_domain(&early_suspend_domain);
+		*level = pos->level;
+	}
+
+	if (debug_mask & DEBUG_SUSPEND)
+		pr_info("%s: %pS%s\n", resume ? "late_resume" : "early_suspend",
+			resume ? pos->resume : pos->suspend,
+			pos->async ? " (async)" : "");
+
+	if (pos->async)
+		async_schedule_domain(resume ? async_resume_handler :
+				      async_suspend_handler, pos,
+				      &early_suspend_domain);
+	else
+		call_handler(pos, resume);
+}
+
 static void early_suspend(struct work_struct *work)
 {
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
 
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
@@ -93,12 +154,10 @@ static void early_suspend(struct work_struct *work)
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("early_suspend: call handlers\n");
 	list_for_each_entry(pos, &early_suspend_handlers, link) {
-		if (pos->suspend != NULL) {
-			if (debug_mask & DEBUG_SUSPEND)
-				pr_info("early_suspend: %pS\n", pos->suspend);
-			pos->suspend(pos);
-		}
+		if (pos->suspend != NULL)
+			run_handler(pos, false, &level);
 	}
+	async_synchronize_full_domain(&early_suspend_domain);
 	mutex_unlock(&early_suspend_lock);
 
 	suspend_sys_sync_queue();
@@ -116,6 +175,9 @@ static void late_resume(struct work_struct *work)
 	struct early_suspend *pos;
 	unsigned long irqflags;
 	int abort = 0;
+	int level = INT_MIN;
+	ktime_t start;
+
 	mutex_lock(&early_suspend_lock);
 	spin_lock_irqsave(&state_lock, irqflags);
 	if (state == SUSPENDED)
@@ -131,15 +193,12 @@ static void late_resume(struct work_struct *work)
 	}
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: call handlers\n");
+	start = ktime_get();
 	list_for_each_entry_reverse(pos, &early_suspend_handlers, link)
-		if (pos->resume != NULL) {
-			pos->resume(pos);
-			if (in_atomic()) {
-				pr_err("%s: became atomic after executing %p(%p)\n",
-				       __func__, pos->resume, pos);
-				BUG();
-			}
-		}
+		if (pos->resume != NULL)
+			run_handler(pos, true, &level);
+	async_synchronize_full_domain(&early_suspend_domain);
+	late_resume_time = ktime_us_delta(ktime_get(), start);
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("late_resume: done\n");
 abort:
@@ -182,3 +241,65 @@ suspend_state_t get_suspend_state(void)
 {
 	return requested_suspend_state;
 }
+
+#ifdef CONFIG_DEBUG_FS
+/*
+ * Handlers in resume order with the duration of their last calls.  The
+ * critical path of a late resume, what gates the screen on, is the sum
+ * of the synchronous handlers and of the slowest async one of each level.
+ */
+static int early_suspend_stats_show(struct seq_file *m, void *unused)
+{
+	struct early_suspend *pos, *slowest = NULL;
+	u32 critical = 0;
+
+	mutex_lock(&early_suspend_lock);
+
+	seq_printf(m, "last late resume: %u us\n\n", late_resume_time);
+	seq_printf(m, "level async  suspend   resume  max resume  handler\n");
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
+		if (slowest && (!pos->async || pos->level != slowest->level)) {
+			critical += slowest->resume_time;
+			slowest = NULL;
+		}
+		if (pos->async && pos->resume &&
+		    (!slowest || pos->resume_time > slowest->resume_time))
+			slowest = pos;
+		if (!pos->async && pos->resume)
+			critical += pos->resume_time;
+	}
+	if (slowest)
+		critical += slowest->resume_time;
+	seq_printf(m, "critical path: %u us\n\n", critical);
+
+	list_for_each_entry_reverse(pos, &early_suspend_handlers, link) {
+		seq_printf(m, "%5d %5s %8u %8u %11u  %pf / %pf\n",
+			   pos->level, pos->async ? "yes" : "no",
+			   pos->suspend_time, pos->resume_time,
+			   pos->resume_time_max, pos->suspend, pos->resume);
+	}
+
+	mutex_unlock(&early_suspend_lock);
+	return 0;
+}
+
+static int early_suspend_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, early_suspend_stats_show, NULL);
+}
+
+static const struct file_operations early_suspend_stats_fops = {
+	.open		= early_suspend_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init early_suspend_debugfs_init(void)
+{
+	debugfs_create_file("early_suspend_stats", S_IRUGO, NULL, NULL,
+			    &early_suspend_stats_fops);
+	return 0;
+}
+late_initcall(early_suspend_debugfs_init);
+#endif
@@ -21,6 +21,7 @@
 #include <linux/wakelock.h>
 #ifdef CONFIG_WAKELOCK_STAT
 #include <linux/proc_fs.h>
+#include <linux/log2.h>
 #endif
 #include "power.h"
 #ifdef CONFIG_SVNET_WHITELIST
@@ -48,9 +49,16 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
 #define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * Active locks without a timeout are kept in active_wake_locks, so
+ * checking for them is a list_empty().  Locks with a timeout are kept in
+ * timed_wake_locks sorted by expiry: the expired ones are at the head and
+ * the last one to expire is at the tail.
+ */
 static DEFINE_SPINLOCK(list_lock);
 static LIST_HEAD(inactive_locks);
 static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
+static struct list_head timed_wake_locks[WAKE_LOCK_TYPE_COUNT];
 static int current_event_num;
 static int suspend_sys_sync_count;
 static DEFINE_SPINLOCK(suspend_sys_sync_lock);
@@ -93,13 +101,15 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 }
 
 
-static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+static void get_lock_stat(struct wake_lock *lock,
+			  struct wake_lock_stat_record *rec)
 {
 	int lock_count = lock->stat.count;
 	int expire_count = lock->stat.expire_count;
 	ktime_t active_time = ktime_set(0, 0);
 	ktime_t total_time = lock->stat.total_time;
 	ktime_t max_time = lock->stat.max_time;
+	int i;
 
 	ktime_t prevent_suspend_time = lock->stat.prevent_suspend_time;
 	if (lock->flags & WAKE_LOCK_ACTIVE) {
@@ -121,38 +131,87 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 			max_time = add_time;
 	}
 
+	memset(rec, 0, sizeof(*rec));
+	strlcpy(rec->name, lock->name, sizeof(rec->name));
+	rec->count = lock_count;
+	rec->expire_count = expire_count;
+	rec->wakeup_count = lock->stat.wakeup_count;
+	rec->active_time = ktime_to_ns(active_time);
+	rec->total_time = ktime_to_ns(total_time);
+	rec->prevent_suspend_time = ktime_to_ns(prevent_suspend_time);
+	rec->max_time = ktime_to_ns(max_time);
+	rec->last_time = ktime_to_ns(lock->stat.last_time);
+	for (i = 0; i < WAKE_LOCK_HIST_BUCKETS; i++)
+		rec->hist[i] = lock->stat.hist[i];
+}
+
+static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
+{
+	struct wake_lock_stat_record rec;
+
+	get_lock_stat(lock, &rec);
 	return seq_printf(m,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
-		     lock->name, lock_count, expire_count,
-		     lock->stat.wakeup_count, ktime_to_ns(active_time),
-		     ktime_to_ns(total_time),
-		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     lock->name, rec.count, rec.expire_count,
+		     rec.wakeup_count, rec.active_time, rec.total_time,
+		     rec.prevent_suspend_time, rec.max_time, rec.last_time);
 }
 
-static int wakelock_stats_show(struct seq_file *m, void *unused)
+static int write_lock_stat(struct seq_file *m, struct wake_lock *lock)
+{
+	struct wake_lock_stat_record rec;
+
+	get_lock_stat(lock, &rec);
+	return seq_write(m, &rec, sizeof(rec));
+}
+
+static void for_each_lock_stat(struct seq_file *m,
+			      int (*show)(struct seq_file *m,
+					  struct wake_lock *lock))
 {
 	unsigned long irqflags;
 	struct wake_lock *lock;
-	int ret;
 	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
-	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
-			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
 	list_for_each_entry(lock, &inactive_locks, link)
-		ret = print_lock_stat(m, lock);
+		show(m, lock);
 	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
 		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
+			show(m, lock);
+		list_for_each_entry(lock, &timed_wake_locks[type], link)
+			show(m, lock);
 	}
 
 	spin_unlock_irqrestore(&list_lock, irqflags);
+}
+
+static int wakelock_stats_show(struct seq_file *m, void *unused)
+{
+	seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
+			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
+	for_each_lock_stat(m, print_lock_stat);
+	return 0;
+}
 
+/* Same as /proc/wakelocks, one struct wake_lock_stat_record per lock */
+static int wakelock_stats_bin_show(struct seq_file *m, void *unused)
+{
+	for_each_lock_stat(m, write_lock_stat);
 	return 0;
 }
 
+static void hold_time_account(struct wake_lock *lock, ktime_t duration)
+{
+	s64 ms = ktime_to_ms(duration);
+	int bucket = 0;
+
+	if (ms >= 1)
+		bucket = min(ilog2(ms) / 2 + 1, WAKE_LOCK_HIST_BUCKETS - 1);
+	lock->stat.hist[bucket]++;
+}
+
 static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 {
 	ktime_t duration;
@@ -167,6 +226,7 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (expired)
 		lock->stat.expire_count++;
 	duration = ktime_sub(now, lock->stat.last_time);
+	hold_time_account(lock, duration);
 	lock->stat.total_time = ktime_add(lock->stat.total_time, duration);
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
@@ -179,29 +239,38 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	}
 }
 
+static void update_sleep_wait_stats_one(struct wake_lock *lock, int done,
+					ktime_t elapsed)
+{
+	ktime_t etime, add;
+	int expired;
+
+	expired = get_expired_time(lock, &etime);
+	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
+		if (expired)
+			add = ktime_sub(etime, last_sleep_time_update);
+		else
+			add = elapsed;
+		lock->stat.prevent_suspend_time = ktime_add(
+			lock->stat.prevent_suspend_time, add);
+	}
+	if (done || expired)
+		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
+	else
+		lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+}
+
 static void update_sleep_wait_stats_locked(int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
+	ktime_t now, elapsed;
 
 	now = ktime_get();
 	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
-	}
+	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link)
+		update_sleep_wait_stats_one(lock, done, elapsed);
+	list_for_each_entry(lock, &timed_wake_locks[WAKE_LOCK_SUSPEND], link)
+		update_sleep_wait_stats_one(lock, done, elapsed);
 	last_sleep_time_update = now;
 }
 #endif
@@ -223,42 +292,43 @@ static void expire_wake_lock(struct wake_lock *lock)
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
-	bool print_expired = true;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout > 0)
-				pr_info("active wake lock %s, time left %ld\n",
-					lock->name, timeout);
-			else if (print_expired)
-				pr_info("wake lock %s, expired\n", lock->name);
-		} else {
-			pr_info("active wake lock %s\n", lock->name);
-			if (!(debug_mask & DEBUG_EXPIRE))
-				print_expired = false;
-		}
+	list_for_each_entry(lock, &active_wake_locks[type], link)
+		pr_info("active wake lock %s\n", lock->name);
+	list_for_each_entry(lock, &timed_wake_locks[type], link) {
+		long timeout = lock->expires - jiffies;
+		if (timeout > 0)
+			pr_info("active wake lock %s, time left %ld\n",
+				lock->name, timeout);
+		else if (list_empty(&active_wake_locks[type]) ||
+			 (debug_mask & DEBUG_EXPIRE))
+			pr_info("wake lock %s, expired\n", lock->name);
 	}
 }
 
+/*
+ * Returns -1 when a lock without timeout is held, otherwise the jiffies
+ * until the last timed lock expires.  Expired locks are only looked at
+ * once, so this is O(1) apart from the locks it expires.
+ */
 static long has_wake_lock_locked(int type)
 {
 	struct wake_lock *lock, *n;
-	long max_timeout = 0;
+	struct list_head *timed = &timed_wake_locks[type];
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
-		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
-			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
-				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
-				max_timeout = timeout;
-		} else
-			return -1;
+	list_for_each_entry_safe(lock, n, timed, link) {
+		if ((long)(lock->expires - jiffies) > 0)
+			break;
+		expire_wake_lock(lock);
 	}
-	return max_timeout;
+	if (!list_empty(&active_wake_locks[type]))
+		return -1;
+	if (list_empty(timed))
+		return 0;
+	lock = list_entry(timed->prev, struct wake_lock, link);
+	return lock->expires - jiffies;
 }
 
 long has_wake_lock(int type)
@@ -485,6 +555,7 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
+	memset(lock->stat.hist, 0, sizeof(lock->stat.hist));
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
@@ -498,6 +569,9 @@ EXPORT_SYMBOL(wake_lock_init);
 void wake_lock_destroy(struct wake_lock *lock)
 {
 	unsigned long irqflags;
+#ifdef CONFIG_WAKELOCK_STAT
+	int i;
+#endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
 	spin_lock_irqsave(&list_lock, irqflags);
@@ -515,6 +589,8 @@ void wake_lock_destroy(struct wake_lock *lock)
 		deleted_wake_locks.stat.max_time =
 			ktime_add(deleted_wake_locks.stat.max_time,
 				  lock->stat.max_time);
+		for (i = 0; i < WAKE_LOCK_HIST_BUCKETS; i++)
+			deleted_wake_locks.stat.hist[i] += lock->stat.hist[i];
 	}
 #endif
 	list_del(&lock->link);
@@ -522,6 +598,20 @@ void wake_lock_destroy(struct wake_lock *lock)
 }
 EXPORT_SYMBOL(wake_lock_destroy);
 
+/* Keep timed_wake_locks sorted, new timeouts usually go to the tail */
+static void add_timed_lock(struct wake_lock *lock, int type)
+{
+	struct wake_lock *pos;
+
+	list_for_each_entry_reverse(pos, &timed_wake_locks[type], link) {
+		if ((long)(lock->expires - pos->expires) >= 0) {
+			list_add(&lock->link, &pos->link);
+			return;
+		}
+	}
+	list_add(&lock->link, &timed_wake_locks[type]);
+}
+
 static void wake_lock_internal(
 	struct wake_lock *lock, long timeout, int has_timeout)
 {
@@ -560,7 +650,7 @@ static void wake_lock_internal(
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		add_timed_lock(lock, type);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
@@ -669,13 +759,28 @@ static const struct file_operations wakelock_stats_fops = {
 	.release = single_release,
 };
 
+static int wakelock_stats_bin_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wakelock_stats_bin_show, NULL);
+}
+
+static const struct file_operations wakelock_stats_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = wakelock_stats_bin_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int __init wakelocks_init(void)
 {
 	int ret;
 	int i;
 
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
+	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++) {
 		INIT_LIST_HEAD(&active_wake_locks[i]);
+		INIT_LIST_HEAD(&timed_wake_locks[i]);
+	}
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
@@ -712,6 +817,7 @@ static int __init wakelocks_init(void)
 
 #ifdef CONFIG_WAKELOCK_STAT
 	proc_create("wakelocks", S_IRUGO, NULL, &wakelock_stats_fops);
+	proc_create("wakelocks_bin", S_IRUGO, NULL, &wakelock_stats_bin_fops);
 #endif
 
 	return 0;
@@ -734,6 +840,7 @@ err_platform_device_register:
 static void  __exit wakelocks_exit(void)
 {
 #ifdef CONFIG_WAKELOCK_STAT
+	remove_proc_entry("wakelocks_bin", NULL);
 	remove_proc_entry("wakelocks", NULL);
 #endif
 	destroy_workqueue(suspend_work_queue);
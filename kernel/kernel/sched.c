@@ -469,6 +469,11 @@ struct rq {
 	unsigned long nr_load_updates;
 	u64 nr_switches;
 
+	/* runnable and busy time integrals, see sched_get_cpu_load() */
+	u64 nr_running_sum;
+	u64 busy_sum;
+	u64 nr_running_stamp;
+
 	struct cfs_rq cfs;
 	struct rt_rq rt;
 
@@ -1842,13 +1847,32 @@ static const struct sched_class rt_sched_class;
 
 #include "sched_stats.h"
 
+/*
+ * Integrate nr_running over rq->clock up to now.  Callers hold rq->lock
+ * and have just updated the clock.
+ */
+static void update_nr_running_sum(struct rq *rq)
+{
+	s64 delta = rq->clock - rq->nr_running_stamp;
+
+	if (delta <= 0)
+		return;
+	rq->nr_running_stamp = rq->clock;
+	if (!rq->nr_running)
+		return;
+	rq->nr_running_sum += (u64)delta * rq->nr_running;
+	rq->busy_sum += delta;
+}
+
 static void inc_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running++;
 }
 
 static void dec_nr_running(struct rq *rq)
 {
+	update_nr_running_sum(rq);
 	rq->nr_running--;
 }
 
@@ -2893,6 +2917,31 @@ unsigned long this_cpu_load(void)
 	return this->cpu_load[0];
 }
 
+/**
+ * sched_get_cpu_load - runnable statistics of a cpu
+ * @cpu: the cpu to sample
+ * @load: where to store the sample
+ *
+ * Unlike idle time, the integral of nr_running keeps growing when a cpu
+ * is overloaded, so the difference of two samples tells a cpufreq
+ * governor how much work is queued and not only that the cpu was busy.
+ */
+void sched_get_cpu_load(int cpu, struct sched_cpu_load *load)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long flags;
+
+	raw_spin_lock_irqsave(&rq->lock, flags);
+	update_rq_clock(rq);
+	update_nr_running_sum(rq);
+	load->time = rq->clock;
+	load->nr_running_sum = rq->nr_running_sum;
+	load->busy_sum = rq->busy_sum;
+	load->nr_switches = rq->nr_switches;
+	raw_spin_unlock_irqrestore(&rq->lock, flags);
+}
+EXPORT_SYMBOL_GPL(sched_get_cpu_load);
+
 
 /* Variables and functions for calc_load */
 static atomic_long_t calc_load_tasks;
@@ -15,6 +15,12 @@
 # define CRC_BE_BITS 8
 #endif
 
+/*
+ * Number of tables generated: table n is the CRC of a byte followed by
+ * n zero bytes, which lets the 8 bit code consume 8 bytes per step.
+ */
+#define CRC_TABLES 8
+
 /*
  * Little-endian CRC computation.  Used with serial bit streams sent
  * lsbit-first.  Be sure to use cpu_to_le32() to append the computed CRC.
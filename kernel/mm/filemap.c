@@ -1447,8 +1447,10 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 	struct address_space *mapping = file->f_mapping;
 
 	/* If we don't want any read-ahead, don't bother */
-	if (VM_RandomReadHint(vma))
+	if (VM_RandomReadHint(vma)) {
+		ra_record_miss(mapping, ra, offset, 1, 0);
 		return;
+	}
 
 	if (VM_SequentialReadHint(vma) ||
 			offset - 1 == (ra->prev_pos >> PAGE_CACHE_SHIFT)) {
@@ -1457,6 +1459,7 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 		return;
 	}
 
+	ra_record_miss(mapping, ra, offset, 1, 0);
 	if (ra->mmap_miss < INT_MAX)
 		ra->mmap_miss++;
 
@@ -1468,9 +1471,12 @@ static void do_sync_mmap_readahead(struct vm_area_struct *vma,
 		return;
 
 	/*
-	 * mmap read-around
+	 * mmap read-around, over a few pages only when the file is
+	 * being read at random
 	 */
 	ra_pages = max_sane_readahead(ra->ra_pages);
+	if (ra_pattern_random(ra))
+		ra_pages = min(ra_pages, RA_RANDOM_AROUND_PAGES);
 	if (ra_pages) {
 		ra->start = max_t(long, 0, offset - ra_pages/2);
 		ra->size = ra_pages;
@@ -259,3 +259,27 @@ extern u64 hwpoison_filter_flags_mask;
 extern u64 hwpoison_filter_flags_value;
 extern u64 hwpoison_filter_memcg;
 extern u32 hwpoison_filter_enable;
+
+/*
+ * Access pattern of a file, from its last 8 page cache misses (see
+ * file_ra_state.pattern): read-ahead windows start at full size when
+ * nearly all of them were sequential, and stay minimal when nearly all
+ * of them were scattered, as for the zip entry lookups in an APK.
+ */
+#define RA_PATTERN_MASK		0xff
+#define RA_PATTERN_INIT		0x0f	/* no history yet: half and half */
+#define RA_RANDOM_AROUND_PAGES	4UL	/* mmap read-around when random */
+
+extern void ra_record_miss(struct address_space *mapping,
+			   struct file_ra_state *ra, pgoff_t offset,
+			   unsigned long nr, int sequential);
+
+static inline int ra_pattern_sequential(struct file_ra_state *ra)
+{
+	return hweight8(ra->pattern) >= 7;
+}
+
+static inline int ra_pattern_random(struct file_ra_state *ra)
+{
+	return hweight8(ra->pattern) <= 1;
+}
@@ -18,6 +18,11 @@
 #include <linux/pagevec.h>
 #include <linux/pagemap.h>
 
+#include "internal.h"
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/readahead.h>
+
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
  * memset *ra to zero.
@@ -26,10 +31,22 @@ void
 file_ra_state_init(struct file_ra_state *ra, struct address_space *mapping)
 {
 	ra->ra_pages = mapping->backing_dev_info->ra_pages;
+	ra->pattern = RA_PATTERN_INIT;
 	ra->prev_pos = -1;
 }
 EXPORT_SYMBOL_GPL(file_ra_state_init);
 
+/*
+ * Account a page cache miss of @nr pages at @offset in the access
+ * pattern of the file
+ */
+void ra_record_miss(struct address_space *mapping, struct file_ra_state *ra,
+		    pgoff_t offset, unsigned long nr, int sequential)
+{
+	ra->pattern = ((ra->pattern << 1) | !!sequential) & RA_PATTERN_MASK;
+	trace_readahead_miss(mapping, offset, nr, sequential);
+}
+
 #define list_to_page(head) (list_entry((head)->prev, struct page, lru))
 
 /*
@@ -393,6 +410,7 @@ ondemand_readahead(struct address_space *mapping,
 		   unsigned long req_size)
 {
 	unsigned long max = max_sane_readahead(ra->ra_pages);
+	int miss = !hit_readahead_marker;
 
 	/*
 	 * start of file
@@ -406,6 +424,8 @@ ondemand_readahead(struct address_space *mapping,
 	 */
 	if ((offset == (ra->start + ra->size - ra->async_size) ||
 	     offset == (ra->start + ra->size))) {
+		if (miss)
+			ra_record_miss(mapping, ra, offset, req_size, 1);
 		ra->start += ra->size;
 		ra->size = get_next_ra_size(ra, max);
 		ra->async_size = ra->size;
@@ -450,20 +470,32 @@ ondemand_readahead(struct address_space *mapping,
 
 	/*
 	 * Query the page cache and look for the traces(cached history pages)
-	 * that a sequential stream would leave behind.
+	 * that a sequential stream would leave behind.  Not worth it when
+	 * the file is read at random: the pages around are likely cached
+	 * for the other lookups.
 	 */
-	if (try_context_readahead(mapping, ra, offset, req_size, max))
+	if (!ra_pattern_random(ra) &&
+	    try_context_readahead(mapping, ra, offset, req_size, max)) {
+		ra_record_miss(mapping, ra, offset, req_size, 1);
 		goto readit;
+	}
 
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
 	 */
+	ra_record_miss(mapping, ra, offset, req_size, 0);
 	return __do_page_cache_readahead(mapping, filp, offset, req_size, 0);
 
 initial_readahead:
+	if (miss)
+		ra_record_miss(mapping, ra, offset, req_size, 1);
 	ra->start = offset;
-	ra->size = get_init_ra_size(req_size, max);
+	/* the file has been read sequentially so far, do not ramp up */
+	if (ra_pattern_sequential(ra))
+		ra->size = max;
+	else
+		ra->size = get_init_ra_size(req_size, max);
 	ra->async_size = ra->size > req_size ? ra->size - req_size : ra->size;
 
 readit:
@@ -504,6 +536,7 @@ void page_cache_sync_readahead(struct address_space *mapping,
 
 	/* be dumb */
 	if (filp && (filp->f_mode & FMODE_RANDOM)) {
+		ra_record_miss(mapping, ra, offset, req_size, 0);
 		force_page_cache_readahead(mapping, filp, offset, req_size);
 		return;
 	}
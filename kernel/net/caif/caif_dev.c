@@ -20,6 +20,8 @@
 #include <linux/skbuff.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <net/netns/generic.h>
 #include <net/net_namespace.h>
 #include <net/pkt_sched.h>
@@ -56,6 +58,66 @@ struct caif_net {
 static int caif_net_id;
 static struct cfcnfg *cfg;
 
+#ifdef CONFIG_DEBUG_FS
+static struct dentry *debugfsdir;
+
+/* Time spent pushing a received frame up through the CAIF layers */
+static struct {
+	u32 frames;
+	u32 max_ns;
+	u64 total_ns;
+} rx_lat;
+
+static inline ktime_t rx_lat_start(void)
+{
+	return ktime_get();
+}
+
+static void rx_lat_add(ktime_t start)
+{
+	u32 ns = (u32) ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	rx_lat.frames++;
+	rx_lat.total_ns += ns;
+	if (ns > rx_lat.max_ns)
+		rx_lat.max_ns = ns;
+}
+
+static void caif_dev_debugfs_init(void)
+{
+	debugfsdir = debugfs_create_dir("caif_dev", NULL);
+	if (IS_ERR_OR_NULL(debugfsdir))
+		return;
+	debugfs_create_u32("rx_frames", S_IRUSR | S_IWUSR, debugfsdir,
+			&rx_lat.frames);
+	debugfs_create_u32("rx_max_ns", S_IRUSR | S_IWUSR, debugfsdir,
+			&rx_lat.max_ns);
+	debugfs_create_u64("rx_total_ns", S_IRUSR | S_IWUSR, debugfsdir,
+			&rx_lat.total_ns);
+	debugfs_create_u32("pkt_alloc", S_IRUSR | S_IWUSR, debugfsdir,
+			(u32 *) &cfpkt_stats.alloc);
+	debugfs_create_u32("pkt_copy", S_IRUSR | S_IWUSR, debugfsdir,
+			(u32 *) &cfpkt_stats.copy);
+	debugfs_create_u32("pkt_copy_bytes", S_IRUSR | S_IWUSR, debugfsdir,
+			(u32 *) &cfpkt_stats.copy_bytes);
+	debugfs_create_u32("pkt_linearize", S_IRUSR | S_IWUSR, debugfsdir,
+			(u32 *) &cfpkt_stats.linearize);
+	debugfs_create_u32("pkt_cow", S_IRUSR | S_IWUSR, debugfsdir,
+			(u32 *) &cfpkt_stats.cow);
+}
+
+static void caif_dev_debugfs_exit(void)
+{
+	if (!IS_ERR_OR_NULL(debugfsdir))
+		debugfs_remove_recursive(debugfsdir);
+}
+#else
+static inline ktime_t rx_lat_start(void) { return ktime_set(0, 0); }
+static inline void rx_lat_add(ktime_t start) {}
+#define caif_dev_debugfs_init()
+#define caif_dev_debugfs_exit()
+#endif
+
 static struct caif_device_entry_list *caif_device_list(struct net *net)
 {
 	struct caif_net *caifn;
@@ -157,12 +219,17 @@ static int receive(struct sk_buff *skb, struct net_device *dev,
 {
 	struct cfpkt *pkt;
 	struct caif_device_entry *caifd;
+	ktime_t start = rx_lat_start();
+	int ret;
+
 	pkt = cfpkt_fromnative(CAIF_DIR_IN, skb);
 	caifd = caif_get(dev);
 	if (!caifd || !caifd->layer.up || !caifd->layer.up->receive)
 		return NET_RX_DROP;
 
-	if (caifd->layer.up->receive(caifd->layer.up, pkt))
+	ret = caifd->layer.up->receive(caifd->layer.up, pkt);
+	rx_lat_add(start);
+	if (ret)
 		return NET_RX_DROP;
 
 	return 0;
@@ -376,6 +443,7 @@ static int __init caif_device_init(void)
 	}
 	dev_add_pack(&caif_packet_type);
 	register_netdevice_notifier(&caif_device_notifier);
+	caif_dev_debugfs_init();
 
 	return result;
 err_cfcnfg_create_failed:
@@ -384,6 +452,7 @@ err_cfcnfg_create_failed:
 
 static void __exit caif_device_exit(void)
 {
+	caif_dev_debugfs_exit();
 	dev_remove_pack(&caif_packet_type);
 	unregister_pernet_device(&caif_net_ops);
 	unregister_netdevice_notifier(&caif_device_notifier);
@@ -21,6 +21,20 @@ do {					   \
 	pr_warn(errmsg);		   \
 } while (0)
 
+struct cfpkt_stats cfpkt_stats;
+
+#ifdef CONFIG_DEBUG_FS
+#define	pkt_stat_inc(v) atomic_inc(&cfpkt_stats.v)
+#define	pkt_stat_copy(len)					\
+do {								\
+	atomic_inc(&cfpkt_stats.copy);				\
+	atomic_add(len, &cfpkt_stats.copy_bytes);		\
+} while (0)
+#else
+#define	pkt_stat_inc(v)
+#define	pkt_stat_copy(len)
+#endif
+
 struct cfpktq {
 	struct sk_buff_head head;
 	atomic_t count;
@@ -89,6 +103,7 @@ static struct cfpkt *cfpkt_create_pfx(u16 len, u16 pfx)
 	if (unlikely(skb == NULL))
 		return NULL;
 
+	pkt_stat_inc(alloc);
 	skb_reserve(skb, pfx);
 	return skb_to_pkt(skb);
 }
@@ -136,6 +151,7 @@ int cfpkt_extr_head(struct cfpkt *pkt, void *data, u16 len)
 	}
 
 	if (unlikely(len > skb_headlen(skb))) {
+		pkt_stat_inc(linearize);
 		if (unlikely(skb_linearize(skb) != 0)) {
 			PKT_ERROR(pkt, "linearize failed\n");
 			return -EPROTO;
@@ -155,6 +171,8 @@ int cfpkt_extr_trail(struct cfpkt *pkt, void *dta, u16 len)
 	if (unlikely(is_erronous(pkt)))
 		return -EPROTO;
 
+	if (unlikely(skb_is_nonlinear(skb)))
+		pkt_stat_inc(linearize);
 	if (unlikely(skb_linearize(skb) != 0)) {
 		PKT_ERROR(pkt, "linearize failed\n");
 		return -EPROTO;
@@ -200,6 +218,7 @@ int cfpkt_add_body(struct cfpkt *pkt, const void *data, u16 len)
 	/* Check whether we need to change the SKB before writing to the tail */
 	if (unlikely((addlen > 0) || skb_cloned(skb) || skb_shared(skb))) {
 
+		pkt_stat_inc(cow);
 		/* Make sure data is writable */
 		if (unlikely(skb_cow_data(skb, addlen, &lastskb) < 0)) {
 			PKT_ERROR(pkt, "cow failed\n");
@@ -342,10 +361,12 @@ struct cfpkt *cfpkt_append(struct cfpkt *dstpkt,
 		skb_set_tail_pointer(tmp, dstlen);
 		tmp->len = dstlen;
 		memcpy(tmp->data, dst->data, dstlen);
+		pkt_stat_copy(dstlen);
 		cfpkt_destroy(dstpkt);
 		dst = tmp;
 	}
 	memcpy(skb_tail_pointer(dst), add->data, skb_headlen(add));
+	pkt_stat_copy(skb_headlen(add));
 	cfpkt_destroy(addpkt);
 	dst->tail += addlen;
 	dst->len += addlen;
@@ -384,6 +405,7 @@ struct cfpkt *cfpkt_split(struct cfpkt *pkt, u16 pos)
 	skb->len = pos;
 
 	memcpy(skb2->data, split, len2nd);
+	pkt_stat_copy(len2nd);
 	skb2->tail += len2nd;
 	skb2->len += len2nd;
 	return skb_to_pkt(skb2);